@@ -0,0 +1,63 @@
+#ifndef CRYSTALMEM_BENCH_BENCH_H_
+#define CRYSTALMEM_BENCH_BENCH_H_
+
+#include <chrono> // std::chrono
+#include <cstdint> // uint64_t
+#include <cstdio> // std::printf
+
+#include "CrystalMem/type.h" // size_t
+
+namespace crystal::mem::bench {
+
+using std::chrono::steady_clock, std::chrono::duration;
+
+/**
+ * Mean wall time of one call of `body`, in nanoseconds.
+ *
+ * `body` runs `n / 10` times first to warm caches and pools up, and is then
+ * timed over `n` calls.
+ */
+template <typename Body>
+double MeanNs(size_t n, Body&& body) {
+  for (size_t i = 0; i < n / 10; ++i) body();
+  auto begin = steady_clock::now();
+  for (size_t i = 0; i < n; ++i) body();
+  auto end = steady_clock::now();
+  return duration<double, std::nano>(end - begin).count() / n;
+}
+
+/**
+ * Keep the compiler from dropping the computation of `value`.
+ */
+template <typename T>
+void DoNotOptimize(const T& value) {
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+/**
+ * A fixed seed xorshift generator, so that every run sees the same workload.
+ */
+class Random {
+ public:
+  explicit Random(uint64_t seed = 88172645463325252ull) : state_(seed) {
+  }
+  uint64_t operator()() {
+    state_ ^= state_ << 13;
+    state_ ^= state_ >> 7;
+    state_ ^= state_ << 17;
+    return state_;
+  }
+  /**
+   * A number in `[low, high]`.
+   */
+  size_t Uniform(size_t low, size_t high) {
+    return low + (*this)() % (high - low + 1);
+  }
+
+ private:
+  uint64_t state_;
+};
+
+} // namespace crystal::mem::bench
+
+#endif
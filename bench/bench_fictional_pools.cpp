@@ -0,0 +1,88 @@
+/**
+ * Churn in the pools without in-memory optimization.
+ *
+ * Each pool first holds a number of live objects. Every step then frees a
+ * random live object and allocates a new one of a random size in its place,
+ * so the blocks stay fragmented at a steady number of live objects.
+ *
+ * Sizes are either any of 8-500 bytes, or powers of 2 of 16-512 bytes, which
+ * `BuddyPool` can serve without rounding.
+ */
+#include <cstdio> // std::printf
+#include <vector> // std::vector
+
+#include "CrystalMem/pool/buddy/buddy.h" // BuddyPool
+#include "CrystalMem/pool/safe_best_fit/safe_best_fit.h" // SafeBestFitPool
+#include "CrystalMem/pool/tlsf/tlsf.h" // TLSFPool
+#include "CrystalMem/resource/os.h" // OSResource
+#include "CrystalMem/type.h" // _kB
+#include "CrystalMem/vendor.h" // Vendor
+#include "bench.h" // MeanNs, Random
+
+namespace crystal::mem::bench {
+namespace {
+
+constexpr size_t kBlockSize = 64_kB;
+constexpr size_t kNSteps = 200000;
+
+/**
+ * Mean time of a free followed by an allocation in `Pool` with `n_live`
+ * objects, whose sizes come from `next_size`.
+ */
+template <typename Pool, typename NextSize>
+double StepNs(size_t n_live, NextSize&& next_size) {
+  OSResource resource;
+  Pool pool{ Vendor<OSResource>{ resource } };
+  Random rng;
+  std::vector<void*> ptrs(n_live);
+  std::vector<size_t> sizes(n_live);
+  for (size_t i = 0; i < n_live; ++i) {
+    sizes[i] = next_size(rng);
+    ptrs[i] = pool.RawAlloc(sizes[i], align_t{ 8 });
+  }
+  double step_ns = MeanNs(kNSteps, [&] {
+    size_t victim = rng.Uniform(0, n_live - 1);
+    pool.RawDealloc(ptrs[victim], sizes[victim], align_t{ 8 });
+    sizes[victim] = next_size(rng);
+    ptrs[victim] = pool.RawAlloc(sizes[victim], align_t{ 8 });
+    DoNotOptimize(ptrs[victim]);
+  });
+  for (size_t i = 0; i < n_live; ++i)
+    pool.RawDealloc(ptrs[i], sizes[i], align_t{ 8 });
+  return step_ns;
+}
+
+/* Sizes of 8-500 bytes. */
+size_t AnySize(Random& rng) {
+  return rng.Uniform(8, 500);
+}
+
+/* Sizes of 16, 32, ..., 512 bytes. */
+size_t PowerOf2Size(Random& rng) {
+  return size_t{ 16 } << rng.Uniform(0, 5);
+}
+
+} // namespace
+} // namespace crystal::mem::bench
+
+int main() {
+  using namespace crystal::mem;
+  using namespace crystal::mem::bench;
+  using SafeBestFit = SafeBestFitPool<kBlockSize, Vendor<OSResource>>;
+  using TLSF = TLSFPool<kBlockSize, Vendor<OSResource>>;
+  using Buddy = BuddyPool<kBlockSize, 16_B, Vendor<OSResource>>;
+  std::printf("free+alloc of 8-500 B, 64 kB blocks\n");
+  std::printf("  live objects  SafeBestFitPool  TLSFPool\n");
+  for (size_t n_live : { 1000, 10000, 50000 })
+    std::printf("  %12zu  %12.0f ns  %5.0f ns\n", n_live,
+                StepNs<SafeBestFit>(n_live, AnySize),
+                StepNs<TLSF>(n_live, AnySize));
+  std::printf("\nfree+alloc of 16-512 B powers of 2, 64 kB blocks\n");
+  std::printf("  live objects  SafeBestFitPool  TLSFPool  BuddyPool\n");
+  for (size_t n_live : { 1000, 10000, 50000 })
+    std::printf("  %12zu  %12.0f ns  %5.0f ns  %6.0f ns\n", n_live,
+                StepNs<SafeBestFit>(n_live, PowerOf2Size),
+                StepNs<TLSF>(n_live, PowerOf2Size),
+                StepNs<Buddy>(n_live, PowerOf2Size));
+  return 0;
+}
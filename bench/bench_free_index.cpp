@@ -0,0 +1,102 @@
+/**
+ * Random churn in a `SafeBestFitFreeMap` with each free node index.
+ *
+ * The free map holds free fragments of 256-1023 bytes at fictional addresses
+ * with gaps in between, so they never merge with each other. Every step
+ * allocates 16-255 bytes, which splits a fragment, and frees a random one of
+ * the recent allocations, which merges it back. Besides the time, each step
+ * counts the tree node allocations of the index.
+ */
+#include <cstdio> // std::printf
+#include <memory> // std::allocator
+#include <utility> // std::pair
+#include <vector> // std::vector
+
+#include "CrystalMem/pool/safe_best_fit/free_map.h" // SafeBestFitFreeMap
+#include "CrystalMem/type.h" // size_t
+#include "bench.h" // MeanNs, Random
+
+namespace crystal::mem::bench {
+namespace {
+
+constexpr size_t kNSteps = 200000;
+/* Fragments start a stride apart, more than the largest fragment. */
+constexpr size_t kStride = 2048;
+/* Allocations that are live at a time. */
+constexpr size_t kNLive = 64;
+
+/* Tree node allocations of every `CountingAllocator`. */
+size_t n_allocations = 0;
+
+/**
+ * A `std::allocator` that counts its allocations.
+ */
+template <typename T>
+struct CountingAllocator : std::allocator<T> {
+  using value_type = T;
+
+  CountingAllocator() = default;
+  template <typename U>
+  CountingAllocator(const CountingAllocator<U>&) {
+  }
+
+  T* allocate(size_t n) {
+    ++n_allocations;
+    return std::allocator<T>::allocate(n);
+  }
+};
+
+struct StepCost {
+  double ns;
+  double allocations;
+};
+
+/**
+ * Mean time and index allocations of an allocation and deallocation step with
+ * `n_fragments` free nodes.
+ */
+template <typename Index>
+StepCost Step(size_t n_fragments) {
+  using FreeMap = SafeBestFitFreeMap<
+      CountingAllocator<std::pair<void* const, size_t>>, Index>;
+  FreeMap free_map{ {} };
+  Random rng;
+  for (size_t i = 0; i < n_fragments; ++i)
+    free_map.InsertNode(reinterpret_cast<void*>((i + 1) * kStride),
+                        rng.Uniform(256, 1023));
+  std::vector<std::pair<void*, size_t>> live(kNLive);
+  for (auto& [ptr, size] : live) {
+    size = rng.Uniform(16, 255);
+    ptr = free_map.Alloc(size, align_t{ 8 });
+  }
+  size_t n_before = n_allocations;
+  size_t n_calls = 0;
+  double step_ns = MeanNs(kNSteps, [&] {
+    auto& [ptr, size] = live[rng.Uniform(0, kNLive - 1)];
+    free_map.Dealloc(ptr, size, align_t{ 8 });
+    size = rng.Uniform(16, 255);
+    ptr = free_map.Alloc(size, align_t{ 8 });
+    DoNotOptimize(ptr);
+    ++n_calls;
+  });
+  return { step_ns,
+           static_cast<double>(n_allocations - n_before) / n_calls };
+}
+
+} // namespace
+} // namespace crystal::mem::bench
+
+int main() {
+  using namespace crystal::mem;
+  using namespace crystal::mem::bench;
+  std::printf("dealloc+alloc step of 16-255 B, fragments of 256-1023 B\n");
+  std::printf("  free nodes  rb tree                b+ tree\n");
+  for (size_t n_fragments : { 100, 10000, 100000 }) {
+    StepCost tree = Step<TreeFreeIndex>(n_fragments);
+    StepCost btree = Step<BTreeFreeIndex>(n_fragments);
+    std::printf("  %10zu  %5.0f ns, %4.2f allocs  %5.0f ns, %4.2f allocs\n",
+                n_fragments, tree.ns, tree.allocations, btree.ns,
+                btree.allocations);
+  }
+  return 0;
+}
@@ -0,0 +1,58 @@
+/**
+ * Allocation and deallocation pairs of a `SafeBestFitFreeMap` that holds many
+ * small free fragments.
+ *
+ * The fragments are 16-63 bytes at fictional addresses with gaps in between,
+ * so they never merge. Each pair takes a random 16-63 byte, 8 byte aligned
+ * range and frees it again, which merges it back into its fragment.
+ */
+#include <cstdio> // std::printf
+#include <memory> // std::allocator
+#include <utility> // std::pair
+#include <vector> // std::vector
+
+#include "CrystalMem/pool/safe_best_fit/free_map.h" // SafeBestFitFreeMap
+#include "CrystalMem/type.h" // size_t
+#include "bench.h" // MeanNs, Random
+
+namespace crystal::mem::bench {
+namespace {
+
+using FreeMap =
+    SafeBestFitFreeMap<std::allocator<std::pair<void* const, size_t>>>;
+constexpr size_t kNPairs = 200000;
+/* Fragments start a stride apart, more than the largest fragment. */
+constexpr size_t kStride = 128;
+
+/**
+ * Mean time of an allocation and deallocation pair with `n_fragments` free.
+ */
+double PairNs(size_t n_fragments) {
+  FreeMap free_map{ {} };
+  Random rng;
+  for (size_t i = 0; i < n_fragments; ++i)
+    free_map.InsertNode(reinterpret_cast<void*>((i + 1) * kStride),
+                        rng.Uniform(16, 63));
+  std::vector<size_t> sizes(1024);
+  for (size_t& size : sizes) size = rng.Uniform(16, 63);
+  size_t next = 0;
+  return MeanNs(kNPairs, [&] {
+    size_t size = sizes[next++ % sizes.size()];
+    void* ptr = free_map.Alloc(size, align_t{ 8 });
+    DoNotOptimize(ptr);
+    if (ptr != reinterpret_cast<void*>(-1ul))
+      free_map.Dealloc(ptr, size, align_t{ 8 });
+  });
+}
+
+} // namespace
+} // namespace crystal::mem::bench
+
+int main() {
+  using namespace crystal::mem::bench;
+  std::printf("alloc+dealloc pair, 8 byte aligned, fragments of 16-63 B\n");
+  std::printf("  fragments  mean\n");
+  for (size_t n_fragments : { 100, 1000, 10000, 50000 })
+    std::printf("  %9zu  %6.0f ns\n", n_fragments, PairNs(n_fragments));
+  return 0;
+}
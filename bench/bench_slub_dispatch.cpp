@@ -0,0 +1,65 @@
+/**
+ * Runtime sized allocation and deallocation pairs of a `SLUBPool`, which go
+ * through the per size class dispatch tables.
+ *
+ * Each round allocates 256 objects and frees them in the same order, with one
+ * size, three alternating sizes or random sizes up to 1 kB.
+ */
+#include <cstdio> // std::printf
+#include <vector> // std::vector
+
+#include "CrystalMem/pool/slub/slub.h" // SLUBPool
+#include "CrystalMem/resource/os.h" // OSResource
+#include "CrystalMem/type.h" // _kB
+#include "CrystalMem/vendor.h" // Vendor
+#include "bench.h" // MeanNs, Random
+
+namespace crystal::mem::bench {
+namespace {
+
+using Pool = SLUBPool<64_kB,
+                      { 8_B, 16_B, 32_B, 64_B, 128_B, 256_B,
+                        512_B, 1_kB, 2_kB, 4_kB, 8_kB, 16_kB },
+                      Vendor<OSResource>,
+                      Vendor<OSResource>,
+                      SLUBOptions{ .empty_block_retention = 8 }>;
+constexpr size_t kNObjects = 256;
+constexpr size_t kNRounds = 40000;
+
+/**
+ * Mean time of an allocation and deallocation pair of `sizes`.
+ */
+double PairNs(const std::vector<size_t>& sizes) {
+  OSResource resource;
+  Pool pool{ Vendor<OSResource>{ resource } };
+  std::vector<void*> ptrs(sizes.size());
+  double round_ns = MeanNs(kNRounds, [&] {
+    for (size_t i = 0; i < sizes.size(); ++i)
+      ptrs[i] = pool.RawAlloc(sizes[i], align_t{ 8 });
+    DoNotOptimize(ptrs.data());
+    for (size_t i = 0; i < sizes.size(); ++i)
+      pool.RawDealloc(ptrs[i], sizes[i], align_t{ 8 });
+  });
+  return round_ns / sizes.size();
+}
+
+} // namespace
+} // namespace crystal::mem::bench
+
+int main() {
+  using namespace crystal::mem::bench;
+  std::vector<size_t> single(kNObjects, 24);
+  std::vector<size_t> three(kNObjects);
+  std::vector<size_t> random(kNObjects);
+  Random rng;
+  for (size_t i = 0; i < kNObjects; ++i) {
+    three[i] = 24 + 40 * (i % 3);
+    random[i] = rng.Uniform(8, 1007);
+  }
+  std::printf("alloc+dealloc pair, mean of %zu rounds of %zu objects\n",
+              kNRounds, kNObjects);
+  std::printf("  single size   %6.2f ns\n", PairNs(single));
+  std::printf("  three sizes   %6.2f ns\n", PairNs(three));
+  std::printf("  random sizes  %6.2f ns\n", PairNs(random));
+  return 0;
+}
@@ -1,11 +1,16 @@
 #ifndef CRYSTALMEM_CONTINUOUS_ALLOCATOR_H_
 #define CRYSTALMEM_CONTINUOUS_ALLOCATOR_H_
 
-#include "CrystalMem/type.h" // size_t, align_t
+#include <type_traits> // std::is_trivially_copyable_v
+
+#include "CrystalMem/type.h" // size_t, align_t, AllocationResult
 #include "CrystalMem/pool/concept.h" // AnyPool
+#include "CrystalMem/pool/realloc.h" // Realloc
 
 namespace crystal::mem {
 
+using std::is_trivially_copyable_v;
+
 /**
  * A type of allocator that specializes in allocating arrays of objects.
  */
@@ -14,32 +19,67 @@ class ContinuousAllocator {
 public:
   using value_type = T;
   /* Constructor */
-  explicit ContinuousAllocator(Pool& pool) : pool_(pool) {}
-  template <class U, typename P>
-  friend class DynAllocatorImpl; // friend for following constructor
+  explicit ContinuousAllocator(Pool& pool) : pool_(&pool) {}
+  template <typename U, AnyPool P>
+  friend class ContinuousAllocator; // friend for following constructor
   template <class U>
   explicit ContinuousAllocator(const ContinuousAllocator<U, Pool>& other):
     pool_(other.pool_) {}
   ContinuousAllocator(const ContinuousAllocator& other) : pool_(other.pool_) {}
   ContinuousAllocator& operator=(const ContinuousAllocator& rhs) {
     pool_ = rhs.pool_;
+    return *this;
   }
 
   /* Functions */
   T* allocate(size_t n) {
-    return pool_.template ContinuousAlloc<T>(n);
+    return pool_->template ContinuousAlloc<T>(n);
+  }
+  /**
+   * Allocate room for at least `n` objects, so that a container can use all of
+   * it before growing. Deallocate it with the returned count.
+   */
+  AllocationResult<T*> allocate_at_least(size_t n) {
+    return pool_->template ContinuousAllocAtLeast<T>(n);
   }
   void deallocate(T* ptr, size_t n) {
-    pool_.template ContinuousDealloc<T>(ptr, n);
+    pool_->template ContinuousDealloc<T>(ptr, n);
+  }
+  /**
+   * Grow an array from `old_n` to `new_n` objects without moving it, so that a
+   * growing container can skip relocating its elements.
+   *
+   * @return Whether the array grew, otherwise it is left as is.
+   */
+  bool TryExpandInPlace(T* ptr, size_t old_n, size_t new_n) {
+    return pool_->template TryExpandInPlace<T>(ptr, old_n, new_n);
+  }
+  /**
+   * Shrink an array from `old_n` to `new_n` objects without moving it.
+   *
+   * @return Whether the array shrank, otherwise it keeps its old size.
+   */
+  bool Shrink(T* ptr, size_t old_n, size_t new_n) {
+    return pool_->template Shrink<T>(ptr, old_n, new_n);
+  }
+  /**
+   * Resize an array of trivially copyable objects, copying it if it cannot be
+   * resized in place.
+   *
+   * @return The array, **OR** `nullptr` if allocating failed.
+   */
+  T* Realloc(T* ptr, size_t old_n, size_t new_n)
+      requires is_trivially_copyable_v<T> {
+    return crystal::mem::Realloc<T>(*pool_, ptr, old_n, new_n);
   }
-  bool operator==(const ContinuousAllocator& other) {
-    return &pool_ == &other.pool_;
+  bool operator==(const ContinuousAllocator& other) const {
+    return pool_ == other.pool_;
   }
-  bool operator!=(const ContinuousAllocator& other) {
-    return &pool_ != &other.pool_;
+  bool operator!=(const ContinuousAllocator& other) const {
+    return pool_ != other.pool_;
   }
 private:
-  Pool& pool_;
+  Pool* pool_;
 };
 } // namespace crystal::mem
 
@@ -1,6 +1,8 @@
 #ifndef CRYSTALMEM_DISCRETE_ALLOCATOR_H_
 #define CRYSTALMEM_DISCRETE_ALLOCATOR_H_
 
+#include <cassert> // assert
+
 #include "CrystalMem/type.h" // size_t, align_t
 #include "CrystalMem/pool/concept.h" // AnyPool
 
@@ -15,15 +17,16 @@ class DiscreteAllocator {
 public:
   using value_type = T;
   /* Constructor */
-  explicit DiscreteAllocator(Pool& pool) : pool_(pool) {}
-  template <class U, typename P>
-  friend class MonoAllocatorImpl; // friend for following constructor
+  explicit DiscreteAllocator(Pool& pool) : pool_(&pool) {}
+  template <typename U, AnyPool P>
+  friend class DiscreteAllocator; // friend for following constructor
   template <class U>
   explicit DiscreteAllocator(const DiscreteAllocator<U, Pool>& other):
     pool_(other.pool_) {}
   DiscreteAllocator(const DiscreteAllocator& other) : pool_(other.pool_) {}
   DiscreteAllocator& operator=(const DiscreteAllocator& rhs) {
     pool_ = rhs.pool_;
+    return *this;
   }
 
   /* Functions */
@@ -31,22 +34,22 @@ public:
 // clang-format off
     assert(n == 1 && "Discrete allocator can only allocate a single object.");
 // clang-format on
-    return pool_.template DiscreteAlloc<T>();
+    return pool_->template DiscreteAlloc<T>();
   }
   void deallocate(T* ptr, size_t n) {
 // clang-format off
     assert(n == 1 && "Discrete allocator can only deallocate a single object.");
 // clang-format on
-    pool_.template DiscreteDealloc<T>(ptr);
+    pool_->template DiscreteDealloc<T>(ptr);
   }
-  bool operator==(const DiscreteAllocator& other) {
-    return &pool_ == &other.pool_;
+  bool operator==(const DiscreteAllocator& other) const {
+    return pool_ == other.pool_;
   }
-  bool operator!=(const DiscreteAllocator& other) {
-    return &pool_ != &other.pool_;
+  bool operator!=(const DiscreteAllocator& other) const {
+    return pool_ != other.pool_;
   }
 private:
-  Pool& pool_;
+  Pool* pool_;
 };
 } // namespace crystal::mem
 
@@ -7,6 +7,7 @@
 #include "CrystalMem/option.h"
 #include "CrystalMem/resource.h"
 #include "CrystalMem/pool.h"
+#include "CrystalMem/strategy.h"
 // NOLINTEND
 
 #endif
@@ -12,7 +12,7 @@ LongevityCa kLongevityCa,
 SizeCa kSizeCa,
 ExpansionCa kExpansionCa>
 struct Characteristic;
-template<Source, Characteristic>
+template<Source, typename>
 struct Opts;
 
 enum class LongevityCa {
@@ -80,6 +80,22 @@ struct Characteristic{
   ~Characteristic() = delete;
 };
 
+/**
+ * Where the memory of an allocation comes from and how it is used, which
+ * `Strategy` turns into a resource, pool and allocator at compile time.
+ */
+template<
+Source kSrc = Source::OS,
+typename Ca = Characteristic<>>
+struct Opts{
+  static constexpr Source kSource = kSrc;
+  static constexpr LongevityCa kLongevity = Ca::kLongevity;
+  static constexpr SizeCa kSize = Ca::kSize;
+  static constexpr ExpansionCa kExpansion = Ca::kExpansion;
+  Opts() = delete;
+  ~Opts() = delete;
+};
+
 } // namespace crystal::mem
 
 #endif
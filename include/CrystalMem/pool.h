@@ -2,7 +2,13 @@
 #define CRYSTALMEM_POOL_H_
 
 #include "pool/concept.h"
+#include "pool/realloc.h"
+#include "pool/buddy/buddy.h"
+#include "pool/monotonic_arena/monotonic_arena.h"
 #include "pool/slub/slub.h"
 #include "pool/safe_best_fit/safe_best_fit.h"
+#include "pool/safe_slub/safe_slub.h"
+#include "pool/stack/stack.h"
+#include "pool/tlsf/tlsf.h"
 
 #endif
\ No newline at end of file
@@ -0,0 +1,143 @@
+#ifndef CRYSTALMEM_POOL_BUDDY_BLOCK_H_
+#define CRYSTALMEM_POOL_BUDDY_BLOCK_H_
+
+#include <CrystalBase/bitwise.h> // lowbit
+
+#include <array> // std::array
+#include <bit> // std::countr_zero
+#include <cstdint> // uint32_t, uint64_t
+
+#include "CrystalMem/type.h" // size_t
+
+namespace crystal::mem {
+
+using std::array, std::countr_zero;
+
+/**
+ * Out of line state of a block split into buddies.
+ *
+ * The block is a binary tree of nodes, the root covers the whole block and
+ * every node of order `o` covers `kMinSize << o` bytes. The nodes are numbered
+ * level by level from `1` for the root, so the children of node `i` are `2i`
+ * and `2i + 1`, and a bit per node tells whether it is free as a whole.
+ *
+ * Above the node bits are summary levels, each with a bit per word of the
+ * level below that is not zero, up to a single word. A free node of an order
+ * is found from the summary level where the nodes of the order fit in one
+ * word, with one `countr_zero` per level below it, so at most
+ * `kMaxOrder / 6 + 1` of them.
+ *
+ * The block also counts its free nodes per order, and is linked into a list
+ * per order by the pool while it has any.
+ *
+ * Ownership responsibilities:
+ *  Objects of this class have **NO** memory ownership responsibilities.
+ */
+template <size_t kSize, size_t kMinSize>
+requires (lowbit(kSize) == kSize && lowbit(kMinSize) == kMinSize
+          && kMinSize <= kSize)
+class BuddyBlock {
+ public:
+  /* Constants */
+  static constexpr size_t kMaxOrder = countr_zero(kSize / kMinSize);
+  static constexpr size_t kNOrders = kMaxOrder + 1;
+  static constexpr size_t kNNodes = 2 * (kSize / kMinSize);
+  /* The node bits and their summary levels. */
+  static constexpr size_t kNLevels = kMaxOrder / 6 + 1;
+  /* Offset of each level in the bit words, and the end of the last one. */
+  static constexpr array<size_t, kNLevels + 1> kLevelOffsets = [] {
+    array<size_t, kNLevels + 1> offsets{};
+    size_t n_bits = kNNodes;
+    for (size_t level = 0; level < kNLevels; ++level) {
+      n_bits = (n_bits + 63) / 64;
+      offsets[level + 1] = offsets[level] + n_bits;
+    }
+    return offsets;
+  }();
+
+  /* Links of the per order lists. */
+  array<BuddyBlock*, kNOrders> next{};
+  array<BuddyBlock*, kNOrders> prev{};
+
+  /* Constructor */
+  explicit BuddyBlock(void* addr) : addr_(reinterpret_cast<size_t>(addr)) {
+  }
+
+  /* Functions */
+  /**
+   * Number of free nodes of an order.
+   */
+  uint32_t NFree(size_t order) const {
+    return n_free_[order];
+  }
+  /**
+   * Whether a node is free as a whole.
+   */
+  bool IsFree(size_t node) const {
+    return free_bits_[node >> 6] >> (node & 63) & 1;
+  }
+  void MarkFree(size_t order, size_t node) {
+    /* Set the summary bits up to the first word that was not empty. */
+    for (size_t level = 0, bit = node; level < kNLevels; ++level, bit >>= 6) {
+      uint64_t& word = free_bits_[kLevelOffsets[level] + (bit >> 6)];
+      bool was_empty = !word;
+      word |= uint64_t{ 1 } << (bit & 63);
+      if (!was_empty) break;
+    }
+    ++n_free_[order];
+  }
+  void MarkUsed(size_t order, size_t node) {
+    /* Clear the summary bits up to the first word that is not empty. */
+    for (size_t level = 0, bit = node; level < kNLevels; ++level, bit >>= 6) {
+      uint64_t& word = free_bits_[kLevelOffsets[level] + (bit >> 6)];
+      word &= ~(uint64_t{ 1 } << (bit & 63));
+      if (word) break;
+    }
+    --n_free_[order];
+  }
+  /**
+   * Find a free node of an order, the block must have one.
+   *
+   * The nodes of an order are the aligned range `[2^d, 2^(d+1))` of node
+   * bits, `d = kMaxOrder - order`. At summary level `d / 6`, the range covers
+   * fewer than 64 bits of the first word, each of which summarizes nodes of
+   * the order only, so any set bit leads down to a free node.
+   */
+  size_t FindFree(size_t order) const {
+    size_t depth = kMaxOrder - order;
+    size_t level = depth / 6;
+    size_t first = size_t{ 1 } << (depth - 6 * level);
+    uint64_t range = (~uint64_t{ 0 } >> (64 - first)) << first;
+    size_t bit = countr_zero(free_bits_[kLevelOffsets[level]] & range);
+    while (level--)
+      bit = (bit << 6) + countr_zero(free_bits_[kLevelOffsets[level] + bit]);
+    return bit;
+  }
+  /**
+   * Get the node of an order at `addr`.
+   */
+  size_t Node(size_t order, size_t addr) const {
+    return FirstNode(order) + ((addr - addr_) / (kMinSize << order));
+  }
+  /**
+   * Get the address of a node of an order.
+   */
+  size_t Addr(size_t order, size_t node) const {
+    return addr_ + (node - FirstNode(order)) * (kMinSize << order);
+  }
+
+ private:
+  /* Variables */
+  size_t addr_;
+  array<uint64_t, kLevelOffsets[kNLevels]> free_bits_{};
+  array<uint32_t, kNOrders> n_free_{};
+
+  /* Functions */
+  static constexpr size_t FirstNode(size_t order) {
+    return size_t{ 1 } << (kMaxOrder - order);
+  }
+};
+
+} // namespace crystal::mem
+
+#endif
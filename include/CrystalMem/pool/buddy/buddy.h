@@ -0,0 +1,326 @@
+#ifndef CRYSTALMEM_POOL_BUDDY_BUDDY_H_
+#define CRYSTALMEM_POOL_BUDDY_BUDDY_H_
+
+#include <CrystalBase/bitwise.h> // lowbit
+
+#include <array> // std::array
+#include <bit> // std::bit_ceil, std::countr_zero
+#include <cstdint> // uint64_t
+#include <memory> // std::construct_at
+#include <type_traits> // std::is_same_v
+#include <utility> // std::exchange
+
+#include "CrystalMem/pool/concept.h" // AnyPool
+#include "CrystalMem/pool/large_map.h" // LargeAllocMap
+#include "CrystalMem/pool/page_map.h" // PageMap
+#include "CrystalMem/resource/os.h" // OSResource
+#include "CrystalMem/type.h" // _kB
+#include "CrystalMem/vendor.h" // Vendor
+#include "CrystalMem/vendor/concept.h" // AnyVendor
+#include "block.h" // BuddyBlock
+
+namespace crystal::mem {
+
+using std::array, std::bit_ceil, std::countr_zero, std::move, std::is_same_v,
+    std::construct_at, std::exchange;
+
+/**
+ * A memory pool that implements the binary buddy strategy.
+ *
+ * Requests are rounded up to a power of 2 of at least `kMinSize` bytes, its
+ * order. A free node of the smallest order that fits is split in halves until
+ * it has the requested order, and a freed node merges with its buddy as long
+ * as the buddy is free too, so allocating and deallocating split or merge at
+ * most one node per order. Nodes are aligned to their size.
+ *
+ * The split and merge state is one bit per node of each block, summarized so
+ * that a free node of an order is found with a bit scan per 6 orders, and
+ * marking a node updates at most as many words (see `BuddyBlock`). It is kept
+ * in logic memory with the blocks that have free nodes of each order, so the
+ * blocks themselves are never read or written. The order of a node being
+ * freed comes from the size it is freed with.
+ *
+ * @tparam kBlockSize The block size, the largest order. Blocks are aligned to
+ * their size.
+ * @tparam kMinSize The size of the smallest order.
+ * @tparam ResourceVendor The vendor to request data memory from. Since this
+ * pool doesn't have in-memory optimization, memory obtained from this vendor
+ * will not be operated on.
+ * @tparam LogicVendor The vendor to request memory for allocating logic state.
+ */
+template <size_t kBlockSize,
+          size_t kMinSize,
+          AnyVendor ResourceVendor,
+          AnyVendor LogicVendor = ResourceVendor>
+requires (lowbit(kBlockSize) == kBlockSize && lowbit(kMinSize) == kMinSize)
+class BuddyPool {
+ public:
+  using Block = BuddyBlock<kBlockSize, kMinSize>;
+  /* Allocations larger or more aligned than a block. */
+  using LargeMap = LargeAllocMap<kBlockSize + 1, LogicVendor>;
+
+  /* Constants */
+  static constexpr size_t kMaxOrder = Block::kMaxOrder;
+  static_assert(kMaxOrder < 64, "Too many orders.");
+
+  /* Attributes */
+  static constexpr bool kInMemoryOptimization = false;
+
+  /* Constructor */
+  BuddyPool(const ResourceVendor& vendor)
+      requires is_same_v<ResourceVendor, LogicVendor>
+      : BuddyPool(vendor, vendor) {
+  }
+  BuddyPool(const ResourceVendor& resource_vendor,
+            const LogicVendor& logic_vendor) :
+      resource_vendor_(resource_vendor),
+      logic_vendor_(logic_vendor),
+      blocks_(logic_vendor),
+      large_allocs_(logic_vendor) {
+  }
+  /* No Copying */
+  BuddyPool(const BuddyPool&) = delete;
+  /* Move Constructor */
+  BuddyPool(BuddyPool&& other) :
+      resource_vendor_(other.resource_vendor_),
+      logic_vendor_(other.logic_vendor_),
+      blocks_(move(other.blocks_)),
+      heads_(exchange(other.heads_, {})),
+      orders_(exchange(other.orders_, 0)),
+      large_allocs_(move(other.large_allocs_)) {
+  }
+  /* No Copying */
+  BuddyPool& operator=(const BuddyPool&) = delete;
+  BuddyPool& operator=(BuddyPool&& rhs) {
+    Clear();
+    resource_vendor_ = rhs.resource_vendor_;
+    logic_vendor_ = rhs.logic_vendor_;
+    blocks_ = move(rhs.blocks_);
+    heads_ = exchange(rhs.heads_, {});
+    orders_ = exchange(rhs.orders_, 0);
+    large_allocs_ = move(rhs.large_allocs_);
+    return *this;
+  }
+  /* Destructor */
+  ~BuddyPool() {
+    Clear();
+  }
+
+  /* Functions */
+  template <typename T>
+  T* DiscreteAlloc() {
+    return reinterpret_cast<T*>(
+        RawAlloc(sizeof(T), static_cast<align_t>(alignof(T))));
+  }
+  template <typename T>
+  void DiscreteDealloc(T* ptr) {
+    RawDealloc(ptr, sizeof(T), static_cast<align_t>(alignof(T)));
+  }
+  template <typename T>
+  T* ContinuousAlloc(size_t n) {
+    return reinterpret_cast<T*>(
+        RawAlloc(sizeof(T) * n, static_cast<align_t>(alignof(T))));
+  }
+  template <typename T>
+  void ContinuousDealloc(T* ptr, size_t n) {
+    RawDealloc(ptr, sizeof(T) * n, static_cast<align_t>(alignof(T)));
+  }
+  /**
+   * Allocate an array of at least `n` objects, which holds as many objects as
+   * fit in its node.
+   *
+   * @return The array and the number of objects it holds.
+   */
+  template <typename T>
+  AllocationResult<T*> ContinuousAllocAtLeast(size_t n) {
+    constexpr align_t kAlign = static_cast<align_t>(alignof(T));
+    T* ptr = ContinuousAlloc<T>(n);
+    if (!ptr || IsLarge(sizeof(T) * n, kAlign)) return { ptr, n };
+    return { ptr, (kMinSize << Order(sizeof(T) * n, kAlign)) / sizeof(T) };
+  }
+  /**
+   * Grow an array from `old_n` to `new_n` objects by merging its node with
+   * free buddies on the right, or within a large allocation.
+   *
+   * @return Whether the array grew, otherwise it is left as is.
+   */
+  template <typename T>
+  bool TryExpandInPlace(T* ptr, size_t old_n, size_t new_n) {
+    constexpr align_t kAlign = static_cast<align_t>(alignof(T));
+    size_t old_size = sizeof(T) * old_n, new_size = sizeof(T) * new_n;
+    if (IsLarge(old_size, kAlign)) return new_size <= large_allocs_.Size(ptr);
+    if (IsLarge(new_size, kAlign)) return false;
+    size_t order = Order(old_size, kAlign);
+    size_t new_order = Order(new_size, kAlign);
+    Block* block = blocks_.Get(ptr);
+    size_t node = block->Node(order, reinterpret_cast<size_t>(ptr));
+    /* The node must be a left half up to the new order, with free buddies. */
+    for (size_t o = order, n = node; o < new_order; ++o, n /= 2)
+      if (n & 1 || !block->IsFree(n ^ 1)) return false;
+    for (; order < new_order; ++order, node /= 2)
+      Take(block, order, node ^ 1);
+    return true;
+  }
+  /**
+   * Shrink an array from `old_n` to `new_n` objects, `new_n <= old_n`, by
+   * splitting its node and freeing the right halves.
+   *
+   * @return Whether the array shrank, otherwise it keeps its old size, e.g.
+   * when a large allocation would fit in a block.
+   */
+  template <typename T>
+  bool Shrink(T* ptr, size_t old_n, size_t new_n) {
+    constexpr align_t kAlign = static_cast<align_t>(alignof(T));
+    size_t old_size = sizeof(T) * old_n, new_size = sizeof(T) * new_n;
+    if (IsLarge(old_size, kAlign)) return IsLarge(new_size, kAlign);
+    size_t order = Order(old_size, kAlign);
+    size_t new_order = Order(new_size, kAlign);
+    Block* block = blocks_.Get(ptr);
+    size_t node = block->Node(order, reinterpret_cast<size_t>(ptr));
+    for (; order > new_order; --order) {
+      node *= 2;
+      Give(block, order - 1, node + 1);
+    }
+    return true;
+  }
+  void* RawAlloc(size_t size, align_t align) {
+    if (IsLarge(size, align))
+      return large_allocs_.Alloc(resource_vendor_, size, align);
+    size_t order = Order(size, align);
+    /* The smallest order with a free node that fits. */
+    uint64_t fitting = orders_ & (~uint64_t{ 0 } << order);
+    size_t free_order;
+    Block* block;
+    size_t node;
+    if (fitting) {
+      free_order = countr_zero(fitting);
+      block = heads_[free_order];
+      node = block->FindFree(free_order);
+      Take(block, free_order, node);
+    } else {
+      if (!(block = AppendBlock())) [[unlikely]] return nullptr;
+      free_order = kMaxOrder;
+      node = 1;
+    }
+    /* Split down to the order, the right halves stay free. */
+    for (; free_order > order; --free_order) {
+      node *= 2;
+      Give(block, free_order - 1, node + 1);
+    }
+    return reinterpret_cast<void*>(block->Addr(order, node));
+  }
+  void RawDealloc(void* ptr, size_t size, align_t align) {
+    if (IsLarge(size, align)) {
+      large_allocs_.Dealloc(resource_vendor_, ptr);
+      return;
+    }
+    size_t order = Order(size, align);
+    Block* block = blocks_.Get(ptr);
+    size_t node = block->Node(order, reinterpret_cast<size_t>(ptr));
+    /* Merge with the buddy while it is free. */
+    for (; order < kMaxOrder && block->IsFree(node ^ 1); ++order) {
+      Take(block, order, node ^ 1);
+      node /= 2;
+    }
+    Give(block, order, node);
+  }
+  template <typename T, typename ...Args>
+  T* New(Args&&... args) {
+    T* addr = DiscreteAlloc<T>();
+    construct_at(addr, args...);
+    return addr;
+  }
+  template <typename T>
+  void Del(T* ptr) {
+    ptr->~T();
+    DiscreteDealloc(ptr);
+  }
+  void Clear() {
+    /* Release the blocks and their state. */
+    blocks_.ForEach([this](void* addr, Block* block) {
+      resource_vendor_.Dealloc(
+          addr, kBlockSize, static_cast<align_t>(kBlockSize));
+      block->~Block();
+      logic_vendor_.Dealloc(
+          block, sizeof(Block), static_cast<align_t>(alignof(Block)));
+    });
+    blocks_.Clear();
+    heads_.fill(nullptr);
+    orders_ = 0;
+    /* Clear external allocations. */
+    large_allocs_.Clear(resource_vendor_);
+  }
+
+ private:
+  /* Variables */
+  ResourceVendor resource_vendor_;
+  LogicVendor logic_vendor_;
+  PageMap<kBlockSize, Block*, LogicVendor> blocks_;
+  /* Blocks with free nodes of each order. */
+  array<Block*, Block::kNOrders> heads_{};
+  /* A set bit for each order with free nodes. */
+  uint64_t orders_ = 0;
+  LargeMap large_allocs_;
+
+  /* Functions */
+  static constexpr bool IsLarge(size_t size, align_t align) {
+    return size > kBlockSize || static_cast<size_t>(align) > kBlockSize;
+  }
+  /**
+   * Get the order of a request that is not large.
+   */
+  static constexpr size_t Order(size_t size, align_t align) {
+    size_t alignment = static_cast<size_t>(align);
+    if (size < alignment) size = alignment;
+    if (size < kMinSize) size = kMinSize;
+    return countr_zero(bit_ceil(size) / kMinSize);
+  }
+  /**
+   * Mark a free node used, unlinking the block from the order if it was the
+   * last one.
+   */
+  void Take(Block* block, size_t order, size_t node) {
+    block->MarkUsed(order, node);
+    if (block->NFree(order)) return;
+    Block* next = block->next[order];
+    Block* prev = block->prev[order];
+    if (next) next->prev[order] = prev;
+    if (prev) prev->next[order] = next;
+    else heads_[order] = next;
+    block->next[order] = block->prev[order] = nullptr;
+    if (!heads_[order]) orders_ &= ~(uint64_t{ 1 } << order);
+  }
+  /**
+   * Mark a node free, linking the block to the order if it is the first one.
+   */
+  void Give(Block* block, size_t order, size_t node) {
+    block->MarkFree(order, node);
+    if (block->NFree(order) > 1) return;
+    block->prev[order] = nullptr;
+    block->next[order] = heads_[order];
+    if (heads_[order]) heads_[order]->prev[order] = block;
+    heads_[order] = block;
+    orders_ |= uint64_t{ 1 } << order;
+  }
+  /**
+   * Request a new block from the vendor, its root node is left used.
+   *
+   * @return The block, **OR** `nullptr` if the vendor failed.
+   */
+  Block* AppendBlock() {
+    void* addr = resource_vendor_.Alloc(
+        kBlockSize, static_cast<align_t>(kBlockSize));
+    if (!addr) [[unlikely]] return nullptr;
+    Block* block = construct_at(
+        reinterpret_cast<Block*>(logic_vendor_.Alloc(
+            sizeof(Block), static_cast<align_t>(alignof(Block)))),
+        addr);
+    blocks_.Set(addr, 1, block);
+    return block;
+  }
+};
+static_assert(AnyPool<BuddyPool<4_kB, 16_B, Vendor<OSResource>>>);
+
+} // namespace crystal::mem
+
+#endif
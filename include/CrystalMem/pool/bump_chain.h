@@ -0,0 +1,193 @@
+#ifndef CRYSTALMEM_POOL_BUMP_CHAIN_H_
+#define CRYSTALMEM_POOL_BUMP_CHAIN_H_
+
+#include <CrystalBase/bitwise.h> // lowbit
+
+#include <utility> // std::exchange, std::move
+#include <vector> // std::vector
+
+#include "CrystalMem/type.h" // size_t, align_t
+#include "CrystalMem/vendor/allocator.h" // VendorAllocator
+#include "CrystalMem/vendor/concept.h" // AnyVendor
+
+namespace crystal::mem {
+
+using std::vector, std::move, std::exchange;
+
+/**
+ * A cursor bumped through a chain of blocks, the core of the pools that only
+ * free memory by position, e.g. `MonotonicArenaPool` and `StackPool`.
+ *
+ * Allocating aligns the cursor and moves it past the request, going on to the
+ * next block of the chain, or a new one, when the current block is used up.
+ * Blocks stay in the chain when the cursor moves back, so they are bumped
+ * through again.
+ *
+ * Memory Responsibilities:
+ * Blocks are only released to the resource vendor by `Clear`, the pool must
+ * call it before this chain is destroyed or assigned to.
+ *
+ * @tparam kBlockSize The block size to bump through. Blocks are aligned to
+ * their size.
+ * @tparam LogicVendor The vendor to request the chain itself from.
+ */
+template <size_t kBlockSize, AnyVendor LogicVendor>
+requires (lowbit(kBlockSize) == kBlockSize)
+class BumpBlockChain {
+ public:
+  /**
+   * A position of the cursor to move back to.
+   */
+  struct Position {
+    /* Number of blocks bumped into. */
+    size_t n_blocks;
+    size_t cursor;
+  };
+
+  /* Constructor */
+  BumpBlockChain(const LogicVendor& logic_vendor) :
+      blocks_(VendorAllocator<void*, LogicVendor>(logic_vendor)) {
+  }
+  /* No Copying */
+  BumpBlockChain(const BumpBlockChain&) = delete;
+  /* Move Constructor */
+  BumpBlockChain(BumpBlockChain&& other) :
+      blocks_(move(other.blocks_)),
+      n_used_blocks_(exchange(other.n_used_blocks_, 0)),
+      cursor_(exchange(other.cursor_, 0)),
+      end_(exchange(other.end_, 0)) {
+  }
+  /* No Copying */
+  BumpBlockChain& operator=(const BumpBlockChain&) = delete;
+  BumpBlockChain& operator=(BumpBlockChain&& rhs) {
+    blocks_ = move(rhs.blocks_);
+    rhs.blocks_.clear();
+    n_used_blocks_ = exchange(rhs.n_used_blocks_, 0);
+    cursor_ = exchange(rhs.cursor_, 0);
+    end_ = exchange(rhs.end_, 0);
+    return *this;
+  }
+
+  /* Functions */
+  /**
+   * Whether a request can be bumped in a block at all, otherwise the pool
+   * serves it elsewhere.
+   */
+  static constexpr bool Fits(size_t size, align_t align) {
+    return size <= kBlockSize && static_cast<size_t>(align) <= kBlockSize;
+  }
+  /**
+   * Bump `size` bytes aligned to `align`, which must `Fits`.
+   *
+   * @return The allocated memory, **OR** `nullptr` if `vendor` failed to
+   * provide a new block.
+   */
+  template <AnyVendor ResourceVendor>
+  void* Alloc(ResourceVendor& vendor, size_t size, align_t align) {
+    size_t alignment = static_cast<size_t>(align);
+    size_t addr = (cursor_ + alignment - 1) & ~(alignment - 1);
+    if (addr + size > end_ || !end_) [[unlikely]] {
+      if (!NextBlock(vendor)) [[unlikely]] return nullptr;
+      /* Blocks are aligned to their size, which is enough for any request
+       * that fits. */
+      addr = cursor_;
+    }
+    cursor_ = addr + size;
+    return reinterpret_cast<void*>(addr);
+  }
+  /**
+   * Bump the cursor back over `size` bytes at `ptr` if they are the last
+   * allocation, otherwise nothing happens.
+   */
+  void Dealloc(void* ptr, size_t size) {
+    size_t addr = reinterpret_cast<size_t>(ptr);
+    if (IsLast(addr, size)) cursor_ = addr;
+  }
+  /**
+   * Resize the last allocation to `new_size` bytes while it fits in its block.
+   *
+   * @return Whether it was resized, otherwise it is left as is.
+   */
+  bool TryResize(void* ptr, size_t old_size, size_t new_size) {
+    size_t addr = reinterpret_cast<size_t>(ptr);
+    if (!IsLast(addr, old_size) || new_size > end_ - addr) return false;
+    cursor_ = addr + new_size;
+    return true;
+  }
+  /**
+   * The current position of the cursor.
+   */
+  Position Tell() const {
+    return { n_used_blocks_, cursor_ };
+  }
+  /**
+   * Move the cursor back to `position`, taken from `Tell` since the last
+   * `Clear`.
+   */
+  void Seek(const Position& position) {
+    n_used_blocks_ = position.n_blocks;
+    cursor_ = position.cursor;
+    end_ = n_used_blocks_
+               ? reinterpret_cast<size_t>(blocks_[n_used_blocks_ - 1])
+                     + kBlockSize
+               : 0;
+  }
+  /**
+   * Move the cursor back to the first block and release the blocks past the
+   * first `n_kept` ones to `vendor`.
+   */
+  template <AnyVendor ResourceVendor>
+  void Clear(ResourceVendor& vendor, size_t n_kept) {
+    while (blocks_.size() > n_kept) {
+      vendor.Dealloc(
+          blocks_.back(), kBlockSize, static_cast<align_t>(kBlockSize));
+      blocks_.pop_back();
+    }
+    n_used_blocks_ = 0;
+    cursor_ = end_ = 0;
+  }
+
+ private:
+  /* Variables */
+  /* Blocks in the order they are bumped through. */
+  vector<void*, VendorAllocator<void*, LogicVendor>> blocks_;
+  /* Number of blocks bumped into. */
+  size_t n_used_blocks_ = 0;
+  /* The free range of the current block. */
+  size_t cursor_ = 0;
+  size_t end_ = 0;
+
+  /* Functions */
+  /**
+   * Whether `size` bytes at `addr` are the last allocation of the current
+   * block, with nothing bumped past them.
+   */
+  bool IsLast(size_t addr, size_t size) const {
+    return addr + size == cursor_ && addr >= end_ - kBlockSize;
+  }
+  /**
+   * Move on to the next block of the chain, or request a new one from
+   * `vendor`.
+   *
+   * @return Whether there is a block to bump through, otherwise the vendor
+   * failed.
+   */
+  template <AnyVendor ResourceVendor>
+  bool NextBlock(ResourceVendor& vendor) {
+    void* block;
+    if (n_used_blocks_ < blocks_.size()) block = blocks_[n_used_blocks_];
+    else {
+      block = vendor.Alloc(kBlockSize, static_cast<align_t>(kBlockSize));
+      if (!block) [[unlikely]] return false;
+      blocks_.push_back(block);
+    }
+    ++n_used_blocks_;
+    cursor_ = reinterpret_cast<size_t>(block);
+    end_ = cursor_ + kBlockSize;
+    return true;
+  }
+};
+
+} // namespace crystal::mem
+
+#endif
@@ -4,7 +4,7 @@
 #include <concepts>    // std::move_constructible
 #include <type_traits> // std::move_assignable_v
 
-#include "CrystalMem/type.h" // align_t
+#include "CrystalMem/type.h" // align_t, AllocationResult
 
 namespace crystal::mem {
 
@@ -14,6 +14,18 @@ using std::same_as, std::convertible_to, std::move_constructible,
 struct SomeObject {
   int a;
 };
+/**
+ * The interface of a memory pool.
+ *
+ * `ContinuousAllocAtLeast` also reports how many objects fit in the memory
+ * that is actually handed out, e.g. the rest of a slot, and the array is then
+ * deallocated with that count.
+ *
+ * Arrays can be resized: `TryExpandInPlace` and `Shrink` only succeed without
+ * moving the array and never touch its memory. `Realloc` in realloc.h builds
+ * on them for any pool, falling back to copying the array to a new
+ * allocation, so it needs addressable memory.
+ */
 template <typename T>
 concept AnyPool =
     requires(
@@ -25,6 +37,13 @@ concept AnyPool =
       { pool.template DiscreteDealloc<SomeObject>(ptr) } -> same_as<void>;
       { pool.template ContinuousAlloc<SomeObject>(n) } -> same_as<SomeObject*>;
       { pool.template ContinuousDealloc<SomeObject>(ptr, n) } -> same_as<void>;
+      {
+        pool.template ContinuousAllocAtLeast<SomeObject>(n)
+      } -> same_as<AllocationResult<SomeObject*>>;
+      {
+        pool.template TryExpandInPlace<SomeObject>(ptr, n, n)
+      } -> same_as<bool>;
+      { pool.template Shrink<SomeObject>(ptr, n, n) } -> same_as<bool>;
       { pool.RawAlloc(size, align) } -> same_as<void*>;
       { pool.RawDealloc(ptr, size, align) } -> same_as<void>;
       {
@@ -0,0 +1,132 @@
+#ifndef CRYSTALMEM_POOL_LARGE_MAP_H_
+#define CRYSTALMEM_POOL_LARGE_MAP_H_
+
+#include <algorithm> // std::max
+#include <bit> // std::bit_floor, std::countr_zero
+
+#include "CrystalMem/pool/page_map.h" // PageMap
+#include "CrystalMem/type.h" // size_t, align_t, _kB
+#include "CrystalMem/vendor/concept.h" // AnyVendor
+
+namespace crystal::mem {
+
+using std::max, std::bit_floor, std::countr_zero;
+
+/**
+ * Records of the allocations a pool forwards to its resource vendor because
+ * they fit no size class or block.
+ *
+ * The record of an allocation is kept in a page map under the page of its
+ * address, so recording and finding one is a fixed number of loads and stores
+ * and allocates nothing once the page map nodes exist. Allocations of at least
+ * `kPageSize` bytes never start in the same page; smaller ones are requested
+ * aligned to `kPageSize` so that they do not either.
+ *
+ * Threading:
+ *  `Alloc` and `Dealloc` may be called concurrently, `Clear` and moves need
+ *  exclusive access.
+ *
+ * Memory Responsibilities:
+ * This class is responsible for releasing its page map nodes. Allocations are
+ * only released to the resource vendor by `Dealloc` and `Clear`.
+ *
+ * @tparam kMinSize The size of the smallest allocation usually forwarded.
+ * @tparam LogicVendor The vendor to request page map nodes from.
+ */
+template <size_t kMinSize, AnyVendor LogicVendor>
+class LargeAllocMap {
+ public:
+  /* Constants */
+  static constexpr size_t kPageSize = max(4_kB, bit_floor(kMinSize));
+
+  /* Constructor */
+  LargeAllocMap(const LogicVendor& logic_vendor) : pages_(logic_vendor) {
+  }
+
+  /* Functions */
+  /**
+   * Allocate `size` bytes from `vendor` and record them.
+   */
+  template <AnyVendor ResourceVendor>
+  void* Alloc(ResourceVendor& vendor, size_t size, align_t align) {
+    if (size < kPageSize && static_cast<size_t>(align) < kPageSize)
+      align = static_cast<align_t>(kPageSize);
+    void* addr = vendor.Alloc(size, align);
+    if (!addr) [[unlikely]] return nullptr;
+    pages_.Set(addr, 1, Record{
+      size,
+      reinterpret_cast<size_t>(addr) & (kPageSize - 1),
+      static_cast<size_t>(countr_zero(static_cast<size_t>(align)))
+    });
+    return addr;
+  }
+  /**
+   * Release a recorded allocation back to `vendor`, addresses that are not
+   * recorded are ignored.
+   */
+  template <AnyVendor ResourceVendor>
+  void Dealloc(ResourceVendor& vendor, void* ptr) {
+    Record record = Find(ptr);
+    if (record.size == 0) [[unlikely]] return;
+    pages_.Set(ptr, 1, Record{});
+    vendor.Dealloc(ptr, record.size, record.Align());
+  }
+  /**
+   * Whether `ptr` is the address of a recorded allocation.
+   */
+  bool Contains(const void* ptr) const {
+    return Find(ptr).size != 0;
+  }
+  /**
+   * Size of the recorded allocation at `ptr`, **OR** `0` if there is none.
+   */
+  size_t Size(const void* ptr) const {
+    return Find(ptr).size;
+  }
+  /**
+   * Release every recorded allocation back to `vendor`, and the page map
+   * nodes to the logic vendor.
+   */
+  template <AnyVendor ResourceVendor>
+  void Clear(ResourceVendor& vendor) {
+    pages_.ForEach([&vendor](void* page, const Record& record) {
+      vendor.Dealloc(static_cast<char*>(page) + record.offset,
+                     record.size,
+                     record.Align());
+    });
+    pages_.Clear();
+  }
+
+ private:
+  /**
+   * Size, offset in its page and alignment of an allocation.
+   */
+  struct Record {
+    size_t size = 0;
+    size_t offset : 56 = 0;
+    size_t align_shift : 8 = 0;
+
+    align_t Align() const {
+      return static_cast<align_t>(size_t{ 1 } << align_shift);
+    }
+    friend bool operator==(const Record&, const Record&) = default;
+  };
+
+  /* Variables */
+  PageMap<kPageSize, Record, LogicVendor> pages_;
+
+  /* Functions */
+  /**
+   * Get the record of the allocation at `ptr`, empty if there is none.
+   */
+  Record Find(const void* ptr) const {
+    Record record = pages_.Get(ptr);
+    if (record.offset != (reinterpret_cast<size_t>(ptr) & (kPageSize - 1)))
+      return Record{};
+    return record;
+  }
+};
+
+} // namespace crystal::mem
+
+#endif
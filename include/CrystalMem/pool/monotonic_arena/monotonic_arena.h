@@ -0,0 +1,190 @@
+#ifndef CRYSTALMEM_POOL_MONOTONIC_ARENA_MONOTONIC_ARENA_H_
+#define CRYSTALMEM_POOL_MONOTONIC_ARENA_MONOTONIC_ARENA_H_
+
+#include <CrystalBase/bitwise.h> // lowbit
+
+#include <memory> // std::construct_at
+#include <type_traits> // std::is_same_v
+#include <utility> // std::move
+
+#include "CrystalMem/pool/bump_chain.h" // BumpBlockChain
+#include "CrystalMem/pool/concept.h" // AnyPool
+#include "CrystalMem/pool/large_map.h" // LargeAllocMap
+#include "CrystalMem/resource/os.h" // OSResource
+#include "CrystalMem/type.h" // _kB
+#include "CrystalMem/vendor.h" // Vendor
+#include "CrystalMem/vendor/concept.h" // AnyVendor
+#include "option.h" // MonotonicArenaOptions
+
+namespace crystal::mem {
+
+using std::move, std::is_same_v, std::construct_at;
+
+/**
+ * A memory pool that bumps a pointer through a chain of blocks, for objects
+ * that all die together, e.g. of `LongevityCa::Tmp` or `LongevityCa::Instant`.
+ *
+ * Allocating aligns the pointer and moves it past the request, going on to
+ * the next block when the current one is used up (see `BumpBlockChain`).
+ * Deallocating does nothing, except for the last allocation, which is bumped
+ * back so that stack-like use reuses its memory. The memory is only given
+ * back as a whole by `Clear`, which keeps the first `block_retention` blocks
+ * to bump through again, so resetting an arena that has warmed up takes
+ * constant time.
+ *
+ * @tparam kBlockSize The block size to bump through. Blocks are aligned to
+ * their size.
+ * @tparam ResourceVendor The vendor to request data memory from. Since this
+ * pool doesn't have in-memory optimization, memory obtained from this vendor
+ * will not be operated on.
+ * @tparam LogicVendor The vendor to request memory for allocating logic state.
+ * @tparam kOptions See `MonotonicArenaOptions`.
+ */
+template <size_t kBlockSize,
+          AnyVendor ResourceVendor,
+          AnyVendor LogicVendor = ResourceVendor,
+          MonotonicArenaOptions kOptions = MonotonicArenaOptions{}>
+requires (lowbit(kBlockSize) == kBlockSize)
+class MonotonicArenaPool {
+ public:
+  using Chain = BumpBlockChain<kBlockSize, LogicVendor>;
+  /* Allocations larger or more aligned than a block. */
+  using LargeMap = LargeAllocMap<kBlockSize + 1, LogicVendor>;
+
+  /* Attributes */
+  static constexpr bool kInMemoryOptimization = false;
+
+  /* Constructor */
+  MonotonicArenaPool(const ResourceVendor& vendor)
+      requires is_same_v<ResourceVendor, LogicVendor>
+      : MonotonicArenaPool(vendor, vendor) {
+  }
+  MonotonicArenaPool(const ResourceVendor& resource_vendor,
+                     const LogicVendor& logic_vendor) :
+      resource_vendor_(resource_vendor),
+      chain_(logic_vendor),
+      large_allocs_(logic_vendor) {
+  }
+  /* No Copying */
+  MonotonicArenaPool(const MonotonicArenaPool&) = delete;
+  /* Move Constructor */
+  MonotonicArenaPool(MonotonicArenaPool&& other) :
+      resource_vendor_(other.resource_vendor_),
+      chain_(move(other.chain_)),
+      large_allocs_(move(other.large_allocs_)) {
+  }
+  /* No Copying */
+  MonotonicArenaPool& operator=(const MonotonicArenaPool&) = delete;
+  MonotonicArenaPool& operator=(MonotonicArenaPool&& rhs) {
+    Clear();
+    chain_.Clear(resource_vendor_, 0);
+    resource_vendor_ = rhs.resource_vendor_;
+    chain_ = move(rhs.chain_);
+    large_allocs_ = move(rhs.large_allocs_);
+    return *this;
+  }
+  /* Destructor */
+  ~MonotonicArenaPool() {
+    Clear();
+    chain_.Clear(resource_vendor_, 0);
+  }
+
+  /* Functions */
+  template <typename T>
+  T* DiscreteAlloc() {
+    return reinterpret_cast<T*>(
+        RawAlloc(sizeof(T), static_cast<align_t>(alignof(T))));
+  }
+  template <typename T>
+  void DiscreteDealloc(T* ptr) {
+    RawDealloc(ptr, sizeof(T), static_cast<align_t>(alignof(T)));
+  }
+  template <typename T>
+  T* ContinuousAlloc(size_t n) {
+    return reinterpret_cast<T*>(
+        RawAlloc(sizeof(T) * n, static_cast<align_t>(alignof(T))));
+  }
+  template <typename T>
+  void ContinuousDealloc(T* ptr, size_t n) {
+    RawDealloc(ptr, sizeof(T) * n, static_cast<align_t>(alignof(T)));
+  }
+  /**
+   * Allocate an array of exactly `n` objects, the room after the last array
+   * is only taken by growing it with `TryExpandInPlace`.
+   *
+   * @return The array and `n`.
+   */
+  template <typename T>
+  AllocationResult<T*> ContinuousAllocAtLeast(size_t n) {
+    return { ContinuousAlloc<T>(n), n };
+  }
+  /**
+   * Grow an array from `old_n` to `new_n` objects, which succeeds for the
+   * last allocation while it fits in its block, or within a large allocation.
+   *
+   * @return Whether the array grew, otherwise it is left as is.
+   */
+  template <typename T>
+  bool TryExpandInPlace(T* ptr, size_t old_n, size_t new_n) {
+    constexpr align_t kAlign = static_cast<align_t>(alignof(T));
+    size_t old_size = sizeof(T) * old_n, new_size = sizeof(T) * new_n;
+    if (!Chain::Fits(old_size, kAlign))
+      return new_size <= large_allocs_.Size(ptr);
+    return chain_.TryResize(ptr, old_size, new_size);
+  }
+  /**
+   * Shrink an array from `old_n` to `new_n` objects, `new_n <= old_n`. Only
+   * the tail of the last allocation is reused, like deallocating.
+   *
+   * @return Whether the array shrank, otherwise it keeps its old size, e.g.
+   * when a large allocation would fit in a block.
+   */
+  template <typename T>
+  bool Shrink(T* ptr, size_t old_n, size_t new_n) {
+    constexpr align_t kAlign = static_cast<align_t>(alignof(T));
+    size_t old_size = sizeof(T) * old_n, new_size = sizeof(T) * new_n;
+    if (!Chain::Fits(old_size, kAlign)) return !Chain::Fits(new_size, kAlign);
+    chain_.TryResize(ptr, old_size, new_size);
+    return true;
+  }
+  void* RawAlloc(size_t size, align_t align) {
+    if (!Chain::Fits(size, align))
+      return large_allocs_.Alloc(resource_vendor_, size, align);
+    return chain_.Alloc(resource_vendor_, size, align);
+  }
+  void RawDealloc(void* ptr, size_t size, align_t align) {
+    if (!Chain::Fits(size, align)) large_allocs_.Dealloc(resource_vendor_, ptr);
+    else chain_.Dealloc(ptr, size);
+  }
+  template <typename T, typename ...Args>
+  T* New(Args&&... args) {
+    T* addr = DiscreteAlloc<T>();
+    construct_at(addr, args...);
+    return addr;
+  }
+  template <typename T>
+  void Del(T* ptr) {
+    ptr->~T();
+    DiscreteDealloc(ptr);
+  }
+  /**
+   * Give back everything allocated at once. The kept blocks are bumped
+   * through again from the first one.
+   */
+  void Clear() {
+    chain_.Clear(resource_vendor_, kOptions.block_retention);
+    /* Clear external allocations. */
+    large_allocs_.Clear(resource_vendor_);
+  }
+
+ private:
+  /* Variables */
+  ResourceVendor resource_vendor_;
+  Chain chain_;
+  LargeMap large_allocs_;
+};
+static_assert(AnyPool<MonotonicArenaPool<4_kB, Vendor<OSResource>>>);
+
+} // namespace crystal::mem
+
+#endif
@@ -0,0 +1,28 @@
+#ifndef CRYSTALMEM_POOL_MONOTONIC_ARENA_OPTION_H_
+#define CRYSTALMEM_POOL_MONOTONIC_ARENA_OPTION_H_
+
+#include "CrystalMem/type.h" // size_t
+
+namespace crystal::mem {
+
+/**
+ * Tuning knobs of a `MonotonicArenaPool`.
+ *
+ * This is a structural type so that it can be passed as a template argument,
+ * e.g. `MonotonicArenaOptions{ .block_retention = 4 }` as the last argument
+ * of `MonotonicArenaPool`.
+ */
+struct MonotonicArenaOptions {
+  /**
+   * Number of blocks the arena keeps across `Clear`.
+   *
+   * The kept blocks are bumped through again after a reset, so an arena that
+   * is cleared after every request stops asking the vendor for memory once
+   * it has seen its largest request. Blocks past this count are released.
+   */
+  size_t block_retention = 1;
+};
+
+} // namespace crystal::mem
+
+#endif
@@ -0,0 +1,199 @@
+#ifndef CRYSTALMEM_POOL_PAGE_MAP_H_
+#define CRYSTALMEM_POOL_PAGE_MAP_H_
+
+#include <CrystalBase/bitwise.h> // lowbit
+
+#include <array> // std::array
+#include <atomic> // std::atomic
+#include <bit> // std::countr_zero
+#include <memory> // std::construct_at
+
+#include "CrystalMem/type.h" // size_t
+#include "CrystalMem/vendor/concept.h" // AnyVendor
+
+namespace crystal::mem {
+
+using std::array, std::atomic, std::countr_zero, std::construct_at,
+    std::memory_order_acquire, std::memory_order_release,
+    std::memory_order_relaxed;
+
+/**
+ * A radix tree from page numbers to values.
+ *
+ * Addresses are split into pages of `kPageSize` bytes, and the page number is
+ * resolved through three levels of nodes. Nodes are allocated from the vendor
+ * the first time a page under them is set and only released by `Clear`, so
+ * lookups are a fixed number of loads and setting an already mapped page never
+ * allocates. Pages that were never set map to a value initialized `Value`.
+ *
+ * Only the low 48 bits of an address are used.
+ *
+ * Threading:
+ *  Nodes are installed with a compare and swap, so `Get` and `Set` may be
+ *  called concurrently as long as no two threads set the same page. `Clear`
+ *  and moves need exclusive access.
+ *
+ * Memory Responsibilities:
+ * This class is responsible for releasing all its nodes.
+ */
+template <size_t kPageSize, typename Value, AnyVendor Vendor>
+requires (lowbit(kPageSize) == kPageSize) // size must be some power of 2
+class PageMap {
+ public:
+  /* Constants */
+  static constexpr size_t kAddressBits = 48;
+  static constexpr size_t kPageShift = countr_zero(kPageSize);
+  static constexpr size_t kKeyBits = kAddressBits - kPageShift;
+  static constexpr size_t kLeafBits = (kKeyBits + 2) / 3;
+  static constexpr size_t kMidBits = (kKeyBits + 1) / 3;
+  static constexpr size_t kRootBits = kKeyBits - kLeafBits - kMidBits;
+
+  /* Constructor */
+  PageMap(const Vendor& vendor) : vendor_(vendor) {
+  }
+  /* Destructor */
+  ~PageMap() {
+    Clear();
+  }
+  /* No Copying */
+  PageMap(const PageMap& other) = delete;
+  /* Move Constructor */
+  PageMap(PageMap&& other) :
+      vendor_(other.vendor_),
+      root_(other.root_.exchange(nullptr, memory_order_relaxed)) {
+  }
+  /* No Copying */
+  PageMap& operator=(const PageMap& rhs) = delete;
+  /* Move Assignment */
+  PageMap& operator=(PageMap&& rhs) {
+    Clear();
+    vendor_ = rhs.vendor_;
+    root_.store(rhs.root_.exchange(nullptr, memory_order_relaxed),
+                memory_order_relaxed);
+    return *this;
+  }
+
+  /* Functions */
+  /**
+   * Get the value of the page that holds `addr`.
+   */
+  Value Get(const void* addr) const {
+    size_t key = Key(addr);
+    Root* root = root_.load(memory_order_acquire);
+    if (!root) return Value{};
+    Mid* mid = root->mids[key >> (kLeafBits + kMidBits)].load(
+        memory_order_acquire);
+    if (!mid) return Value{};
+    Leaf* leaf =
+        mid->leaves[(key >> kLeafBits) & kMidMask].load(memory_order_acquire);
+    if (!leaf) return Value{};
+    return leaf->values[key & kLeafMask];
+  }
+  /**
+   * Set the value of every page in `[addr, addr + size)`.
+   */
+  void Set(const void* addr, size_t size, Value value) {
+    size_t first = Key(addr);
+    size_t last = Key(static_cast<const char*>(addr) + size - 1);
+    for (size_t key = first; key <= last; ++key) Slot(key) = value;
+  }
+  /**
+   * Call `func(page, value)` for every page that maps to a value other than
+   * `Value{}`, in address order.
+   */
+  template <typename Func>
+  void ForEach(Func&& func) const {
+    Root* root = root_.load(memory_order_acquire);
+    if (!root) return;
+    for (size_t i = 0; i < root->mids.size(); ++i) {
+      Mid* mid = root->mids[i].load(memory_order_acquire);
+      if (!mid) continue;
+      for (size_t j = 0; j < mid->leaves.size(); ++j) {
+        Leaf* leaf = mid->leaves[j].load(memory_order_acquire);
+        if (!leaf) continue;
+        for (size_t k = 0; k < leaf->values.size(); ++k) {
+          if (leaf->values[k] == Value{}) continue;
+          size_t key = (((i << kMidBits) | j) << kLeafBits) | k;
+          func(reinterpret_cast<void*>(key << kPageShift), leaf->values[k]);
+        }
+      }
+    }
+  }
+  /**
+   * Release all nodes, every page maps to `Value{}` again.
+   */
+  void Clear() {
+    Root* root = root_.exchange(nullptr, memory_order_relaxed);
+    if (!root) return;
+    for (auto& mid_link : root->mids) {
+      Mid* mid = mid_link.load(memory_order_relaxed);
+      if (!mid) continue;
+      for (auto& leaf_link : mid->leaves)
+        if (Leaf* leaf = leaf_link.load(memory_order_relaxed)) Release(leaf);
+      Release(mid);
+    }
+    Release(root);
+  }
+
+ private:
+  static constexpr size_t kMidMask = (size_t{ 1 } << kMidBits) - 1;
+  static constexpr size_t kLeafMask = (size_t{ 1 } << kLeafBits) - 1;
+
+  struct Leaf {
+    array<Value, size_t{ 1 } << kLeafBits> values{};
+  };
+  struct Mid {
+    array<atomic<Leaf*>, size_t{ 1 } << kMidBits> leaves{};
+  };
+  struct Root {
+    array<atomic<Mid*>, size_t{ 1 } << kRootBits> mids{};
+  };
+
+  /* Variables */
+  Vendor vendor_;
+  atomic<Root*> root_ = nullptr;
+
+  /* Functions */
+  static size_t Key(const void* addr) {
+    return (reinterpret_cast<size_t>(addr) >> kPageShift)
+         & ((size_t{ 1 } << kKeyBits) - 1);
+  }
+  /**
+   * Get the value slot of a page, allocating the nodes on the way.
+   */
+  Value& Slot(size_t key) {
+    Root* root = Install(root_);
+    Mid* mid = Install(root->mids[key >> (kLeafBits + kMidBits)]);
+    Leaf* leaf = Install(mid->leaves[(key >> kLeafBits) & kMidMask]);
+    return leaf->values[key & kLeafMask];
+  }
+  /**
+   * Get the node of a link, creating it if there is none yet.
+   */
+  template <typename Node>
+  Node* Install(atomic<Node*>& link) {
+    Node* node = link.load(memory_order_acquire);
+    if (node) [[likely]] return node;
+    Node* new_node = Create<Node>();
+    if (link.compare_exchange_strong(
+            node, new_node, memory_order_release, memory_order_acquire))
+      return new_node;
+    /* Another thread won the race. */
+    Release(new_node);
+    return node;
+  }
+  template <typename Node>
+  Node* Create() {
+    return construct_at(reinterpret_cast<Node*>(vendor_.Alloc(
+        sizeof(Node), static_cast<align_t>(alignof(Node)))));
+  }
+  template <typename Node>
+  void Release(Node* node) {
+    node->~Node();
+    vendor_.Dealloc(node, sizeof(Node), static_cast<align_t>(alignof(Node)));
+  }
+};
+
+} // namespace crystal::mem
+
+#endif
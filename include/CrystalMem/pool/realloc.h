@@ -0,0 +1,37 @@
+#ifndef CRYSTALMEM_POOL_REALLOC_H_
+#define CRYSTALMEM_POOL_REALLOC_H_
+
+#include <algorithm> // std::min
+#include <cstring> // std::memcpy
+#include <type_traits> // std::is_trivially_copyable_v
+
+#include "CrystalMem/pool/concept.h" // AnyPool
+#include "CrystalMem/type.h" // size_t
+
+namespace crystal::mem {
+
+using std::min, std::memcpy, std::is_trivially_copyable_v;
+
+/**
+ * Resize an array of a pool, in place with its `Shrink` or `TryExpandInPlace`
+ * if possible, otherwise by copying it to a new allocation.
+ *
+ * @return The array, **OR** `nullptr` if allocating failed, in which case the
+ * old array is left as is.
+ */
+template <typename T, AnyPool Pool>
+requires is_trivially_copyable_v<T>
+T* Realloc(Pool& pool, T* ptr, size_t old_n, size_t new_n) {
+  if (new_n <= old_n ? pool.template Shrink<T>(ptr, old_n, new_n)
+                     : pool.template TryExpandInPlace<T>(ptr, old_n, new_n))
+    return ptr;
+  T* new_ptr = pool.template ContinuousAlloc<T>(new_n);
+  if (!new_ptr) [[unlikely]] return nullptr;
+  memcpy(new_ptr, ptr, sizeof(T) * min(old_n, new_n));
+  pool.template ContinuousDealloc<T>(ptr, old_n);
+  return new_ptr;
+}
+
+} // namespace crystal::mem
+
+#endif
@@ -0,0 +1,575 @@
+#ifndef CRYSTALMEM_POOL_SAFE_BEST_FIT_BTREE_H_
+#define CRYSTALMEM_POOL_SAFE_BEST_FIT_BTREE_H_
+
+#include <algorithm> // std::lower_bound, std::upper_bound, std::max
+#include <array> // std::array
+#include <cstddef> // ptrdiff_t
+#include <cstdint> // uint32_t
+#include <functional> // std::identity, std::less
+#include <iterator> // std::bidirectional_iterator_tag
+#include <memory> // std::allocator_traits, std::construct_at
+#include <type_traits> // std::remove_cvref_t, std::invoke_result_t
+#include <utility> // std::exchange, std::pair
+
+#include "CrystalMem/type.h" // size_t
+
+namespace crystal::mem {
+
+using std::array, std::max, std::identity, std::less, std::allocator_traits,
+    std::construct_at, std::remove_cvref_t, std::invoke_result_t,
+    std::exchange, std::pair, std::bidirectional_iterator_tag;
+
+/**
+ * Key extractor of the values of a map.
+ */
+struct FirstOf {
+  template <typename Pair>
+  constexpr const auto& operator()(const Pair& pair) const {
+    return pair.first;
+  }
+};
+
+/**
+ * An ordered container of unique keys, as a B+ tree with wide nodes.
+ *
+ * Values are stored sorted in leaves of about `kNodeSize` bytes that are
+ * linked in order, and inner nodes only hold separating keys, so a lookup
+ * touches a few contiguous nodes instead of a node per value, and a node is
+ * allocated or released only when a leaf splits or merges. Nodes other than
+ * the root are kept at least half full.
+ *
+ * The interface is the subset of `std::map` and `std::set` needed by its users.
+ * Inserting or erasing invalidates every iterator, and keys must not be
+ * modified through an iterator.
+ *
+ * @tparam Value The stored values, which must be default constructible.
+ * @tparam Allocator The allocator, rebound for the nodes.
+ * @tparam KeyOf Gets the key of a value, e.g. `FirstOf` for a map.
+ * @tparam kNodeSize The targeted size of a node in bytes.
+ */
+template <typename Value,
+          typename Allocator,
+          typename KeyOf = identity,
+          size_t kNodeSize = 256>
+class BPlusTree {
+ public:
+  using key_type = remove_cvref_t<invoke_result_t<KeyOf, const Value&>>;
+  using value_type = Value;
+  using allocator_type = Allocator;
+
+  /* Constants */
+  /* Values per leaf and keys per inner node, at least 4 to split in halves. */
+  static constexpr size_t kLeafSlots =
+      max<size_t>(4, (kNodeSize - 3 * sizeof(void*)) / sizeof(Value));
+  static constexpr size_t kInnerSlots = max<size_t>(
+      4, (kNodeSize - sizeof(void*)) / (sizeof(key_type) + sizeof(void*)));
+
+ private:
+  struct Leaf {
+    uint32_t n = 0;
+    Leaf* prev = nullptr;
+    Leaf* next = nullptr;
+    array<Value, kLeafSlots> values;
+  };
+  struct Inner {
+    /* Number of keys, there is one more child. */
+    uint32_t n = 0;
+    array<key_type, kInnerSlots> keys;
+    array<void*, kInnerSlots + 1> children;
+  };
+
+ public:
+  class iterator {
+   public:
+    using iterator_category = bidirectional_iterator_tag;
+    using value_type = Value;
+    using difference_type = ptrdiff_t;
+    using pointer = Value*;
+    using reference = Value&;
+
+    iterator() = default;
+
+    Value& operator*() const {
+      return leaf_->values[i_];
+    }
+    Value* operator->() const {
+      return &leaf_->values[i_];
+    }
+    iterator& operator++() {
+      if (++i_ == leaf_->n && leaf_->next) {
+        leaf_ = leaf_->next;
+        i_ = 0;
+      }
+      return *this;
+    }
+    iterator operator++(int) {
+      iterator old = *this;
+      ++*this;
+      return old;
+    }
+    iterator& operator--() {
+      if (i_ == 0) {
+        leaf_ = leaf_->prev;
+        i_ = leaf_->n;
+      }
+      --i_;
+      return *this;
+    }
+    iterator operator--(int) {
+      iterator old = *this;
+      --*this;
+      return old;
+    }
+    bool operator==(const iterator& rhs) const = default;
+
+   private:
+    friend class BPlusTree;
+    Leaf* leaf_ = nullptr;
+    uint32_t i_ = 0;
+
+    /* The end of a leaf other than the last is the start of the next one. */
+    iterator(Leaf* leaf, uint32_t i) : leaf_(leaf), i_(i) {
+      if (leaf_ && i_ == leaf_->n && leaf_->next) {
+        leaf_ = leaf_->next;
+        i_ = 0;
+      }
+    }
+  };
+
+  /* Constructor */
+  BPlusTree(const Allocator& allocator) : allocator_(allocator) {
+  }
+  /* No Copying */
+  BPlusTree(const BPlusTree&) = delete;
+  /* Move Constructor */
+  BPlusTree(BPlusTree&& other) :
+      allocator_(other.allocator_),
+      root_(exchange(other.root_, nullptr)),
+      height_(exchange(other.height_, 0)),
+      first_(exchange(other.first_, nullptr)),
+      last_(exchange(other.last_, nullptr)),
+      size_(exchange(other.size_, 0)) {
+  }
+  /* No Copying */
+  BPlusTree& operator=(const BPlusTree&) = delete;
+  BPlusTree& operator=(BPlusTree&& rhs) {
+    clear();
+    allocator_ = rhs.allocator_;
+    root_ = exchange(rhs.root_, nullptr);
+    height_ = exchange(rhs.height_, 0);
+    first_ = exchange(rhs.first_, nullptr);
+    last_ = exchange(rhs.last_, nullptr);
+    size_ = exchange(rhs.size_, 0);
+    return *this;
+  }
+  /* Destructor */
+  ~BPlusTree() {
+    clear();
+  }
+
+  /* Functions */
+  iterator begin() const {
+    return iterator(first_, 0);
+  }
+  iterator end() const {
+    return iterator(last_, last_ ? last_->n : 0);
+  }
+  size_t size() const {
+    return size_;
+  }
+  bool empty() const {
+    return !size_;
+  }
+  /**
+   * Get the first value whose key is not less than `key`.
+   */
+  iterator lower_bound(const key_type& key) const {
+    if (!root_) return end();
+    Leaf* leaf = FindLeaf(key);
+    return iterator(leaf, LowerBound(leaf, key));
+  }
+  /**
+   * Get the first value whose key is greater than `key`.
+   */
+  iterator upper_bound(const key_type& key) const {
+    if (!root_) return end();
+    Leaf* leaf = FindLeaf(key);
+    auto value = std::upper_bound(
+        leaf->values.begin(), leaf->values.begin() + leaf->n, key,
+        [](const key_type& target, const Value& value) {
+          return less<>{}(target, KeyOf{}(value));
+        });
+    return iterator(leaf, value - leaf->values.begin());
+  }
+  iterator find(const key_type& key) const {
+    iterator value = lower_bound(key);
+    if (value == end() || less<>{}(key, KeyOf{}(*value))) return end();
+    return value;
+  }
+  /**
+   * Insert a value constructed from `args`, unless its key is present.
+   *
+   * @return Whether the value was inserted.
+   */
+  template <typename ...Args>
+  bool emplace(Args&&... args) {
+    Value value(std::forward<Args>(args)...);
+    if (!root_) root_ = first_ = last_ = NewLeaf();
+    Split split;
+    if (!Insert(root_, 0, value, split)) return false;
+    ++size_;
+    if (split.right) {
+      /* Grow a new root above the split one. */
+      Inner* root = NewInner();
+      root->n = 1;
+      root->keys[0] = split.key;
+      root->children[0] = root_;
+      root->children[1] = split.right;
+      root_ = root;
+      ++height_;
+    }
+    return true;
+  }
+  /**
+   * Erase the value with the key `key`, if any.
+   *
+   * @return The number of erased values.
+   */
+  size_t erase(const key_type& key) {
+    if (!root_ || !Erase(root_, 0, key)) return 0;
+    --size_;
+    /* Shrink the tree from the top, an empty root leaf is kept until
+     * `clear`. */
+    if (height_) {
+      Inner* root = reinterpret_cast<Inner*>(root_);
+      if (!root->n) {
+        root_ = root->children[0];
+        --height_;
+        DelInner(root);
+      }
+    }
+    return 1;
+  }
+  void erase(iterator value) {
+    Leaf* leaf = value.leaf_;
+    if (leaf->n > kMinLeaf || leaf == root_) {
+      /* Nothing to rebalance, erase within the leaf. */
+      std::move(leaf->values.begin() + value.i_ + 1,
+                leaf->values.begin() + leaf->n,
+                leaf->values.begin() + value.i_);
+      --leaf->n;
+      --size_;
+      return;
+    }
+    /* The key is copied, its storage moves during erasure. */
+    key_type key = KeyOf{}(*value);
+    erase(key);
+  }
+  void clear() {
+    if (root_) Del(root_, 0);
+    root_ = first_ = last_ = nullptr;
+    height_ = size_ = 0;
+  }
+
+ private:
+  using LeafAllocator =
+      allocator_traits<Allocator>::template rebind_alloc<Leaf>;
+  using InnerAllocator =
+      allocator_traits<Allocator>::template rebind_alloc<Inner>;
+  /* A node split off to the right during insertion, and its first key. */
+  struct Split {
+    key_type key{};
+    void* right = nullptr;
+  };
+
+  /* Variables */
+  Allocator allocator_;
+  void* root_ = nullptr;
+  /* Number of inner levels, leaves are at this depth. */
+  size_t height_ = 0;
+  Leaf* first_ = nullptr;
+  Leaf* last_ = nullptr;
+  size_t size_ = 0;
+
+  /* Constants */
+  static constexpr size_t kMinLeaf = kLeafSlots / 2;
+  static constexpr size_t kMinInner = kInnerSlots / 2;
+
+  /* Functions */
+  static size_t LowerBound(const Leaf* leaf, const key_type& key) {
+    return std::lower_bound(
+               leaf->values.begin(), leaf->values.begin() + leaf->n, key,
+               [](const Value& value, const key_type& target) {
+                 return less<>{}(KeyOf{}(value), target);
+               })
+           - leaf->values.begin();
+  }
+  /**
+   * Get the child of an inner node that may hold `key`.
+   */
+  static size_t ChildIndex(const Inner* inner, const key_type& key) {
+    return std::upper_bound(
+               inner->keys.begin(), inner->keys.begin() + inner->n, key,
+               less<>{})
+           - inner->keys.begin();
+  }
+  Leaf* FindLeaf(const key_type& key) const {
+    void* node = root_;
+    for (size_t depth = 0; depth < height_; ++depth) {
+      Inner* inner = reinterpret_cast<Inner*>(node);
+      node = inner->children[ChildIndex(inner, key)];
+    }
+    return reinterpret_cast<Leaf*>(node);
+  }
+  /**
+   * Insert into the subtree at `node`, filling `split` if the node had to be
+   * split.
+   */
+  bool Insert(void* node, size_t depth, Value& value, Split& split) {
+    const key_type& key = KeyOf{}(value);
+    if (depth == height_) {
+      Leaf* leaf = reinterpret_cast<Leaf*>(node);
+      size_t i = LowerBound(leaf, key);
+      if (i < leaf->n && !less<>{}(key, KeyOf{}(leaf->values[i])))
+        return false;
+      if (leaf->n == kLeafSlots) {
+        /* Move the upper half to a new leaf, then insert into either. */
+        Leaf* right = NewLeaf();
+        size_t mid = (kLeafSlots + 1) / 2;
+        std::move(leaf->values.begin() + mid, leaf->values.end(),
+                  right->values.begin());
+        right->n = kLeafSlots - mid;
+        leaf->n = mid;
+        right->prev = leaf;
+        right->next = leaf->next;
+        if (right->next) right->next->prev = right;
+        else last_ = right;
+        leaf->next = right;
+        if (i <= mid) LeafInsert(leaf, i, value);
+        else LeafInsert(right, i - mid, value);
+        split.key = KeyOf{}(right->values[0]);
+        split.right = right;
+      } else LeafInsert(leaf, i, value);
+      return true;
+    }
+    Inner* inner = reinterpret_cast<Inner*>(node);
+    size_t i = ChildIndex(inner, key);
+    Split child_split;
+    if (!Insert(inner->children[i], depth + 1, value, child_split))
+      return false;
+    if (!child_split.right) return true;
+    if (inner->n < kInnerSlots) {
+      InnerInsert(inner, i, child_split);
+      return true;
+    }
+    /* Insert into a full node, then move the upper half to a new node and the
+     * middle key up. */
+    array<key_type, kInnerSlots + 1> keys;
+    array<void*, kInnerSlots + 2> children;
+    std::move(inner->keys.begin(), inner->keys.begin() + i, keys.begin());
+    keys[i] = child_split.key;
+    std::move(inner->keys.begin() + i, inner->keys.end(), keys.begin() + i + 1);
+    std::move(inner->children.begin(), inner->children.begin() + i + 1,
+              children.begin());
+    children[i + 1] = child_split.right;
+    std::move(inner->children.begin() + i + 1, inner->children.end(),
+              children.begin() + i + 2);
+    size_t mid = (kInnerSlots + 1) / 2;
+    Inner* right = NewInner();
+    inner->n = mid;
+    right->n = kInnerSlots - mid;
+    std::move(keys.begin(), keys.begin() + mid, inner->keys.begin());
+    std::move(children.begin(), children.begin() + mid + 1,
+              inner->children.begin());
+    std::move(keys.begin() + mid + 1, keys.end(), right->keys.begin());
+    std::move(children.begin() + mid + 1, children.end(),
+              right->children.begin());
+    split.key = keys[mid];
+    split.right = right;
+    return true;
+  }
+  static void LeafInsert(Leaf* leaf, size_t i, Value& value) {
+    std::move_backward(leaf->values.begin() + i,
+                       leaf->values.begin() + leaf->n,
+                       leaf->values.begin() + leaf->n + 1);
+    leaf->values[i] = std::move(value);
+    ++leaf->n;
+  }
+  /**
+   * Add the node split off from child `i` right after it.
+   */
+  static void InnerInsert(Inner* inner, size_t i, const Split& split) {
+    std::move_backward(inner->keys.begin() + i,
+                       inner->keys.begin() + inner->n,
+                       inner->keys.begin() + inner->n + 1);
+    std::move_backward(inner->children.begin() + i + 1,
+                       inner->children.begin() + inner->n + 1,
+                       inner->children.begin() + inner->n + 2);
+    inner->keys[i] = split.key;
+    inner->children[i + 1] = split.right;
+    ++inner->n;
+  }
+  /**
+   * Erase from the subtree at `node`, leaving it possibly less than half
+   * full for the parent to fix.
+   */
+  bool Erase(void* node, size_t depth, const key_type& key) {
+    if (depth == height_) {
+      Leaf* leaf = reinterpret_cast<Leaf*>(node);
+      size_t i = LowerBound(leaf, key);
+      if (i == leaf->n || less<>{}(key, KeyOf{}(leaf->values[i])))
+        return false;
+      std::move(leaf->values.begin() + i + 1,
+                leaf->values.begin() + leaf->n,
+                leaf->values.begin() + i);
+      --leaf->n;
+      return true;
+    }
+    Inner* inner = reinterpret_cast<Inner*>(node);
+    size_t i = ChildIndex(inner, key);
+    if (!Erase(inner->children[i], depth + 1, key)) return false;
+    if (depth + 1 == height_) FixLeaf(inner, i);
+    else FixInner(inner, i);
+    return true;
+  }
+  /**
+   * Refill leaf `i` of `parent` from a sibling, or merge it with one.
+   */
+  void FixLeaf(Inner* parent, size_t i) {
+    Leaf* leaf = reinterpret_cast<Leaf*>(parent->children[i]);
+    if (leaf->n >= kMinLeaf) return;
+    Leaf* left = i ? reinterpret_cast<Leaf*>(parent->children[i - 1]) : nullptr;
+    Leaf* right = i < parent->n
+                      ? reinterpret_cast<Leaf*>(parent->children[i + 1])
+                      : nullptr;
+    if (left && left->n > kMinLeaf) {
+      LeafInsert(leaf, 0, left->values[--left->n]);
+      parent->keys[i - 1] = KeyOf{}(leaf->values[0]);
+    } else if (right && right->n > kMinLeaf) {
+      leaf->values[leaf->n++] = std::move(right->values[0]);
+      std::move(right->values.begin() + 1,
+                right->values.begin() + right->n,
+                right->values.begin());
+      --right->n;
+      parent->keys[i] = KeyOf{}(right->values[0]);
+    } else if (left) MergeLeaves(parent, i - 1);
+    else if (right) MergeLeaves(parent, i);
+  }
+  /**
+   * Move leaf `i + 1` of `parent` into leaf `i`.
+   */
+  void MergeLeaves(Inner* parent, size_t i) {
+    Leaf* leaf = reinterpret_cast<Leaf*>(parent->children[i]);
+    Leaf* right = reinterpret_cast<Leaf*>(parent->children[i + 1]);
+    std::move(right->values.begin(), right->values.begin() + right->n,
+              leaf->values.begin() + leaf->n);
+    leaf->n += right->n;
+    leaf->next = right->next;
+    if (leaf->next) leaf->next->prev = leaf;
+    else last_ = leaf;
+    DelLeaf(right);
+    InnerErase(parent, i);
+  }
+  /**
+   * Refill inner node `i` of `parent` from a sibling, rotating through the
+   * parent's key, or merge it with one.
+   */
+  void FixInner(Inner* parent, size_t i) {
+    Inner* inner = reinterpret_cast<Inner*>(parent->children[i]);
+    if (inner->n >= kMinInner) return;
+    Inner* left =
+        i ? reinterpret_cast<Inner*>(parent->children[i - 1]) : nullptr;
+    Inner* right = i < parent->n
+                       ? reinterpret_cast<Inner*>(parent->children[i + 1])
+                       : nullptr;
+    if (left && left->n > kMinInner) {
+      std::move_backward(inner->keys.begin(),
+                         inner->keys.begin() + inner->n,
+                         inner->keys.begin() + inner->n + 1);
+      std::move_backward(inner->children.begin(),
+                         inner->children.begin() + inner->n + 1,
+                         inner->children.begin() + inner->n + 2);
+      inner->keys[0] = parent->keys[i - 1];
+      inner->children[0] = left->children[left->n];
+      parent->keys[i - 1] = left->keys[left->n - 1];
+      --left->n;
+      ++inner->n;
+    } else if (right && right->n > kMinInner) {
+      inner->keys[inner->n] = parent->keys[i];
+      inner->children[inner->n + 1] = right->children[0];
+      parent->keys[i] = right->keys[0];
+      std::move(right->keys.begin() + 1,
+                right->keys.begin() + right->n,
+                right->keys.begin());
+      std::move(right->children.begin() + 1,
+                right->children.begin() + right->n + 1,
+                right->children.begin());
+      --right->n;
+      ++inner->n;
+    } else if (left) MergeInners(parent, i - 1);
+    else if (right) MergeInners(parent, i);
+  }
+  /**
+   * Move inner node `i + 1` of `parent` into node `i`, with the key between
+   * them.
+   */
+  void MergeInners(Inner* parent, size_t i) {
+    Inner* inner = reinterpret_cast<Inner*>(parent->children[i]);
+    Inner* right = reinterpret_cast<Inner*>(parent->children[i + 1]);
+    inner->keys[inner->n] = parent->keys[i];
+    std::move(right->keys.begin(), right->keys.begin() + right->n,
+              inner->keys.begin() + inner->n + 1);
+    std::move(right->children.begin(),
+              right->children.begin() + right->n + 1,
+              inner->children.begin() + inner->n + 1);
+    inner->n += 1 + right->n;
+    DelInner(right);
+    InnerErase(parent, i);
+  }
+  /**
+   * Drop key `i` and child `i + 1` of an inner node.
+   */
+  static void InnerErase(Inner* inner, size_t i) {
+    std::move(inner->keys.begin() + i + 1,
+              inner->keys.begin() + inner->n,
+              inner->keys.begin() + i);
+    std::move(inner->children.begin() + i + 2,
+              inner->children.begin() + inner->n + 1,
+              inner->children.begin() + i + 1);
+    --inner->n;
+  }
+  Leaf* NewLeaf() {
+    LeafAllocator allocator(allocator_);
+    return construct_at(allocator.allocate(1));
+  }
+  Inner* NewInner() {
+    InnerAllocator allocator(allocator_);
+    return construct_at(allocator.allocate(1));
+  }
+  void DelLeaf(Leaf* leaf) {
+    LeafAllocator allocator(allocator_);
+    leaf->~Leaf();
+    allocator.deallocate(leaf, 1);
+  }
+  void DelInner(Inner* inner) {
+    InnerAllocator allocator(allocator_);
+    inner->~Inner();
+    allocator.deallocate(inner, 1);
+  }
+  /**
+   * Release the subtree at `node`.
+   */
+  void Del(void* node, size_t depth) {
+    if (depth == height_) {
+      DelLeaf(reinterpret_cast<Leaf*>(node));
+      return;
+    }
+    Inner* inner = reinterpret_cast<Inner*>(node);
+    for (size_t i = 0; i <= inner->n; ++i) Del(inner->children[i], depth + 1);
+    DelInner(inner);
+  }
+};
+
+} // namespace crystal::mem
+
+#endif
@@ -3,35 +3,87 @@
 
 #include <CrystalBase/bitwise.h> // lowbit
 
-#include <limits> // std::numeric_limits
 #include <map> // std::map
+#include <memory> // std::allocator_traits
 #include <optional> // std::optional
+#include <set> // std::set
 #include <tuple> // std::tuple
 #include <utility> // std::pair
 
 #include "CrystalMem/type.h" // size_t
+#include "btree.h" // BPlusTree, FirstOf
 
 namespace crystal::mem {
 
-using std::pair, std::optional, std::make_pair, std::map, std::tuple,
-    std::make_tuple, std::numeric_limits, std::get, std::prev, std::less,
-    std::move;
+using std::pair, std::optional, std::make_pair, std::map, std::set,
+    std::tuple, std::make_tuple, std::get, std::prev, std::less, std::move,
+    std::allocator_traits;
 
-template <typename Allocator>
+/**
+ * Free node indexes of a `SafeBestFitFreeMap` as red black trees, which
+ * allocate a tree node per free node.
+ */
+struct TreeFreeIndex {
+  template <typename Allocator>
+  using ByAddress = map<void*, size_t, less<void*>,
+                        typename allocator_traits<Allocator>::template
+                            rebind_alloc<pair<void* const, size_t>>>;
+  template <typename Allocator>
+  using BySize = set<pair<size_t, void*>, less<>,
+                     typename allocator_traits<Allocator>::template
+                         rebind_alloc<pair<size_t, void*>>>;
+};
+/**
+ * Free node indexes of a `SafeBestFitFreeMap` as B+ trees, which keep many
+ * free nodes sorted in each tree node, so that the neighbours of a node are
+ * usually in the same cache lines, and splitting or merging free nodes rarely
+ * allocates.
+ */
+struct BTreeFreeIndex {
+  template <typename Allocator>
+  using ByAddress = BPlusTree<pair<void*, size_t>, Allocator, FirstOf>;
+  template <typename Allocator>
+  using BySize = BPlusTree<pair<size_t, void*>, Allocator>;
+};
+
+/**
+ * The free memory of a best fit pool.
+ *
+ * Free nodes are kept twice: by address, to find the neighbours to merge with
+ * on deallocation, and by size, so the best fit is found from the smallest
+ * node that is large enough instead of by visiting every node. When many
+ * nodes are too short only because of alignment, a node up to `align - 1`
+ * bytes larger than the best fit may be chosen.
+ *
+ * @tparam Allocator The allocator of the address index, rebound for the size
+ * index.
+ * @tparam Index How the free nodes are indexed, `TreeFreeIndex` or
+ * `BTreeFreeIndex`.
+ */
+template <typename Allocator, typename Index = TreeFreeIndex>
 class SafeBestFitFreeMap {
  public:
   using allocator_type = Allocator;
 
+  /* Constants */
+  /* Free nodes tried that may be too short for the alignment. */
+  static constexpr size_t kFitProbes = 8;
+
   /* Constructor */
-  SafeBestFitFreeMap(const Allocator& allocator) : free_nodes_(allocator) {
+  SafeBestFitFreeMap(const Allocator& allocator) :
+      free_nodes_(AddressAllocator(allocator)),
+      free_sizes_(SizeAllocator(allocator)) {
   }
   SafeBestFitFreeMap(const SafeBestFitFreeMap& other) = delete;
   SafeBestFitFreeMap(SafeBestFitFreeMap&& other) :
-      free_nodes_(move(other.free_nodes_)) {
+      free_nodes_(move(other.free_nodes_)),
+      free_sizes_(move(other.free_sizes_)) {
   }
   SafeBestFitFreeMap& operator=(const SafeBestFitFreeMap& rhs) = delete;
   SafeBestFitFreeMap& operator=(SafeBestFitFreeMap&& rhs) {
     free_nodes_ = move(rhs.free_nodes_);
+    free_sizes_ = move(rhs.free_sizes_);
+    return *this;
   }
 
   /* Functions */
@@ -39,7 +91,9 @@ class SafeBestFitFreeMap {
    * Insert a new free node in to the map.
    */
   void InsertNode(void* addr, size_t size) {
-    free_nodes_[addr] = size;
+    auto node = free_nodes_.find(addr);
+    if (node != free_nodes_.end()) EraseNode(node);
+    Insert(addr, size);
   }
   /**
    * Try to allocate some memory with the input specifications.
@@ -48,82 +102,145 @@ class SafeBestFitFreeMap {
    * allocate.
    */
   void* Alloc(size_t size, align_t align) {
-    void* best_fit_addr = reinterpret_cast<void*>(-1ul);
-    tuple<size_t, size_t, size_t> best_fit_waste{
-      numeric_limits<size_t>::max(),
-      numeric_limits<size_t>::max(),
-      numeric_limits<size_t>::max()
-    };
-    /* Look through the free nodes for the best fit. */
-    for (auto& [node_addr, node_size] : free_nodes_) {
-      if (auto waste = Fit(node_addr, node_size, size, align)) {
-        if (*waste < best_fit_waste) {
-          best_fit_addr = node_addr;
-          best_fit_waste = *waste;
+    /* Fitting nodes of the same size waste the same in total, so the best fit
+     * is the first fit in size order. Nodes shorter than `sure_fit` may still
+     * be too short once aligned, so only a few of them are tried before
+     * settling for the first node that fits at any alignment, if any. */
+    size_t sure_fit = size + static_cast<size_t>(align) - 1;
+    auto best_fit =
+        free_sizes_.lower_bound(pair<size_t, void*>(size, nullptr));
+    for (size_t probes = 0; best_fit != free_sizes_.end();
+         ++probes, ++best_fit) {
+      if (best_fit->first >= sure_fit) break;
+      if (probes == kFitProbes) {
+        auto sure =
+            free_sizes_.lower_bound(pair<size_t, void*>(sure_fit, nullptr));
+        if (sure != free_sizes_.end()) {
+          best_fit = sure;
+          break;
         }
+        /* Only short nodes are left, so keep trying them. */
       }
+      if (Fit(best_fit->second, best_fit->first, size, align)) break;
     }
     /* No fit. */
-    if (reinterpret_cast<uint64_t>(best_fit_addr) == -1ul) {
-      return reinterpret_cast<void*>(-1ul);
-    }
-    /* Split the best fit node. */
-    size_t l_padding = get<1>(best_fit_waste);
-    size_t r_padding = get<2>(best_fit_waste);
-    /* Remove the node. */
-    free_nodes_.erase(best_fit_addr);
-    /* Add new nodes. */
-    if (l_padding) free_nodes_[best_fit_addr] = l_padding;
+    if (best_fit == free_sizes_.end()) return reinterpret_cast<void*>(-1ul);
+    auto [waste, l_padding, r_padding] =
+        *Fit(best_fit->second, best_fit->first, size, align);
+    /* Split the best fit node, the left padding keeps its address. */
+    void* best_fit_addr = best_fit->second;
+    free_sizes_.erase(best_fit);
+    auto node = free_nodes_.find(best_fit_addr);
+    if (l_padding) {
+      node->second = l_padding;
+      free_sizes_.emplace(l_padding, best_fit_addr);
+    } else free_nodes_.erase(node);
     if (r_padding)
-      free_nodes_[reinterpret_cast<void*>(
-          reinterpret_cast<size_t>(best_fit_addr) + l_padding + size)] =
-          r_padding;
+      Insert(reinterpret_cast<void*>(reinterpret_cast<size_t>(best_fit_addr)
+                                     + l_padding + size),
+             r_padding);
     return reinterpret_cast<void*>(reinterpret_cast<size_t>(best_fit_addr)
                                    + l_padding);
   }
+  /**
+   * Size of the free node at `addr`, **OR** 0 if no free node starts there.
+   */
+  size_t NodeSize(void* addr) const {
+    auto node = free_nodes_.find(addr);
+    return node == free_nodes_.end() ? 0 : node->second;
+  }
+  /**
+   * Whether a range is free, in a single free node.
+   */
+  bool IsFree(void* addr, size_t size) const {
+    auto node = free_nodes_.upper_bound(addr);
+    if (node == free_nodes_.begin()) return false;
+    --node;
+    return reinterpret_cast<size_t>(node->first) + node->second
+           >= reinterpret_cast<size_t>(addr) + size;
+  }
+  /**
+   * Take a range out of the free node that covers it, the parts of the node
+   * around it stay free.
+   */
+  void Remove(void* addr, size_t size) {
+    auto node = prev(free_nodes_.upper_bound(addr));
+    void* node_addr = node->first;
+    size_t l_free = reinterpret_cast<size_t>(addr)
+                    - reinterpret_cast<size_t>(node_addr);
+    size_t r_free = node->second - l_free - size;
+    EraseNode(node);
+    if (l_free) Insert(node_addr, l_free);
+    if (r_free)
+      Insert(reinterpret_cast<void*>(reinterpret_cast<size_t>(addr) + size),
+             r_free);
+  }
   /**
    * Deallocate a piece of memory.
+   *
+   * @return The free node the memory ends up in, after merging with its
+   * neighbours, **OR** `addr` and 0 if `size` is 0.
    */
-  void Dealloc(void* addr, size_t size, align_t align) {
+  pair<void*, size_t> Dealloc(void* addr, size_t size, align_t) {
+    /* An empty node would break merging. */
+    if (!size) [[unlikely]] return { addr, 0 };
     /* Look at left & right for merging. */
-    size_t l_free = 0, r_free = 0;
-    {
-      void* l_addr;
-      void* r_addr;
-
-      auto r_node = free_nodes_.lower_bound(addr);
-      if (r_node != free_nodes_.end()) {
-        r_addr = r_node->first;
-        size_t r_size = r_node->second;
-        if (reinterpret_cast<size_t>(addr) + size
-            == reinterpret_cast<size_t>(r_addr)) {
-          r_free = r_size;
-        }
-      }
-      if (r_node != free_nodes_.begin()) {
-        auto l_node = prev(r_node);
-        l_addr = l_node->first;
-        size_t l_size = l_node->second;
-        if (reinterpret_cast<size_t>(l_addr) + l_size
-            == reinterpret_cast<size_t>(addr)) {
-          l_free = l_size;
-        }
+    size_t r_free = 0;
+    auto r_node = free_nodes_.lower_bound(addr);
+    if (r_node != free_nodes_.end()
+        && reinterpret_cast<size_t>(addr) + size
+               == reinterpret_cast<size_t>(r_node->first)) {
+      r_free = r_node->second;
+    }
+    if (r_node != free_nodes_.begin()) {
+      auto l_node = prev(r_node);
+      void* l_addr = l_node->first;
+      size_t l_size = l_node->second;
+      if (reinterpret_cast<size_t>(l_addr) + l_size
+          == reinterpret_cast<size_t>(addr)) {
+        /* Grow the left node in place, before erasing anything moves it. */
+        size_t node_size = l_size + size + r_free;
+        l_node->second = node_size;
+        free_sizes_.erase(make_pair(l_size, l_addr));
+        free_sizes_.emplace(node_size, l_addr);
+        if (r_free) EraseNode(r_node);
+        return { l_addr, node_size };
       }
-
-      if (l_free) free_nodes_.erase(l_addr);
-      if (r_free) free_nodes_.erase(r_addr);
     }
+    if (r_free) EraseNode(r_node);
 
     /* Insert new free node. */
-    free_nodes_[reinterpret_cast<void*>(reinterpret_cast<size_t>(addr)
-                                        - l_free)] = l_free + size + r_free;
+    Insert(addr, size + r_free);
+    return { addr, size + r_free };
+  }
+  /**
+   * Forget every free node.
+   */
+  void Clear() {
+    free_nodes_.clear();
+    free_sizes_.clear();
   }
 
  private:
+  using AddressIndex = Index::template ByAddress<Allocator>;
+  using SizeIndex = Index::template BySize<Allocator>;
+  using AddressAllocator = AddressIndex::allocator_type;
+  using SizeAllocator = SizeIndex::allocator_type;
+
   /* Variables */
-  map<void*, size_t, less<void*>, Allocator> free_nodes_;
+  AddressIndex free_nodes_;
+  /* The same nodes ordered by size, then address. */
+  SizeIndex free_sizes_;
 
   /* Functions */
+  void Insert(void* addr, size_t size) {
+    free_nodes_.emplace(addr, size);
+    free_sizes_.emplace(size, addr);
+  }
+  void EraseNode(decltype(free_nodes_)::iterator node) {
+    free_sizes_.erase(make_pair(node->second, node->first));
+    free_nodes_.erase(node);
+  }
   auto Fit(void* node_addr, size_t node_size, size_t size, align_t align)
       -> optional<tuple<size_t, size_t, size_t>> {
     uint64_t align_val = static_cast<uint64_t>(align);
@@ -0,0 +1,37 @@
+#ifndef CRYSTALMEM_POOL_SAFE_BEST_FIT_OPTION_H_
+#define CRYSTALMEM_POOL_SAFE_BEST_FIT_OPTION_H_
+
+#include "CrystalMem/type.h" // size_t
+
+namespace crystal::mem {
+
+/**
+ * Tuning knobs of a `SafeBestFitPool`.
+ *
+ * This is a structural type so that it can be passed as a template argument,
+ * e.g. `SafeBestFitOptions{ .empty_block_retention = 4 }` as the last argument
+ * of `SafeBestFitPool`.
+ */
+struct SafeBestFitOptions {
+  /**
+   * Number of fully free blocks the pool keeps around.
+   *
+   * A block whose memory is all free again after merging is released to the
+   * vendor beyond this count, so that a burst of allocations does not hold on
+   * to its blocks, while an allocation and deallocation pair at a block
+   * boundary does not hit the vendor every time.
+   */
+  size_t empty_block_retention = 1;
+  /**
+   * Whether free nodes are indexed by B+ trees instead of red black trees
+   * (see `BTreeFreeIndex`).
+   *
+   * This trades node allocations and pointer chasing on every split and
+   * merge for moving a few neighbouring entries within a tree node.
+   */
+  bool btree_free_index = false;
+};
+
+} // namespace crystal::mem
+
+#endif
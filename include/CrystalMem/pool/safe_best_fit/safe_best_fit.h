@@ -3,16 +3,18 @@
 
 #include <CrystalBase/integer_sequence.h> // integer_sequence
 
+#include <algorithm> // std::min
 #include <array> // std::array
 #include <limits> // std::numeric_limits
 #include <memory>
-#include <type_traits> // std::is_same_v
+#include <type_traits> // std::is_same_v, std::conditional_t
 #include <vector> // std::vector
 #include <map> // std::map
 #include <utility> // std::pair
-#include <unordered_map> // std::unordered_map
 
 #include "CrystalMem/pool/concept.h" // AnyPool
+#include "CrystalMem/pool/large_map.h" // LargeAllocMap
+#include "CrystalMem/pool/page_map.h" // PageMap
 #include "CrystalMem/resource/os.h" // OSResource
 #include "CrystalMem/type.h" // _kB
 #include "CrystalMem/vendor.h" // Vendor
@@ -20,33 +22,46 @@
 #include "CrystalMem/vendor/concept.h" // AnyVendor
 #include "block.h" // SafeBestFitBlock
 #include "free_map.h" // SafeBestFitFreeMap
+#include "option.h" // SafeBestFitOptions
 
 namespace crystal::mem {
 
 using std::array, std::vector, std::map, std::move, std::is_same_v, std::less,
-    std::pair, std::numeric_limits, std::swap, std::unordered_map,
-    std::construct_at;
+    std::pair, std::numeric_limits, std::swap, std::construct_at,
+    std::exchange, std::conditional_t, std::min;
 
 /**
  * A memory pool that implements the naive best fit strategy.
  *
- * @tparam kBlockSize The block size the strategy operates on.
+ * A block whose memory is all free again after merging is released to the
+ * resource vendor, past the `empty_block_retention` fully free blocks that are
+ * kept for reuse.
+ *
+ * @tparam kBlockSize The block size the strategy operates on. Blocks are
+ * aligned to their size.
  * @tparam ResourceVendor The vendor to request data memory from. Since this
  * pool doesn't have in-memory optimization, memory obtained from this vendor
  * will not be operated on.
  * @tparam LogicVendor The vendor to request memory for allocating logic state.
+ * @tparam kOptions See `SafeBestFitOptions`.
  */
 template <size_t kBlockSize,
           AnyVendor ResourceVendor,
-          AnyVendor LogicVendor = ResourceVendor>
+          AnyVendor LogicVendor = ResourceVendor,
+          SafeBestFitOptions kOptions = SafeBestFitOptions{}>
 class SafeBestFitPool {
  public:
   using Block = SafeBestFitBlock<kBlockSize>;
-  using FreeMap =
-      SafeBestFitFreeMap<VendorAllocator<pair<void* const, size_t>, LogicVendor>>;
+  using FreeMap = SafeBestFitFreeMap<
+      VendorAllocator<pair<void* const, size_t>, LogicVendor>,
+      conditional_t<kOptions.btree_free_index, BTreeFreeIndex, TreeFreeIndex>>;
+  /* Allocations larger than a block. */
+  using LargeMap = LargeAllocMap<kBlockSize + 1, LogicVendor>;
 
   /* Attributes */
   static constexpr bool kInMemoryOptimization = false;
+  /* Free tails shorter than this go with `ContinuousAllocAtLeast` arrays. */
+  static constexpr size_t kMaxSlack = 64_B;
 
   /* Constructor */
   SafeBestFitPool(const ResourceVendor& vendor)
@@ -56,19 +71,33 @@ class SafeBestFitPool {
   SafeBestFitPool(const ResourceVendor& resource_vendor,
                   const LogicVendor& logic_vendor) :
       resource_vendor_(resource_vendor),
-      blocks_(VendorAllocator<Block*, LogicVendor>(logic_vendor)),
+      blocks_(logic_vendor),
       free_map_(VendorAllocator<pair<void* const, size_t>, LogicVendor>(
-          logic_vendor)) {
+          logic_vendor)),
+      large_allocs_(logic_vendor) {
   }
   /* No Copying */
   SafeBestFitPool(const SafeBestFitPool&) = delete;
   /* Move Constructor */
-  SafeBestFitPool(SafeBestFitPool&& other) : blocks_(move(other.blocks_)) {
+  SafeBestFitPool(SafeBestFitPool&& other) :
+      resource_vendor_(other.resource_vendor_),
+      blocks_(move(other.blocks_)),
+      free_map_(move(other.free_map_)),
+      empty_blocks_(other.empty_blocks_),
+      n_empty_blocks_(exchange(other.n_empty_blocks_, 0)),
+      large_allocs_(move(other.large_allocs_)) {
   }
   /* No Copying */
   SafeBestFitPool& operator=(const SafeBestFitPool&) = delete;
   SafeBestFitPool& operator=(SafeBestFitPool&& rhs) {
+    Clear();
+    resource_vendor_ = rhs.resource_vendor_;
     blocks_ = move(rhs.blocks_);
+    free_map_ = move(rhs.free_map_);
+    empty_blocks_ = rhs.empty_blocks_;
+    n_empty_blocks_ = exchange(rhs.n_empty_blocks_, 0);
+    large_allocs_ = move(rhs.large_allocs_);
+    return *this;
   }
   /* Destructor */
   ~SafeBestFitPool() {
@@ -79,86 +108,110 @@ class SafeBestFitPool {
   template <typename T>
   T* DiscreteAlloc() {
     if constexpr (sizeof(T) > kBlockSize) {
-      void* addr =
-          resource_vendor_.Alloc(sizeof(T), static_cast<align_t>(alignof(T)));
-      extern_allocs_[addr] = { sizeof(T), static_cast<align_t>(alignof(T)) };
-      return reinterpret_cast<T*>(addr);
+      return reinterpret_cast<T*>(large_allocs_.Alloc(
+          resource_vendor_, sizeof(T), static_cast<align_t>(alignof(T))));
     } else {
-      void* addr = free_map_.Alloc(sizeof(T), static_cast<align_t>(alignof(T)));
-      if (reinterpret_cast<size_t>(addr) == -1ul) {
-        void* new_block = reinterpret_cast<void*>(AppendBlock());
-        free_map_.InsertNode(
-            reinterpret_cast<void*>(reinterpret_cast<size_t>(new_block)
-                                    + sizeof(T)),
-            kBlockSize - sizeof(T));
-        return reinterpret_cast<T*>(new_block);
-      } else return reinterpret_cast<T*>(addr);
+      return reinterpret_cast<T*>(
+          BlockAlloc(sizeof(T), static_cast<align_t>(alignof(T))));
     }
   }
   template <typename T>
   void DiscreteDealloc(T* ptr) {
     if constexpr (sizeof(T) > kBlockSize) {
-      resource_vendor_.Dealloc(
-          static_cast<void*>(ptr), sizeof(T), static_cast<align_t>(alignof(T)));
-      extern_allocs_.erase(reinterpret_cast<void*>(ptr));
+      large_allocs_.Dealloc(resource_vendor_, static_cast<void*>(ptr));
     } else
-      free_map_.Dealloc(
+      BlockDealloc(
           static_cast<void*>(ptr), sizeof(T), static_cast<align_t>(alignof(T)));
   }
   template <typename T>
   T* ContinuousAlloc(size_t n) {
     if (sizeof(T) * n > kBlockSize) {
-      void* addr = resource_vendor_.Alloc(sizeof(T) * n,
-                                          static_cast<align_t>(alignof(T)));
-      extern_allocs_[addr] = { sizeof(T) * n,
-                               static_cast<align_t>(alignof(T)) };
-      return reinterpret_cast<T*>(addr);
+      return reinterpret_cast<T*>(large_allocs_.Alloc(
+          resource_vendor_, sizeof(T) * n, static_cast<align_t>(alignof(T))));
     } else {
-      void* addr =
-          free_map_.Alloc(sizeof(T) * n, static_cast<align_t>(alignof(T)));
-      if (reinterpret_cast<size_t>(addr) == -1ul) {
-        void* new_block = reinterpret_cast<void*>(AppendBlock());
-        free_map_.InsertNode(
-            reinterpret_cast<void*>(reinterpret_cast<size_t>(new_block)
-                                    + sizeof(T) * n),
-            kBlockSize - sizeof(T) * n);
-        return reinterpret_cast<T*>(new_block);
-      } else return reinterpret_cast<T*>(addr);
+      return reinterpret_cast<T*>(
+          BlockAlloc(sizeof(T) * n, static_cast<align_t>(alignof(T))));
     }
   }
   template <typename T>
   void ContinuousDealloc(T* ptr, size_t n) {
     if (sizeof(T) * n > kBlockSize) {
-      resource_vendor_.Dealloc(static_cast<void*>(ptr),
-                               sizeof(T) * n,
-                               static_cast<align_t>(alignof(T)));
-      extern_allocs_.erase(reinterpret_cast<void*>(ptr));
+      large_allocs_.Dealloc(resource_vendor_, static_cast<void*>(ptr));
     } else
-      free_map_.Dealloc(static_cast<void*>(ptr),
-                        sizeof(T) * n,
-                        static_cast<align_t>(alignof(T)));
+      BlockDealloc(static_cast<void*>(ptr),
+                   sizeof(T) * n,
+                   static_cast<align_t>(alignof(T)));
+  }
+  /**
+   * Allocate an array of at least `n` objects. A free tail shorter than
+   * `kMaxSlack` bytes right after the array is handed out with it in whole
+   * objects, rather than left as a fragment, as long as the array still fits
+   * in a block.
+   *
+   * @return The array and the number of objects it holds, which is what it
+   * must be deallocated with.
+   */
+  template <typename T>
+  AllocationResult<T*> ContinuousAllocAtLeast(size_t n) {
+    T* ptr = ContinuousAlloc<T>(n);
+    if (!ptr || sizeof(T) * n > kBlockSize) return { ptr, n };
+    void* end =
+        reinterpret_cast<void*>(reinterpret_cast<size_t>(ptr) + sizeof(T) * n);
+    size_t tail = free_map_.NodeSize(end);
+    if (tail >= kMaxSlack) return { ptr, n };
+    /* Deallocating with the count must not take the large path. */
+    tail = min(tail, kBlockSize - sizeof(T) * n) / sizeof(T) * sizeof(T);
+    if (!tail) return { ptr, n };
+    free_map_.Remove(end, tail);
+    Reuse(end, tail);
+    return { ptr, n + tail / sizeof(T) };
+  }
+  /**
+   * Grow an array from `old_n` to `new_n` objects over the free memory right
+   * after it, or within a large allocation.
+   *
+   * @return Whether the array grew, otherwise it is left as is.
+   */
+  template <typename T>
+  bool TryExpandInPlace(T* ptr, size_t old_n, size_t new_n) {
+    size_t old_size = sizeof(T) * old_n, new_size = sizeof(T) * new_n;
+    if (old_size > kBlockSize) return new_size <= large_allocs_.Size(ptr);
+    if (new_size > kBlockSize) return false;
+    void* end =
+        reinterpret_cast<void*>(reinterpret_cast<size_t>(ptr) + old_size);
+    if (!free_map_.IsFree(end, new_size - old_size)) return false;
+    free_map_.Remove(end, new_size - old_size);
+    Reuse(end, new_size - old_size);
+    return true;
+  }
+  /**
+   * Shrink an array from `old_n` to `new_n` objects, `new_n <= old_n`,
+   * returning its tail to the free memory.
+   *
+   * @return Whether the array shrank, otherwise it keeps its old size, e.g.
+   * when a large allocation would fit in a block.
+   */
+  template <typename T>
+  bool Shrink(T* ptr, size_t old_n, size_t new_n) {
+    size_t old_size = sizeof(T) * old_n, new_size = sizeof(T) * new_n;
+    if (old_size > kBlockSize) return new_size > kBlockSize;
+    if (!new_size) return false;
+    if (new_size < old_size)
+      BlockDealloc(
+          reinterpret_cast<void*>(reinterpret_cast<size_t>(ptr) + new_size),
+          old_size - new_size,
+          static_cast<align_t>(1));
+    return true;
   }
   void* RawAlloc(size_t size, align_t align) {
     if (size > kBlockSize) {
-      void* addr = resource_vendor_.Alloc(size, align);
-      extern_allocs_[addr] = { size, align };
-      return addr;
-    } else {
-      void* addr = free_map_.Alloc(size, align);
-      if (reinterpret_cast<size_t>(addr) == -1ul) {
-        void* new_block = reinterpret_cast<void*>(AppendBlock());
-        free_map_.InsertNode(
-            reinterpret_cast<void*>(reinterpret_cast<size_t>(new_block) + size),
-            kBlockSize - size);
-        return new_block;
-      } else return addr;
-    }
+      return large_allocs_.Alloc(resource_vendor_, size, align);
+    } else return BlockAlloc(size, align);
   }
   void RawDealloc(void* ptr, size_t size, align_t align) {
     if (size > kBlockSize) {
-      resource_vendor_.Dealloc(ptr, size, align);
-      extern_allocs_.erase(ptr);
-    } else free_map_.Dealloc(ptr, size, align);
+      large_allocs_.Dealloc(resource_vendor_, ptr);
+    } else BlockDealloc(ptr, size, align);
   }
   template <typename T, typename ...Args>
   T* New(Args&&... args) {
@@ -172,28 +225,97 @@ class SafeBestFitPool {
     DiscreteDealloc(ptr);
   }
   void Clear() {
-    for (auto block : blocks_)
+    blocks_.ForEach([this](void*, Block* block) {
       resource_vendor_.Dealloc(
           block, kBlockSize, static_cast<align_t>(kBlockSize));
-    for (auto [addr, size_align] : extern_allocs_) {
-      auto [size, align] = size_align;
-      resource_vendor_.Dealloc(addr, size, align);
-    }
-    extern_allocs_.clear();
+    });
+    blocks_.Clear();
+    free_map_.Clear();
+    n_empty_blocks_ = 0;
+    large_allocs_.Clear(resource_vendor_);
   }
 
  private:
   /* Variables */
   ResourceVendor resource_vendor_;
-  vector<Block*, VendorAllocator<Block*, LogicVendor>> blocks_;
+  PageMap<kBlockSize, Block*, LogicVendor> blocks_;
   FreeMap free_map_;
-  unordered_map<void*, pair<size_t, align_t>> extern_allocs_;
+  /* Fully free blocks kept for reuse. */
+  array<Block*, kOptions.empty_block_retention> empty_blocks_;
+  size_t n_empty_blocks_ = 0;
+  LargeMap large_allocs_;
 
   /* Functions */
+  /**
+   * Allocate memory that fits in a block, appending a block if no free node
+   * fits.
+   */
+  void* BlockAlloc(size_t size, align_t align) {
+    void* addr = free_map_.Alloc(size, align);
+    if (reinterpret_cast<size_t>(addr) == -1ul) {
+      Block* new_block = AppendBlock();
+      if (!new_block) [[unlikely]] return nullptr;
+      if (size < kBlockSize)
+        free_map_.InsertNode(
+            reinterpret_cast<void*>(reinterpret_cast<size_t>(new_block) + size),
+            kBlockSize - size);
+      return new_block;
+    }
+    Reuse(addr, size);
+    return addr;
+  }
+  /**
+   * Forget the kept blocks that memory taken from the free map comes from,
+   * they are no longer fully free.
+   */
+  void Reuse(void* addr, size_t size) {
+    size_t begin = reinterpret_cast<size_t>(addr);
+    for (size_t i = 0; i < n_empty_blocks_;) {
+      size_t block = reinterpret_cast<size_t>(empty_blocks_[i]);
+      if (block < begin + size && begin < block + kBlockSize)
+        empty_blocks_[i] = empty_blocks_[--n_empty_blocks_];
+      else ++i;
+    }
+  }
+  /**
+   * Deallocate memory that fits in a block, then keep or release the blocks it
+   * leaves fully free.
+   */
+  void BlockDealloc(void* ptr, size_t size, align_t align) {
+    auto [node, node_size] = free_map_.Dealloc(ptr, size, align);
+    if (!size) return;
+    size_t node_begin = reinterpret_cast<size_t>(node);
+    size_t begin = reinterpret_cast<size_t>(ptr);
+    /* The memory spans at most two blocks, which were not fully free before. */
+    for (size_t block = begin & ~(kBlockSize - 1); block < begin + size;
+         block += kBlockSize) {
+      if (node_begin <= block && block + kBlockSize <= node_begin + node_size)
+        Retire(reinterpret_cast<Block*>(block));
+    }
+  }
+  /**
+   * Keep a fully free block for reuse, or release it past the retention count.
+   */
+  void Retire(Block* block) {
+    if (n_empty_blocks_ < kOptions.empty_block_retention) {
+      empty_blocks_[n_empty_blocks_++] = block;
+      return;
+    }
+    free_map_.Remove(block, kBlockSize);
+    blocks_.Set(block, 1, nullptr);
+    resource_vendor_.Dealloc(
+        block, kBlockSize, static_cast<align_t>(kBlockSize));
+  }
+  /**
+   * Request a new block from the vendor.
+   *
+   * @return The block, **OR** `nullptr` if the vendor failed.
+   */
   Block* AppendBlock() {
-    blocks_.push_back(reinterpret_cast<Block*>(resource_vendor_.Alloc(
-        sizeof(Block), static_cast<align_t>(alignof(Block)))));
-    return blocks_.back();
+    Block* block = reinterpret_cast<Block*>(resource_vendor_.Alloc(
+        sizeof(Block), static_cast<align_t>(alignof(Block))));
+    if (block) [[likely]] blocks_.Set(block, 1, block);
+    return block;
   }
 };
 static_assert(AnyPool<SafeBestFitPool<4_kB, Vendor<OSResource>>>);
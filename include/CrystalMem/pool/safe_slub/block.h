@@ -0,0 +1,109 @@
+#ifndef CRYSTALMEM_POOL_SAFE_SLUB_BLOCK_H_
+#define CRYSTALMEM_POOL_SAFE_SLUB_BLOCK_H_
+
+#include <CrystalBase/bitwise.h> // lowbit
+
+#include <array> // std::array
+#include <bit> // std::countr_zero
+#include <cstdint> // uint64_t
+
+#include "CrystalMem/type.h" // size_t
+
+namespace crystal::mem {
+
+using std::array, std::countr_zero;
+
+/**
+ * Out of line state of a block of equally sized slots.
+ *
+ * The free slots are tracked in a bitmap (a set bit is a free slot) that lives
+ * in logic memory, so the block itself is never read or written and may be
+ * fictional. Free slots are found by scanning the bitmap a 64 bit word at a
+ * time with `countr_zero`, starting from the lowest word that may have a free
+ * slot.
+ *
+ * Ownership responsibilities:
+ *  Objects of this class have **NO** memory ownership responsibilities.
+ */
+template <size_t kSize, size_t kSlotSize>
+requires (lowbit(kSize) == kSize) // size must be some power of 2
+class SafeSLUBBlock {
+ public:
+  /* Constants */
+  static constexpr size_t kNSlots = kSize / kSlotSize;
+  static constexpr size_t kNWords = (kNSlots + 63) / 64;
+  static_assert(kNSlots > 0, "Slot size too big for a single block.");
+
+  /* Linked list pointers. */
+  SafeSLUBBlock* next_ = nullptr;
+  SafeSLUBBlock* prev_ = nullptr;
+
+  /* Constructor */
+  explicit SafeSLUBBlock(void* addr) :
+      addr_(reinterpret_cast<size_t>(addr)) {
+    Reset();
+  }
+
+  /* Functions */
+  /**
+   * Allocate the lowest free slot of the block.
+   *
+   * @return The slot address, **OR** `nullptr` if the block is full.
+   */
+  void* AllocSlot() {
+    for (; hint_ < kNWords; ++hint_) {
+      if (uint64_t word = free_bits_[hint_]) {
+        free_bits_[hint_] = word & (word - 1);
+        ++live_;
+        size_t slot_idx = (hint_ << 6) + countr_zero(word);
+        return reinterpret_cast<void*>(addr_ + slot_idx * kSlotSize);
+      }
+    }
+    return nullptr;
+  }
+  /**
+   * Deallocate a slot of the block.
+   *
+   * This function does not check if the input address is actually in the
+   * block.
+   */
+  void DeallocSlot(void* ptr) {
+    size_t slot_idx = (reinterpret_cast<size_t>(ptr) - addr_) / kSlotSize;
+    free_bits_[slot_idx >> 6] |= uint64_t{ 1 } << (slot_idx & 63);
+    if ((slot_idx >> 6) < hint_) hint_ = slot_idx >> 6;
+    --live_;
+  }
+  /**
+   * Mark every slot free.
+   */
+  void Reset() {
+    free_bits_.fill(~uint64_t{ 0 });
+    /* Slots past the end are never free. */
+    if constexpr (kNSlots % 64)
+      free_bits_.back() = (uint64_t{ 1 } << (kNSlots % 64)) - 1;
+    hint_ = 0;
+    live_ = 0;
+  }
+  bool Full() const {
+    return live_ == kNSlots;
+  }
+  bool Empty() const {
+    return live_ == 0;
+  }
+  void* Addr() const {
+    return reinterpret_cast<void*>(addr_);
+  }
+
+ private:
+  /* Variables */
+  size_t addr_;
+  /* All words before this one have no free slot. */
+  size_t hint_;
+  /* Number of allocated slots. */
+  size_t live_;
+  array<uint64_t, kNWords> free_bits_;
+};
+
+} // namespace crystal::mem
+
+#endif
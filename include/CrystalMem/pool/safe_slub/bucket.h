@@ -0,0 +1,186 @@
+#ifndef CRYSTALMEM_POOL_SAFE_SLUB_BUCKET_H_
+#define CRYSTALMEM_POOL_SAFE_SLUB_BUCKET_H_
+
+#include <initializer_list> // std::initializer_list
+#include <new> // placement new
+
+#include "CrystalMem/pool/page_map.h" // PageMap
+#include "CrystalMem/pool/slub/block_list.h" // SLUBBlockList
+#include "CrystalMem/pool/slub/option.h" // SLUBOptions
+#include "CrystalMem/vendor/concept.h" // AnyVendor
+#include "block.h" // SafeSLUBBlock
+
+namespace crystal::mem {
+
+/**
+ * A bucket of blocks that have the same slot size, with all block state kept
+ * out of line.
+ *
+ * Block state is allocated from the logic vendor, and the state of a slot is
+ * looked up in a page map shared by all buckets of a pool, which must be bound
+ * before the first allocation. Blocks are organized in three lists like in
+ * `SLUBBucket`: allocation happens at the front of the partial list, and empty
+ * blocks beyond `kOptions.empty_block_retention` are released to the resource
+ * vendor.
+ *
+ * Memory Responsibilities:
+ * This class is responsible for releasing all the blocks and their state.
+ *
+ * @tparam kPageSize The page size of the block map, at most `kBlockSize`.
+ */
+template <size_t kBlockSize,
+          size_t kSlotSize,
+          AnyVendor ResourceVendor,
+          AnyVendor LogicVendor = ResourceVendor,
+          SLUBOptions kOptions = SLUBOptions{},
+          size_t kPageSize = kBlockSize>
+class SafeSLUBBucket {
+ public:
+  using Block = SafeSLUBBlock<kBlockSize, kSlotSize>;
+  using BlockMap = PageMap<kPageSize, void*, LogicVendor>;
+
+  /* Constructor */
+  SafeSLUBBucket(const ResourceVendor& resource_vendor,
+                 const LogicVendor& logic_vendor,
+                 BlockMap* block_map = nullptr) :
+      resource_vendor_(resource_vendor),
+      logic_vendor_(logic_vendor),
+      block_map_(block_map) {
+  }
+  /* Destructor */
+  ~SafeSLUBBucket() {
+    Clear();
+  }
+  /* No Copying */
+  SafeSLUBBucket(const SafeSLUBBucket& other) = delete;
+  /* Move Constructor */
+  SafeSLUBBucket(SafeSLUBBucket&& other) :
+      resource_vendor_(other.resource_vendor_),
+      logic_vendor_(other.logic_vendor_),
+      block_map_(other.block_map_),
+      partial_(other.partial_.Take()),
+      full_(other.full_.Take()),
+      empty_(other.empty_.Take()) {
+  }
+  /* No Copying */
+  SafeSLUBBucket& operator=(const SafeSLUBBucket& rhs) = delete;
+  /* Move Assignment */
+  SafeSLUBBucket& operator=(SafeSLUBBucket&& rhs) {
+    Clear();
+    resource_vendor_ = rhs.resource_vendor_;
+    logic_vendor_ = rhs.logic_vendor_;
+    block_map_ = rhs.block_map_;
+    partial_ = rhs.partial_.Take();
+    full_ = rhs.full_.Take();
+    empty_ = rhs.empty_.Take();
+    return *this;
+  }
+
+  /* Functions */
+  /**
+   * Allocate a slot with size of `kSlotSize`.
+   *
+   * @return The slot, **OR** `nullptr` if the resource vendor failed.
+   */
+  [[nodiscard]] void* AllocSlot() {
+    if (partial_.Empty()) [[unlikely]] {
+      Replenish();
+      if (partial_.Empty()) [[unlikely]] return nullptr;
+    }
+    Block& block = *partial_.head;
+    void* slot = block.AllocSlot();
+    if (block.Full()) [[unlikely]] {
+      partial_.Remove(&block);
+      full_.PushFront(&block);
+    }
+    return slot;
+  }
+  /**
+   * Deallocate a slot with the input address.
+   */
+  void DeallocSlot(void* addr) {
+    Block* block = static_cast<Block*>(block_map_->Get(addr));
+    bool was_full = block->Full();
+    block->DeallocSlot(addr);
+    if (block->Empty()) [[unlikely]] {
+      (was_full ? full_ : partial_).Remove(block);
+      Retire(block);
+    } else if (was_full) [[unlikely]] {
+      full_.Remove(block);
+      partial_.PushFront(block);
+    }
+  }
+  /**
+   * Clear the bucket by deallocating all blocks.
+   */
+  void Clear() {
+    for (BlockList* list : { &partial_, &full_, &empty_ })
+      while (!list->Empty()) Release(list->PopFront());
+  }
+  /**
+   * Set the page map used to find the state of a block.
+   */
+  void BindPageMap(BlockMap* block_map) {
+    block_map_ = block_map;
+  }
+  /**
+   * Number of blocks currently held by the bucket.
+   */
+  size_t NBlocks() const {
+    return partial_.size + full_.size + empty_.size;
+  }
+
+ private:
+  using BlockList = SLUBBlockList<Block>;
+
+  /* Variables */
+  ResourceVendor resource_vendor_;
+  /* Source of block state. */
+  LogicVendor logic_vendor_;
+  BlockMap* block_map_;
+  BlockList partial_;
+  BlockList full_;
+  BlockList empty_;
+
+  /* Functions */
+  /**
+   * Keep an empty block for reuse, or release it past the retention count.
+   */
+  void Retire(Block* block) {
+    if (empty_.size < kOptions.empty_block_retention) {
+      block->Reset();
+      empty_.PushFront(block);
+    } else Release(block);
+  }
+  void Release(Block* block) {
+    void* addr = block->Addr();
+    block_map_->Set(addr, kBlockSize, nullptr);
+    resource_vendor_.Dealloc(
+        addr, kBlockSize, static_cast<align_t>(kBlockSize));
+    block->~Block();
+    logic_vendor_.Dealloc(
+        block, sizeof(Block), static_cast<align_t>(alignof(Block)));
+  }
+  /**
+   * Refill the empty partial list with an empty or a new block.
+   *
+   * The partial list stays empty if the resource vendor failed.
+   */
+  void Replenish() {
+    if (!empty_.Empty()) {
+      partial_.PushFront(empty_.PopFront());
+      return;
+    }
+    void* addr =
+        resource_vendor_.Alloc(kBlockSize, static_cast<align_t>(kBlockSize));
+    if (!addr) [[unlikely]] return;
+    Block* block = new (logic_vendor_.Alloc(
+        sizeof(Block), static_cast<align_t>(alignof(Block)))) Block(addr);
+    block_map_->Set(addr, kBlockSize, block);
+    partial_.PushFront(block);
+  }
+};
+
+} // namespace crystal::mem
+
+#endif
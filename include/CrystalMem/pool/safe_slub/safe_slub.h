@@ -0,0 +1,249 @@
+#ifndef CRYSTALMEM_POOL_SAFE_SLUB_SAFE_SLUB_H_
+#define CRYSTALMEM_POOL_SAFE_SLUB_SAFE_SLUB_H_
+
+#include <CrystalBase/integer_sequence.h> // integer_sequence
+
+#include <memory> // std::construct_at
+#include <tuple> // std::tuple
+#include <type_traits> // std::is_same_v
+#include <utility> // std::index_sequence
+
+#include "CrystalMem/pool/concept.h" // AnyPool
+#include "CrystalMem/pool/large_map.h" // LargeAllocMap
+#include "CrystalMem/pool/page_map.h" // PageMap
+#include "CrystalMem/pool/slub/dispatch.h" // SLUBDispatch
+#include "CrystalMem/pool/slub/option.h" // SLUBOptions
+#include "CrystalMem/pool/slub/size_class.h" // SLUBSizeClasses
+#include "CrystalMem/type.h" // _kB
+#include "CrystalMem/vendor.h" // Vendor
+#include "CrystalMem/vendor/concept.h" // AnyVendor
+#include "bucket.h" // SafeSLUBBucket
+
+namespace crystal::mem {
+
+using std::tuple, std::index_sequence, std::make_index_sequence,
+    std::get, std::apply, std::is_same_v, std::construct_at;
+
+/**
+ * A memory pool that implements the SLUB strategy with out of line metadata.
+ *
+ * Size classes work as in `SLUBPool`, but every block is tracked by a slot
+ * bitmap in logic memory instead of an in-block header and free list. This
+ * keeps the metadata out of the cache lines of the user data, and lets the
+ * pool distribute fictional memory.
+ *
+ * @tparam kBlockSize The smallest block size, size classes get larger blocks
+ * as needed to satisfy the block bounds in `kOptions`. Blocks are aligned to
+ * their size.
+ * @tparam kSlotSizes The slot size of each size class.
+ * @tparam ResourceVendor The vendor to request data memory from. Since this
+ * pool doesn't have in-memory optimization, memory obtained from this vendor
+ * will not be operated on.
+ * @tparam LogicVendor The vendor to request memory for allocating logic state.
+ * @tparam kOptions See `SLUBOptions`. The thread cache is not supported.
+ */
+template <size_t kBlockSize,
+          integer_sequence kSlotSizes,
+          AnyVendor ResourceVendor,
+          AnyVendor LogicVendor = ResourceVendor,
+          SLUBOptions kOptions = SLUBOptions{}>
+class SafeSLUBPool {
+  static_assert(kOptions.magazine_size == 0,
+                "SafeSLUBPool has no thread cache.");
+
+ public:
+  /* Attributes */
+  static constexpr bool kInMemoryOptimization = false;
+
+  /* Block size of the size class with slots of `kSlotSize`. */
+  template <size_t kSlotSize>
+  static constexpr size_t kBucketBlockSize =
+      kOptions.BlockSize(kBlockSize, kSlotSize, 0);
+  template <size_t kSlotSize>
+  using Bucket = SafeSLUBBucket<kBucketBlockSize<kSlotSize>,
+                                kSlotSize,
+                                ResourceVendor,
+                                LogicVendor,
+                                kOptions,
+                                kBlockSize>;
+  /* Block state by block page. */
+  using BlockMap = PageMap<kBlockSize, void*, LogicVendor>;
+  using SizeClasses = SLUBSizeClasses<kSlotSizes>;
+  /* Allocations that fit no size class. */
+  using LargeMap = LargeAllocMap<SizeClasses::kMaxSize + 1, LogicVendor>;
+
+  /* Constructor */
+  SafeSLUBPool(const ResourceVendor& vendor)
+      requires is_same_v<ResourceVendor, LogicVendor>
+      : SafeSLUBPool(vendor, vendor) {
+  }
+  SafeSLUBPool(const ResourceVendor& resource_vendor,
+               const LogicVendor& logic_vendor) :
+      resource_vendor_(resource_vendor),
+      block_map_(logic_vendor),
+      buckets_(Buckets::Init(resource_vendor, logic_vendor, &block_map_)),
+      large_allocs_(logic_vendor) {
+  }
+  /* Destructor */
+  ~SafeSLUBPool() {
+    Clear();
+  }
+  SafeSLUBPool(const SafeSLUBPool& other) = delete;
+  SafeSLUBPool(SafeSLUBPool&& other) :
+      resource_vendor_(other.resource_vendor_),
+      block_map_(move(other.block_map_)),
+      buckets_(move(other.buckets_)),
+      large_allocs_(move(other.large_allocs_)) {
+    BindPageMap();
+  }
+  SafeSLUBPool& operator=(const SafeSLUBPool& rhs) = delete;
+  SafeSLUBPool& operator=(SafeSLUBPool&& rhs) {
+    Clear();
+    resource_vendor_ = rhs.resource_vendor_;
+    buckets_ = move(rhs.buckets_);
+    block_map_ = move(rhs.block_map_);
+    large_allocs_ = move(rhs.large_allocs_);
+    BindPageMap();
+    return *this;
+  }
+
+  /* Functions */
+  template <typename T>
+  T* DiscreteAlloc() {
+    constexpr size_t bucket_idx = SizeClasses::Lookup(
+        sizeof(T), static_cast<align_t>(alignof(T)));
+    if constexpr (bucket_idx == -1ul) { // no bucket
+      return reinterpret_cast<T*>(
+          ExternAlloc(sizeof(T), static_cast<align_t>(alignof(T))));
+    } else return reinterpret_cast<T*>(get<bucket_idx>(buckets_).AllocSlot());
+  }
+  template <typename T>
+  void DiscreteDealloc(T* ptr) {
+    constexpr size_t bucket_idx = SizeClasses::Lookup(
+        sizeof(T), static_cast<align_t>(alignof(T)));
+    if constexpr (bucket_idx == -1ul) { // no bucket
+      ExternDealloc(ptr);
+    } else get<bucket_idx>(buckets_).DeallocSlot(ptr);
+  }
+  template <typename T>
+  T* ContinuousAlloc(size_t n) {
+    return reinterpret_cast<T*>(
+        RawAlloc(sizeof(T) * n, static_cast<align_t>(alignof(T))));
+  }
+  template <typename T>
+  void ContinuousDealloc(T* ptr, size_t n) {
+    RawDealloc(ptr, sizeof(T) * n, static_cast<align_t>(alignof(T)));
+  }
+  /**
+   * Allocate an array of at least `n` objects, which holds as many objects as
+   * fit in the slot of its size class.
+   *
+   * @return The array and the number of objects it holds.
+   */
+  template <typename T>
+  AllocationResult<T*> ContinuousAllocAtLeast(size_t n) {
+    T* ptr = ContinuousAlloc<T>(n);
+    if (!ptr) return { ptr, n };
+    return { ptr,
+             SizeClasses::Capacity(sizeof(T) * n,
+                                   static_cast<align_t>(alignof(T)))
+                 / sizeof(T) };
+  }
+  /**
+   * Grow an array from `old_n` to `new_n` objects, which succeeds when it
+   * stays in its size class, or within a large allocation.
+   *
+   * @return Whether the array grew, otherwise it is left as is.
+   */
+  template <typename T>
+  bool TryExpandInPlace(T* ptr, size_t old_n, size_t new_n) {
+    return SizeClasses::ResizeInPlace(large_allocs_,
+                                      ptr,
+                                      sizeof(T) * old_n,
+                                      sizeof(T) * new_n,
+                                      static_cast<align_t>(alignof(T)));
+  }
+  /**
+   * Shrink an array from `old_n` to `new_n` objects, `new_n <= old_n`, which
+   * succeeds when it stays in its size class, or stays a large allocation.
+   *
+   * @return Whether the array shrank, otherwise it keeps its old size.
+   */
+  template <typename T>
+  bool Shrink(T* ptr, size_t old_n, size_t new_n) {
+    return SizeClasses::ResizeInPlace(large_allocs_,
+                                      ptr,
+                                      sizeof(T) * old_n,
+                                      sizeof(T) * new_n,
+                                      static_cast<align_t>(alignof(T)));
+  }
+  void* RawAlloc(size_t size, align_t align) {
+    size_t bucket_idx = SizeClasses::Lookup(size, align);
+    if (bucket_idx == -1ul) return ExternAlloc(size, align); // no bucket
+    return Dispatch::kAllocSlot[bucket_idx](buckets_);
+  }
+  void RawDealloc(void* ptr, size_t size, align_t align) {
+    size_t bucket_idx = SizeClasses::Lookup(size, align);
+    if (bucket_idx == -1ul) ExternDealloc(ptr); // no bucket
+    else Dispatch::kDeallocSlot[bucket_idx](buckets_, ptr);
+  }
+  template <typename T, typename... Args>
+  T* New(Args&&... args) {
+    T* addr = DiscreteAlloc<T>();
+    construct_at(addr, args...);
+    return addr;
+  }
+  template <typename T>
+  void Del(T* addr) {
+    addr->~T();
+    DiscreteDealloc(addr);
+  }
+  void Clear() {
+    /* Clear the buckets. */
+    apply([](auto&... buckets) { (buckets.Clear(), ...); }, buckets_);
+    /* Clear external allocations. */
+    large_allocs_.Clear(resource_vendor_);
+  }
+
+ private:
+  /* Variables */
+  ResourceVendor resource_vendor_;
+  /* Shared by the buckets, so declared before them. */
+  BlockMap block_map_;
+  template <typename Seq>
+  struct ArraytoTuple;
+  template <size_t... Is>
+  struct ArraytoTuple<index_sequence<Is...>> {
+    using type = tuple<Bucket<kSlotSizes[Is]>...>;
+    static auto Init(const ResourceVendor& resource_vendor,
+                     const LogicVendor& logic_vendor,
+                     BlockMap* block_map) {
+      return type{ Bucket<kSlotSizes[Is]>(
+          resource_vendor, logic_vendor, block_map)... };
+    }
+  };
+  using Buckets = ArraytoTuple<make_index_sequence<kSlotSizes.size()>>;
+  using Dispatch = SLUBDispatch<typename Buckets::type>;
+  Buckets::type buckets_;
+  LargeMap large_allocs_;
+
+  /* Functions */
+  void* ExternAlloc(size_t size, align_t align) {
+    return large_allocs_.Alloc(resource_vendor_, size, align);
+  }
+  void ExternDealloc(void* ptr) {
+    large_allocs_.Dealloc(resource_vendor_, ptr);
+  }
+  /**
+   * Point the buckets at the block map of this pool after a move.
+   */
+  void BindPageMap() {
+    apply([this](auto&... buckets) { (buckets.BindPageMap(&block_map_), ...); },
+          buckets_);
+  }
+};
+static_assert(AnyPool<SafeSLUBPool<4_kB, { 8_B, 2_kB }, Vendor<OSResource>>>);
+
+} // namespace crystal::mem
+
+#endif
@@ -4,6 +4,9 @@
 #include <cstdint> // uint64_t
 
 #include <array> // std::array
+#include <atomic> // std::atomic
+#include <cstddef> // std::byte
+#include <type_traits> // std::conditional_t
 
 #include <CrystalBase/bitwise.h> // lowbit
 #include <CrystalBase/static_format.h> // static_format
@@ -12,35 +15,85 @@
 
 namespace crystal::mem {
 
-using std::array;
+using std::array, std::atomic, std::conditional_t, std::memory_order_acquire,
+    std::memory_order_release, std::memory_order_relaxed;
 
 /**
  * A block that holds a continuous array of slots.
  *
  * Memory Layout:
- * | block links | block head | padding | slot_0 | slot_1 | ... | slot_n |
+ * | block links | block head | padding | color | slot_0 | ... | slot_n | tail |
+ *
+ * Coloring: the space that is too small for another slot is split between a
+ * leading color offset and the tail. Blocks get different colors (multiples
+ * of a cache line), so that slots at the same index of different blocks do not
+ * all map to the same cache sets.
+ *
+ * Fresh slots are carved with a bump index and only recycled slots go through
+ * the free list, so constructing a block is O(1) and never touches the slots.
+ *
+ * Out of line header:
+ *  With `kInlineHeader = false`, this object only holds the links and the head
+ *  and points to a separate block of `kSize` bytes that holds nothing but
+ *  slots. The block then fits `kSize / kSlotSize` slots, but its header can no
+ *  longer be found by masking a slot address.
+ *
+ * Threading:
+ *  The block is owned by a single thread that allocates and deallocates through
+ *  the local free list. Other threads deallocate through `DeallocRemote`, which
+ *  pushes onto a lock-free remote free list that the owner takes back with
+ *  `CollectRemote`.
  *
  * Ownership responsibilities:
  *  Objects of this class have **NO** memory ownership responsibilities.
  */
-template <size_t kSize, size_t kSlotSize>
+template <size_t kSize, size_t kSlotSize, bool kInlineHeader = true>
 requires (lowbit(kSize) == kSize) // size must be some power of 2
-class alignas(kSize) SLUBBlockNode {
+class alignas(kInlineHeader ? kSize : alignof(void*)) SLUBBlockNode {
  public:
   using SlotNode = SLUBSlotNode<kSlotSize>;
 
+ private:
+  /* Block Head */
+  struct Head {
+    /* Recycled slots. */
+    size_t free_head;
+    /* Slots from this index on have never been handed out. */
+    size_t bump;
+    /* Number of allocated slots, as seen by the owner. */
+    size_t live;
+    /* Slots freed by other threads, not yet visible to the owner. */
+    atomic<size_t> remote_free_head;
+    /* Byte offset of the first slot past the aligned header. */
+    size_t color;
+  };
+
+ public:
   /* Constants */
+  /* Size of the links and the block head. */
+  static constexpr size_t kHeaderSize =
+      sizeof(SLUBBlockNode*) * 3 + sizeof(Head);
   /* Available size for slots. */
   static constexpr size_t kCapacity =
-      (kSize - sizeof(SLUBBlockNode*) * 2 - sizeof(size_t) - sizeof(size_t));
+      kInlineHeader ? kSize - kHeaderSize : kSize;
   static constexpr size_t kNSlots = kCapacity / kSlotSize;
   static_assert(kCapacity > 0, "Slot size too big for a single block.");
+  /* Offset of the uncolored slots. */
+  static constexpr size_t kSlotsOffset =
+      kInlineHeader
+        ? (kHeaderSize + alignof(SlotNode) - 1) & ~(alignof(SlotNode) - 1)
+        : 0;
+  /* Colors are cache line steps that keep the slots aligned. */
+  static constexpr size_t kColorStep =
+      alignof(SlotNode) > 64 ? alignof(SlotNode) : 64;
+  static constexpr size_t kNColors =
+      (kSize - kSlotsOffset - kNSlots * kSlotSize) / kColorStep + 1;
 
   /* Static Functions */
   /**
    * Use alignment to infer the block address.
    */
-  static SLUBBlockNode* FromSlot(SlotNode* slot) {
+  static SLUBBlockNode* FromSlot(SlotNode* slot) requires kInlineHeader {
     /* Some bit casting. */
     uint64_t bits = reinterpret_cast<uint64_t>(slot);
     bits &= ~(lowbit(kSize) - 1);
@@ -50,16 +103,26 @@ class alignas(kSize) SLUBBlockNode {
   /* Linked list pointers. */
   SLUBBlockNode* next_ = nullptr;
   SLUBBlockNode* prev_ = nullptr;
+  /* Link in the bucket's stack of blocks with pending remote frees. */
+  SLUBBlockNode* pending_next_ = nullptr;
 
   /* Constructor */
-  constexpr SLUBBlockNode() {
+  /**
+   * @param color The color of the block, taken modulo `kNColors`.
+   */
+  constexpr SLUBBlockNode(size_t color = 0) requires kInlineHeader {
     /* Assertions */
     static_assert(sizeof(SLUBBlockNode) <= kSize);
 
-    head_.free_head = 0; // point to the first slot
-    size_t i = 1;
-    for (auto slot : slots_) slot.free_nxt = i++;
-    slots_.back().free_nxt = -1ul;
+    Init(color);
+  }
+  /**
+   * @param memory The `kSize` bytes that hold the slots.
+   * @param color The color of the block, taken modulo `kNColors`.
+   */
+  SLUBBlockNode(void* memory, size_t color = 0) requires (!kInlineHeader) :
+      slot_memory_(static_cast<std::byte*>(memory)) {
+    Init(color);
   }
 
   /* Functions */
@@ -67,12 +130,39 @@ class alignas(kSize) SLUBBlockNode {
    * Allocate a slot from the block.
    */
   void* AllocSlot() {
-    if (head_.free_head == -1ul) [[unlikely]]
-      return nullptr;
-    void* ptr = &slots_[head_.free_head];
-    head_.free_head = slots_[head_.free_head].free_nxt;
+    void* ptr;
+    if (head_.free_head != -1ul) {
+      ptr = &Slots()[head_.free_head];
+      head_.free_head = Slots()[head_.free_head].free_nxt;
+    } else if (head_.bump != kNSlots) {
+      /* Carve a slot that has never been handed out. */
+      ptr = &Slots()[head_.bump++];
+    } else [[unlikely]] return nullptr;
+    ++head_.live;
     return ptr;
   }
+  /**
+   * Allocate up to `n` slots into `slots` in one pass.
+   *
+   * Recycled slots are taken first, then fresh slots are carved.
+   *
+   * @return The number of slots allocated, less than `n` only if the block
+   * runs full.
+   */
+  size_t AllocSlots(void** slots, size_t n) {
+    size_t i = 0;
+    size_t free_head = head_.free_head;
+    for (; i < n && free_head != -1ul; ++i) {
+      slots[i] = &Slots()[free_head];
+      free_head = Slots()[free_head].free_nxt;
+    }
+    head_.free_head = free_head;
+    /* Carve fresh slots for the rest. */
+    for (; i < n && head_.bump != kNSlots; ++i)
+      slots[i] = &Slots()[head_.bump++];
+    head_.live += i;
+    return i;
+  }
   /**
    * Deallocate a slot from the block.
    *
@@ -80,24 +170,110 @@ class alignas(kSize) SLUBBlockNode {
    * block.
    */
   void DeallocSlot(void* ptr) {
-    size_t slot_idx =
-        reinterpret_cast<SlotNode*>(ptr) - slots_.data();
-    slots_[slot_idx].free_nxt = head_.free_head;
+    size_t slot_idx = SlotIndex(ptr);
+    Slots()[slot_idx].free_nxt = head_.free_head;
     head_.free_head = slot_idx;
+    --head_.live;
+  }
+  /**
+   * Deallocate the `n` slots in `slots`, which must all be in this block.
+   *
+   * The slots are chained together and spliced into the free list at once.
+   */
+  void DeallocSlots(void* const* slots, size_t n) {
+    size_t free_head = head_.free_head;
+    for (size_t i = n; i-- > 0;) {
+      size_t slot_idx = SlotIndex(slots[i]);
+      Slots()[slot_idx].free_nxt = free_head;
+      free_head = slot_idx;
+    }
+    head_.free_head = free_head;
+    head_.live -= n;
+  }
+  /**
+   * Deallocate a slot from a thread that does not own the block.
+   *
+   * @return Whether the remote free list was empty before, in which case the
+   * caller is responsible for notifying the owner.
+   */
+  bool DeallocRemote(void* ptr) {
+    size_t slot_idx = SlotIndex(ptr);
+    size_t remote_head = head_.remote_free_head.load(memory_order_relaxed);
+    do {
+      Slots()[slot_idx].free_nxt = remote_head;
+    } while (!head_.remote_free_head.compare_exchange_weak(
+        remote_head, slot_idx, memory_order_release, memory_order_relaxed));
+    return remote_head == -1ul;
   }
+  /**
+   * Take the whole remote free list back into the local free list.
+   */
+  void CollectRemote() {
+    size_t remote_head =
+        head_.remote_free_head.exchange(-1ul, memory_order_acquire);
+    if (remote_head == -1ul) return;
+    size_t remote_tail = remote_head;
+    --head_.live;
+    while (Slots()[remote_tail].free_nxt != -1ul) {
+      remote_tail = Slots()[remote_tail].free_nxt;
+      --head_.live;
+    }
+    Slots()[remote_tail].free_nxt = head_.free_head;
+    head_.free_head = remote_head;
+  }
+  /**
+   * Forget all the slots so that they are carved again from the start.
+   *
+   * The block must be empty.
+   */
+  void Reset() {
+    head_.free_head = -1ul;
+    head_.bump = 0;
+    head_.live = 0;
+  }
+  /**
+   * Whether the owner has no free slot left.
+   */
   bool Full() const {
-    return head_.free_head == -1ul;
+    return head_.free_head == -1ul && head_.bump == kNSlots;
+  }
+  /**
+   * Whether no slot is allocated.
+   */
+  bool Empty() const {
+    return head_.live == 0;
+  }
+  /**
+   * Start of the `kSize` bytes of the block.
+   */
+  void* Memory() {
+    if constexpr (kInlineHeader) return this;
+    else return slot_memory_;
   }
 
  private:
-  /* Block Head */
-  struct Head {
-    size_t free_head;
-  };
   /* Variables */
   Head head_;
-  array<SlotNode, kNSlots> slots_;
+  alignas(kInlineHeader ? alignof(SlotNode) : alignof(std::byte*))
+      conditional_t<kInlineHeader,
+                    array<std::byte, kSize - kSlotsOffset>,
+                    std::byte*> slot_memory_;
 
+  /* Functions */
+  void Init(size_t color) {
+    head_.remote_free_head.store(-1ul, memory_order_relaxed);
+    head_.color = color % kNColors * kColorStep;
+    Reset();
+  }
+  SlotNode* Slots() {
+    std::byte* slot_memory;
+    if constexpr (kInlineHeader) slot_memory = slot_memory_.data();
+    else slot_memory = slot_memory_;
+    return reinterpret_cast<SlotNode*>(slot_memory + head_.color);
+  }
+  size_t SlotIndex(void* ptr) {
+    return reinterpret_cast<SlotNode*>(ptr) - Slots();
+  }
 };
 
 } // namespace crystal::mem
@@ -0,0 +1,52 @@
+#ifndef CRYSTALMEM_POOL_SLUB_BLOCK_LIST_H_
+#define CRYSTALMEM_POOL_SLUB_BLOCK_LIST_H_
+
+#include "CrystalMem/type.h" // size_t
+
+namespace crystal::mem {
+
+/**
+ * An intrusive doubly linked list of blocks, linked through their `prev_` and
+ * `next_` members.
+ *
+ * Ownership responsibilities:
+ *  Objects of this class have **NO** memory ownership responsibilities.
+ */
+template <typename Block>
+struct SLUBBlockList {
+  Block* head = nullptr;
+  size_t size = 0;
+
+  bool Empty() const {
+    return head == nullptr;
+  }
+  void PushFront(Block* block) {
+    block->prev_ = nullptr;
+    block->next_ = head;
+    if (head) head->prev_ = block;
+    head = block;
+    ++size;
+  }
+  Block* PopFront() {
+    Block* block = head;
+    Remove(block);
+    return block;
+  }
+  void Remove(Block* block) {
+    if (block->prev_) block->prev_->next_ = block->next_;
+    else head = block->next_;
+    if (block->next_) block->next_->prev_ = block->prev_;
+    block->prev_ = block->next_ = nullptr;
+    --size;
+  }
+  /* Move the list out, leaving this one empty. */
+  SLUBBlockList Take() {
+    SLUBBlockList list = *this;
+    *this = {};
+    return list;
+  }
+};
+
+} // namespace crystal::mem
+
+#endif
@@ -1,144 +1,362 @@
 #ifndef CRYSTALMEM_POOL_SLUB_BUCKET_H_
 #define CRYSTALMEM_POOL_SLUB_BUCKET_H_
 
+#include <atomic> // std::atomic
+#include <cstdint> // uint8_t
+#include <initializer_list> // std::initializer_list
+#include <span> // std::span
+#include <thread> // std::this_thread
+#include <type_traits> // std::is_same_v
+
+#include "CrystalMem/pool/page_map.h" // PageMap
 #include "CrystalMem/vendor/concept.h" // Vendor
 #include "block.h" // SLUBBlock
+#include "block_list.h" // SLUBBlockList
+#include "option.h" // SLUBOptions
 
 namespace crystal::mem {
 
-class SLUBBucketInterface {
- public:
-  virtual void* AllocSlot() = 0;
-  virtual void DeallocSlot(void*) = 0;
-  virtual void Clear() = 0;
-  virtual ~SLUBBucketInterface() = default;
-};
+using std::atomic, std::span, std::thread, std::is_same_v,
+    std::memory_order_acquire, std::memory_order_release,
+    std::memory_order_relaxed;
 
 /**
  * A bucket of blocks that have the same slot size.
  *
- * All blocks are of the same size and are organized in a linked list data
- * structure.
- * 
+ * All blocks are of the same size and are organized in three linked lists:
+ *  * partial: blocks with both free and allocated slots, allocation always
+ *  happens at the front of this list;
+ *  * full: blocks without a free slot;
+ *  * empty: blocks without an allocated slot, at most
+ *  `kOptions.empty_block_retention` of them are kept and the rest are released
+ *  to the vendor.
+ *
+ * Threading:
+ * The bucket is owned by the first thread that allocates from it. Only the
+ * owner (or a caller with exclusive access) may call `AllocSlot`, `AllocBatch`,
+ * `DeallocBatch` and `Clear`. `DeallocSlot` may be called from any thread:
+ * foreign frees are pushed onto the block's remote free list and the block is
+ * queued on a lock-free pending stack, which the owner drains once its partial
+ * blocks run out.
+ *
+ * Out of line headers:
+ * With `kOptions.out_of_line_headers`, block headers are allocated from the
+ * logic vendor and the blocks from the vendor hold only slots. The header of a
+ * slot is then looked up in a page map shared by all buckets of a pool, which
+ * must be bound before the first allocation.
+ *
+ * Size class tags:
+ * With `kOptions.size_free_dealloc`, the pages of every block are tagged with
+ * the bucket's tag in a page map shared by all buckets of a pool, so that the
+ * pool can find the bucket of a slot from its address alone.
+ *
  * Memory Responsibilities:
  * This class is responsible for releasing all the block nodes.
+ *
+ * @tparam kPageSize The page size of the header and class maps, at most
+ * `kBlockSize`.
  */
-template <size_t kBlockSize, size_t kSlotSize, AnyVendor Vendor>
-class SLUBBucket : public SLUBBucketInterface {
+template <size_t kBlockSize,
+          size_t kSlotSize,
+          AnyVendor Vendor,
+          SLUBOptions kOptions = SLUBOptions{},
+          AnyVendor LogicVendor = Vendor,
+          size_t kPageSize = kBlockSize>
+class SLUBBucket {
  public:
-  using BlockNode = SLUBBlockNode<kBlockSize, kSlotSize>;
+  using BlockNode =
+      SLUBBlockNode<kBlockSize, kSlotSize, !kOptions.out_of_line_headers>;
+  using HeaderMap = PageMap<kPageSize, void*, LogicVendor>;
+  using ClassMap = PageMap<kPageSize, uint8_t, LogicVendor>;
 
   /* Constructor */
-  SLUBBucket(const Vendor& vendor = {}) : vendor_(vendor) {
+  SLUBBucket(const Vendor& vendor = {})
+      requires is_same_v<Vendor, LogicVendor>
+      : SLUBBucket(vendor, vendor) {
+  }
+  /**
+   * @param class_tag The non-zero tag of the blocks in `class_map`.
+   */
+  SLUBBucket(const Vendor& vendor,
+             const LogicVendor& logic_vendor,
+             HeaderMap* header_map = nullptr,
+             ClassMap* class_map = nullptr,
+             uint8_t class_tag = 0) :
+      vendor_(vendor),
+      logic_vendor_(logic_vendor),
+      header_map_(header_map),
+      class_map_(class_map),
+      class_tag_(class_tag) {
   }
   /* Destructor */
-  virtual ~SLUBBucket() override {
+  ~SLUBBucket() {
     Clear();
   }
   /* No Copying */
   SLUBBucket(const SLUBBucket& other) = delete;
   /* Move Constructor */
   SLUBBucket(SLUBBucket&& other) :
-      vendor_(other.vendor_), block_head_(other.block_head_) {
-    other.block_head_ = nullptr;
+      vendor_(other.vendor_),
+      logic_vendor_(other.logic_vendor_),
+      header_map_(other.header_map_),
+      class_map_(other.class_map_),
+      class_tag_(other.class_tag_),
+      owner_(other.owner_),
+      partial_(other.partial_.Take()),
+      full_(other.full_.Take()),
+      empty_(other.empty_.Take()),
+      next_color_(other.next_color_),
+      pending_(other.pending_.exchange(nullptr, memory_order_relaxed)) {
   }
   /* No Copying */
   SLUBBucket& operator=(const SLUBBucket& rhs) = delete;
   /* Move Assignment */
   SLUBBucket& operator=(SLUBBucket&& rhs) {
+    Clear();
     vendor_ = rhs.vendor_;
-    block_head_ = rhs.block_head_;
-    rhs.block_head_ = nullptr;
+    logic_vendor_ = rhs.logic_vendor_;
+    header_map_ = rhs.header_map_;
+    class_map_ = rhs.class_map_;
+    class_tag_ = rhs.class_tag_;
+    owner_ = rhs.owner_;
+    partial_ = rhs.partial_.Take();
+    full_ = rhs.full_.Take();
+    empty_ = rhs.empty_.Take();
+    next_color_ = rhs.next_color_;
+    pending_.store(rhs.pending_.exchange(nullptr, memory_order_relaxed),
+                   memory_order_relaxed);
+    return *this;
   }
 
   /* Functions */
   /**
    * Allocate a slot with size of `kSlotSize`.
    */
-  [[nodiscard]] virtual void* AllocSlot() override {
-    BlockNode& block = AvailableBlock();
-    void* slot = block.AllocSlot();
-    return slot;
+  [[nodiscard]] void* AllocSlot() {
+    if (owner_ == thread::id()) [[unlikely]]
+      owner_ = std::this_thread::get_id();
+    return AllocLocal();
   }
   /**
    * Deallocate a slot with the input address.
+   *
+   * This function may be called from any thread.
    */
-  virtual void DeallocSlot(void* addr) override {
-    BlockNode* block =
-        BlockNode::FromSlot(reinterpret_cast<BlockNode::SlotNode*>(addr));
-    block->DeallocSlot(addr);
-    /* Move block to front. */
-    MovetoFront(*block);
+  void DeallocSlot(void* addr) {
+    if (std::this_thread::get_id() != owner_) [[unlikely]] {
+      DeallocRemote(addr);
+      return;
+    }
+    DeallocLocal(addr);
   }
   /**
-   * Clear the bucket by deallocating all blocks.
+   * Allocate a slot for every entry of `slots`.
+   *
+   * Whole runs of slots are taken from each block in one pass. Like
+   * `AllocSlot`, only the owner may call this.
    */
-  virtual void Clear() override {
-    while (block_head_) {
-      BlockNode* nxt = block_head_->next_;
-      vendor_.Dealloc(block_head_, sizeof(BlockNode), static_cast<align_t>(alignof(BlockNode)));
-      block_head_ = nxt;
+  void AllocBatch(span<void*> slots) {
+    if (owner_ == thread::id()) [[unlikely]]
+      owner_ = std::this_thread::get_id();
+    for (size_t i = 0; i < slots.size();) {
+      BlockNode& block = AvailableBlock();
+      i += block.AllocSlots(slots.data() + i, slots.size() - i);
+      if (block.Full()) {
+        partial_.Remove(&block);
+        full_.PushFront(&block);
+      }
     }
   }
+  /**
+   * Deallocate all the slots in `slots`.
+   *
+   * Consecutive slots of the same block are returned to it at once, so
+   * batches freed in allocation order touch each block's lists only once.
+   * Unlike `DeallocSlot`, only the owner (or a caller with exclusive access)
+   * may call this.
+   */
+  void DeallocBatch(span<void* const> slots) {
+    for (size_t i = 0; i < slots.size();) {
+      BlockNode* block = BlockOf(slots[i]);
+      size_t j = i + 1;
+      while (j < slots.size() && BlockOf(slots[j]) == block) ++j;
+      bool was_full = block->Full();
+      block->DeallocSlots(slots.data() + i, j - i);
+      if (was_full || block->Empty())
+        Reclassify(block, was_full ? full_ : partial_);
+      i = j;
+    }
+  }
+  /**
+   * Clear the bucket by deallocating all blocks.
+   */
+  void Clear() {
+    for (BlockList* list : { &partial_, &full_, &empty_ })
+      while (!list->Empty()) Release(list->PopFront());
+    pending_.store(nullptr, memory_order_relaxed);
+  }
+  /**
+   * Set the page maps used to find out of line headers and to tag blocks with
+   * their size class.
+   */
+  void BindPageMaps(HeaderMap* header_map, ClassMap* class_map) {
+    header_map_ = header_map;
+    class_map_ = class_map;
+  }
+  /**
+   * Number of blocks currently held by the bucket.
+   */
+  size_t NBlocks() const {
+    return partial_.size + full_.size + empty_.size;
+  }
 
  private:
+  using BlockList = SLUBBlockList<BlockNode>;
+
   /* Variables */
   Vendor vendor_;
-  /**
-   * A **LIST** of blocks.
-   *
-   * @note It is assumed that if there are non-filled blocks among all of the
-   * blocks, then one of them is at the front of the list.
-   */
-  BlockNode* block_head_ = nullptr;
+  /* Source of out of line headers. */
+  LogicVendor logic_vendor_;
+  HeaderMap* header_map_;
+  ClassMap* class_map_;
+  uint8_t class_tag_;
+  /* The thread allowed to touch the block lists. */
+  thread::id owner_;
+  BlockList partial_;
+  BlockList full_;
+  BlockList empty_;
+  /* Color of the next new block. */
+  size_t next_color_ = 0;
+  /* A lock-free stack of blocks with pending remote frees. */
+  atomic<BlockNode*> pending_ = nullptr;
 
   /* Functions */
+  BlockNode* BlockOf(void* addr) const {
+    if constexpr (kOptions.out_of_line_headers)
+      return static_cast<BlockNode*>(header_map_->Get(addr));
+    else
+      return BlockNode::FromSlot(
+          reinterpret_cast<BlockNode::SlotNode*>(addr));
+  }
+  void* AllocLocal() {
+    BlockNode& block = AvailableBlock();
+    void* slot = block.AllocSlot();
+    if (block.Full()) [[unlikely]] {
+      partial_.Remove(&block);
+      full_.PushFront(&block);
+    }
+    return slot;
+  }
+  void DeallocLocal(void* addr) {
+    BlockNode* block = BlockOf(addr);
+    bool was_full = block->Full();
+    block->DeallocSlot(addr);
+    if (was_full || block->Empty()) [[unlikely]]
+      Reclassify(block, was_full ? full_ : partial_);
+  }
+  void DeallocRemote(void* addr) {
+    BlockNode* block = BlockOf(addr);
+    if (!block->DeallocRemote(addr)) return; // already queued
+    /* Queue the block for the owner. */
+    BlockNode* pending = pending_.load(memory_order_relaxed);
+    do {
+      block->pending_next_ = pending;
+    } while (!pending_.compare_exchange_weak(
+        pending, block, memory_order_release, memory_order_relaxed));
+  }
   /**
-   * Get an available block.
+   * Take back the slots freed by other threads.
+   */
+  void CollectRemote() {
+    BlockNode* block = pending_.exchange(nullptr, memory_order_acquire);
+    while (block) {
+      /* Read the link before the block can be queued again. */
+      BlockNode* nxt = block->pending_next_;
+      bool was_full = block->Full();
+      block->CollectRemote();
+      Reclassify(block, was_full ? full_ : partial_);
+      block = nxt;
+    }
+  }
+  /**
+   * Move a block that just gained free slots out of `list` if needed.
    *
-   * If there are no available blocks, this function will allocate a new block.
+   * Only blocks that were full or became empty change list.
    */
-  BlockNode& AvailableBlock() {
-    /* Expand blocks. */
-    if (block_head_ == nullptr) {
-      BlockNode* new_block = reinterpret_cast<BlockNode*>(vendor_.Alloc(
-          sizeof(BlockNode), static_cast<align_t>(alignof(BlockNode))));
-      new (new_block) BlockNode();
-      block_head_ = new_block;
-    } else if (block_head_->Full()) [[unlikely]] {
-      BlockNode* curr_head = block_head_;
-      BlockNode* new_block = reinterpret_cast<BlockNode*>(vendor_.Alloc(
-          sizeof(BlockNode), static_cast<align_t>(alignof(BlockNode))));
-      new (new_block) BlockNode();
-      new_block->next_ = curr_head;
-      new_block->prev_ = nullptr;
-      curr_head->prev_ = new_block;
-      block_head_ = new_block;
+  void Reclassify(BlockNode* block, BlockList& list) {
+    if (block->Empty()) {
+      list.Remove(block);
+      Retire(block);
+    } else if (&list == &full_) {
+      full_.Remove(block);
+      partial_.PushFront(block);
     }
-    return *block_head_;
-  }
-  void MovetoFront(BlockNode& node) {
-    BlockNode* curr = &node;
-    BlockNode* prev = node.prev_;
-    BlockNode* next = node.next_;
-    if (prev == nullptr) return;
-    if (next) {
-      prev->next_ = next;
-      next->prev_ = prev;
-      curr->next_ = block_head_;
-      curr->prev_ = nullptr;
-      block_head_->prev_ = curr;
-      block_head_ = curr;
+  }
+  /**
+   * Keep an empty block for reuse, or release it past the retention count.
+   */
+  void Retire(BlockNode* block) {
+    if (empty_.size < kOptions.empty_block_retention) {
+      block->Reset();
+      empty_.PushFront(block);
+    } else Release(block);
+  }
+  void Release(BlockNode* block) {
+    if constexpr (kOptions.size_free_dealloc)
+      class_map_->Set(block->Memory(), kBlockSize, 0);
+    if constexpr (kOptions.out_of_line_headers) {
+      void* memory = block->Memory();
+      header_map_->Set(memory, kBlockSize, nullptr);
+      vendor_.Dealloc(memory, kBlockSize, static_cast<align_t>(kBlockSize));
+      block->~BlockNode();
+      logic_vendor_.Dealloc(
+          block, sizeof(BlockNode), static_cast<align_t>(alignof(BlockNode)));
     } else {
-      prev->next_ = nullptr;
-      curr->next_ = block_head_;
-      curr->prev_ = nullptr;
-      block_head_->prev_ = curr;
-      block_head_ = curr;
+      block->~BlockNode();
+      vendor_.Dealloc(
+          block, sizeof(BlockNode), static_cast<align_t>(alignof(BlockNode)));
     }
   }
+  BlockNode* CreateBlock() {
+    size_t color = kOptions.cache_coloring ? next_color_++ : 0;
+    BlockNode* block;
+    if constexpr (kOptions.out_of_line_headers) {
+      void* memory =
+          vendor_.Alloc(kBlockSize, static_cast<align_t>(kBlockSize));
+      block = new (logic_vendor_.Alloc(
+          sizeof(BlockNode), static_cast<align_t>(alignof(BlockNode))))
+          BlockNode(memory, color);
+      header_map_->Set(memory, kBlockSize, block);
+    } else {
+      block = new (vendor_.Alloc(sizeof(BlockNode),
+                                 static_cast<align_t>(alignof(BlockNode))))
+          BlockNode(color);
+    }
+    if constexpr (kOptions.size_free_dealloc)
+      class_map_->Set(block->Memory(), kBlockSize, class_tag_);
+    return block;
+  }
+  /**
+   * Get an available block.
+   */
+  BlockNode& AvailableBlock() {
+    if (partial_.Empty()) [[unlikely]] Replenish();
+    return *partial_.head;
+  }
+  /**
+   * Refill the empty partial list.
+   *
+   * Remote frees are collected first, then an empty block is reused or a new
+   * block is allocated.
+   */
+  void Replenish() {
+    if (pending_.load(memory_order_relaxed)) CollectRemote();
+    if (!partial_.Empty()) return;
+    if (empty_.Empty()) partial_.PushFront(CreateBlock());
+    else partial_.PushFront(empty_.PopFront());
+  }
 };
 
 } // namespace crystal::mem
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,57 @@
+#ifndef CRYSTALMEM_POOL_SLUB_DISPATCH_H_
+#define CRYSTALMEM_POOL_SLUB_DISPATCH_H_
+
+#include <array> // std::array
+#include <tuple> // std::tuple_size_v
+#include <utility> // std::index_sequence
+
+#include "CrystalMem/type.h" // size_t
+
+namespace crystal::mem {
+
+using std::array, std::tuple_size_v, std::get, std::index_sequence,
+    std::make_index_sequence;
+
+/**
+ * Per size class entry points of the runtime sized hot path of a SLUB pool.
+ *
+ * Each entry is a plain function with the bucket's slot allocation inlined,
+ * so dispatching costs a single indirect call through a constant table.
+ *
+ * @tparam Buckets The tuple of buckets, one per size class.
+ */
+template <typename Buckets>
+class SLUBDispatch {
+ public:
+  /* Constants */
+  static constexpr size_t kNBuckets = tuple_size_v<Buckets>;
+
+ private:
+  /* Defined before the tables that take their addresses. */
+  template <size_t kIdx>
+  static void* AllocSlotOf(Buckets& buckets) {
+    return get<kIdx>(buckets).AllocSlot();
+  }
+  template <size_t kIdx>
+  static void DeallocSlotOf(Buckets& buckets, void* ptr) {
+    get<kIdx>(buckets).DeallocSlot(ptr);
+  }
+
+ public:
+  static constexpr auto kAllocSlot =
+      []<size_t... Is>(index_sequence<Is...>) {
+        return array<void* (*)(Buckets&), sizeof...(Is)>{
+          &AllocSlotOf<Is>...
+        };
+      }(make_index_sequence<kNBuckets>{});
+  static constexpr auto kDeallocSlot =
+      []<size_t... Is>(index_sequence<Is...>) {
+        return array<void (*)(Buckets&, void*), sizeof...(Is)>{
+          &DeallocSlotOf<Is>...
+        };
+      }(make_index_sequence<kNBuckets>{});
+};
+
+} // namespace crystal::mem
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef CRYSTALMEM_POOL_SLUB_MAGAZINE_H_
+#define CRYSTALMEM_POOL_SLUB_MAGAZINE_H_
+
+#include <array> // std::array
+
+#include "CrystalMem/type.h" // size_t
+
+namespace crystal::mem {
+
+using std::array;
+
+/**
+ * A fixed size stack of free slots of a single size class.
+ *
+ * Magazines live in thread local storage and sit in front of a shared
+ * `SLUBBucket`, so that most allocations and deallocations never touch shared
+ * state. They are refilled from and flushed back to the bucket in batches of
+ * `kBatch` slots.
+ *
+ * Ownership responsibilities:
+ *  Objects of this class have **NO** memory ownership responsibilities.
+ */
+template <size_t kCapacity>
+struct SLUBMagazine {
+  static_assert(kCapacity >= 2, "Magazine too small for batching.");
+
+  /* Constants */
+  static constexpr size_t kBatch = kCapacity / 2;
+
+  /* Variables */
+  size_t count = 0;
+  array<void*, kCapacity> slots;
+
+  /* Functions */
+  bool Empty() const {
+    return count == 0;
+  }
+  bool Full() const {
+    return count == kCapacity;
+  }
+  void* Pop() {
+    return slots[--count];
+  }
+  void Push(void* slot) {
+    slots[count++] = slot;
+  }
+  /**
+   * Slots to be refilled by the bucket.
+   *
+   * The magazine must be empty.
+   */
+  void** RefillRange() {
+    return slots.data();
+  }
+  /**
+   * Drop the oldest `kBatch` slots after they have been flushed to the bucket.
+   *
+   * The most recently freed (and so cache-hot) slots are kept.
+   */
+  void DropFlushed() {
+    for (size_t i = kBatch; i < count; ++i) slots[i - kBatch] = slots[i];
+    count -= kBatch;
+  }
+};
+
+} // namespace crystal::mem
+
+#endif
@@ -0,0 +1,107 @@
+#ifndef CRYSTALMEM_POOL_SLUB_OPTION_H_
+#define CRYSTALMEM_POOL_SLUB_OPTION_H_
+
+#include "CrystalMem/type.h" // size_t
+
+namespace crystal::mem {
+
+/**
+ * Tuning knobs of a `SLUBPool`.
+ *
+ * This is a structural type so that it can be passed as a template argument,
+ * e.g. `SLUBPool<4_kB, { 8_B, 64_B }, V, V, SLUBOptions{ .magazine_size = 32 }>`.
+ */
+struct SLUBOptions {
+  /**
+   * Number of slots each thread caches per size class.
+   *
+   * `0` disables the thread cache, in which case the pool is **NOT** thread
+   * safe.
+   */
+  size_t magazine_size = 0;
+  /**
+   * Number of pools of the same type that each thread caches for at once.
+   *
+   * Every pool claims one of these per-thread caches. Once all are claimed,
+   * pools share the least used one, and a thread alternating between pools
+   * that share a cache flushes it at every switch. Each thread holds this many
+   * caches, so the thread local storage grows with this count.
+   */
+  size_t thread_cache_slots = 4;
+  /**
+   * Number of empty blocks each size class keeps around.
+   *
+   * Blocks that become empty beyond this count are released to the vendor,
+   * so that memory shrinks after a burst without an allocation and
+   * deallocation pair at a block boundary hitting the vendor every time.
+   */
+  size_t empty_block_retention = 1;
+  /**
+   * Minimum number of slots in a block.
+   *
+   * Together with `max_block_waste_percent`, this picks the block size of
+   * each size class: starting from the pool's block size, blocks double until
+   * both bounds hold or `max_block_size` is reached.
+   */
+  size_t min_slots_per_block = 1;
+  /**
+   * Maximum share of a block, in percent, lost to its header, alignment and
+   * the tail that is too small for a slot.
+   */
+  size_t max_block_waste_percent = 100;
+  /**
+   * Upper bound of the grown block sizes.
+   */
+  size_t max_block_size = size_t{ 1 } << 20;
+  /**
+   * Whether new blocks of a size class start their slots at rotating cache
+   * line offsets, using the space a block cannot fit a slot into anyway.
+   */
+  bool cache_coloring = true;
+  /**
+   * Whether block headers live in logic memory instead of at the start of
+   * each block.
+   *
+   * Blocks then hold `block size / slot size` slots, which saves a slot per
+   * block for power of 2 classes, at the cost of a page map lookup on every
+   * deallocation.
+   */
+  bool out_of_line_headers = false;
+  /**
+   * Whether the pool can deallocate an object from its address alone, with
+   * `Dealloc`.
+   *
+   * Every block page is then tagged with its size class in a page map, which
+   * costs a page map update per block allocation and release.
+   */
+  bool size_free_dealloc = false;
+
+  /* Functions */
+  /**
+   * Block size of a size class.
+   *
+   * @param base_size The pool's block size, a power of 2.
+   * @param slot_size The slot size of the size class.
+   * @param header_size Bytes of each block taken by in-block metadata.
+   */
+  constexpr size_t BlockSize(size_t base_size,
+                             size_t slot_size,
+                             size_t header_size) const {
+    size_t block_size = base_size;
+    while (block_size < max_block_size) {
+      size_t n_slots = block_size > header_size
+                         ? (block_size - header_size) / slot_size
+                         : 0;
+      size_t waste = block_size - n_slots * slot_size;
+      if (n_slots >= min_slots_per_block && n_slots > 0
+          && waste * 100 <= max_block_waste_percent * block_size)
+        break;
+      block_size <<= 1;
+    }
+    return block_size;
+  }
+};
+
+} // namespace crystal::mem
+
+#endif
@@ -0,0 +1,193 @@
+#ifndef CRYSTALMEM_POOL_SLUB_SIZE_CLASS_H_
+#define CRYSTALMEM_POOL_SLUB_SIZE_CLASS_H_
+
+#include <CrystalBase/bitwise.h> // lowbit
+#include <CrystalBase/integer_sequence.h> // integer_sequence
+
+#include <array> // std::array
+#include <bit> // std::bit_width
+#include <cstdint> // uint8_t
+#include <limits> // std::numeric_limits
+
+#include "CrystalMem/type.h" // size_t, align_t
+
+namespace crystal::mem {
+
+using std::array, std::bit_width, std::numeric_limits;
+
+/**
+ * Compile time size to size class mapping of a SLUB pool.
+ *
+ * The mapping is a table generated from the slot sizes:
+ *  * sizes up to `kSmallLimit` are indexed by `(size + 7) >> 3`;
+ *  * larger sizes are indexed by their power of two group plus 8 linear steps
+ *  within the group.
+ * Each entry holds the best fit for the smallest size of its range. A slot
+ * size off that grid (not a multiple of 8 bytes or, past `kSmallLimit`, of an
+ * eighth of its power of two group) splits its range, so a lookup moves on to
+ * the next larger slot size while the entry is too small, and is exact for any
+ * slot sizes.
+ *
+ * Slot sizes need not be powers of 2. A slot is aligned to the largest power
+ * of 2 that divides its size, so requests with a stricter alignment fall back
+ * to a linear search for a slot that is both large and aligned enough.
+ */
+template <integer_sequence kSlotSizes>
+class SLUBSizeClasses {
+ public:
+  /* Constants */
+  static constexpr size_t kNClasses = kSlotSizes.size();
+  static_assert(kNClasses < numeric_limits<uint8_t>::max(),
+                "Too many size classes.");
+  static_assert([] {
+    size_t i = 0;
+    for (auto slot_size : kSlotSizes) {
+      size_t j = 0;
+      for (auto other : kSlotSizes)
+        if (j++ < i && other == slot_size) return false;
+      i++;
+    }
+    return true;
+  }(), "Slot sizes must be distinct.");
+  static constexpr size_t kMaxSize = [] {
+    size_t max_size = 0;
+    for (auto slot_size : kSlotSizes)
+      if (slot_size > max_size) max_size = slot_size;
+    return max_size;
+  }();
+  /* Sizes up to this limit use the 8 byte granular table. */
+  static constexpr size_t kSmallLimit =
+      kMaxSize < 1024 ? (kMaxSize + 7) & ~size_t{ 7 } : 1024;
+
+  /* Static Functions */
+  /**
+   * Find the index of the smallest slot size that fits `size`.
+   *
+   * @return The index in `kSlotSizes`, **OR** `-1ul` if no slot fits.
+   */
+  static constexpr size_t Lookup(size_t size) {
+    if (size > kMaxSize) return -1ul;
+    size_t idx = size <= kSmallLimit ? kSmallTable[(size + 7) >> 3]
+                                     : kLargeTable[LargeIndex(size)];
+    /* Only for slot sizes off the grid. */
+    while (kSlotSizes[idx] < size) [[unlikely]] idx = kNextTable[idx];
+    return idx;
+  }
+  /**
+   * Find the index of the smallest slot size that fits `size` and whose slots
+   * are aligned to `align`.
+   *
+   * @return The index in `kSlotSizes`, **OR** `-1ul` if no slot fits.
+   */
+  static constexpr size_t Lookup(size_t size, align_t align) {
+    size_t idx = Lookup(size);
+    if (idx != -1ul && lowbit(kSlotSizes[idx]) < static_cast<size_t>(align))
+        [[unlikely]]
+      return Search(size, static_cast<size_t>(align));
+    return idx;
+  }
+  /**
+   * Number of bytes an allocation of `size` bytes aligned to `align` may use:
+   * the slot size of its size class, or `size` if no slot fits.
+   */
+  static constexpr size_t Capacity(size_t size, align_t align) {
+    size_t idx = Lookup(size, align);
+    return idx == -1ul ? size : kSlotSizes[idx];
+  }
+  /**
+   * Whether an allocation keeps its slot at a new size: it stays in its size
+   * class, or a large allocation stays large and within its recorded size.
+   *
+   * @param large_allocs The map of the allocations that fit no size class.
+   */
+  template <typename LargeMap>
+  static bool ResizeInPlace(const LargeMap& large_allocs,
+                            const void* ptr,
+                            size_t old_size,
+                            size_t new_size,
+                            align_t align) {
+    size_t idx = Lookup(new_size, align);
+    if (idx != Lookup(old_size, align)) return false;
+    return idx != -1ul || new_size <= large_allocs.Size(ptr);
+  }
+  /**
+   * Linear best fit search, used to generate the tables.
+   */
+  static constexpr size_t Search(size_t size, size_t align = 1) {
+    size_t best_fit_idx = -1ul;
+    size_t best_fit_slot_size = numeric_limits<size_t>::max();
+    size_t i = 0;
+    for (auto slot_size : kSlotSizes) {
+      if (size <= slot_size && lowbit(slot_size) >= align
+          && slot_size < best_fit_slot_size) {
+        best_fit_slot_size = slot_size;
+        best_fit_idx = i;
+      }
+      i++;
+    }
+    return best_fit_idx;
+  }
+
+ private:
+  /* Power of two groups `(2^(g-1), 2^g]` past the small limit. */
+  static constexpr size_t kMinGroup = bit_width(kSmallLimit);
+  static constexpr size_t kMaxGroup =
+      kMaxSize > kSmallLimit ? bit_width(kMaxSize - 1) : kMinGroup - 1;
+  static constexpr size_t kStepsPerGroup = 8;
+
+  /* The last range may reach past the largest slot. */
+  static constexpr size_t Clamp(size_t size) {
+    return size < kMaxSize ? size : kMaxSize;
+  }
+  static constexpr size_t LargeIndex(size_t size) {
+    size_t group = bit_width(size - 1);
+    size_t step = ((size - 1) >> (group - 4)) & (kStepsPerGroup - 1);
+    return (group - kMinGroup) * kStepsPerGroup + step;
+  }
+
+  using SmallTable = array<uint8_t, (kSmallLimit >> 3) + 1>;
+  using LargeTable =
+      array<uint8_t, (kMaxGroup + 1 - kMinGroup) * kStepsPerGroup + 1>;
+  using NextTable = array<uint8_t, kNClasses>;
+  /* Defined after the class is complete. */
+  static const SmallTable kSmallTable;
+  static const LargeTable kLargeTable;
+  /* The index of the next larger slot size of each class. */
+  static const NextTable kNextTable;
+};
+
+template <integer_sequence kSlotSizes>
+constexpr typename SLUBSizeClasses<kSlotSizes>::SmallTable
+    SLUBSizeClasses<kSlotSizes>::kSmallTable = [] {
+      SmallTable table{};
+      for (size_t i = 0; i < table.size(); ++i)
+        table[i] = static_cast<uint8_t>(Search(Clamp(i ? (i << 3) - 7 : 0)));
+      return table;
+    }();
+template <integer_sequence kSlotSizes>
+constexpr typename SLUBSizeClasses<kSlotSizes>::LargeTable
+    SLUBSizeClasses<kSlotSizes>::kLargeTable = [] {
+      LargeTable table{};
+      for (size_t group = kMinGroup; group <= kMaxGroup; ++group) {
+        for (size_t step = 0; step < kStepsPerGroup; ++step) {
+          /* The smallest size of the step. */
+          size_t size = (size_t{ 1 } << (group - 1))
+                      + (step << (group - 4)) + 1;
+          table[(group - kMinGroup) * kStepsPerGroup + step] =
+              static_cast<uint8_t>(Search(Clamp(size)));
+        }
+      }
+      return table;
+    }();
+template <integer_sequence kSlotSizes>
+constexpr typename SLUBSizeClasses<kSlotSizes>::NextTable
+    SLUBSizeClasses<kSlotSizes>::kNextTable = [] {
+      NextTable table{};
+      for (size_t i = 0; i < table.size(); ++i)
+        table[i] = static_cast<uint8_t>(Search(kSlotSizes[i] + 1));
+      return table;
+    }();
+
+} // namespace crystal::mem
+
+#endif
@@ -1,6 +1,8 @@
 #ifndef CRYSTALMEM_POOL_SLUB_SLOT_H_
 #define CRYSTALMEM_POOL_SLUB_SLOT_H_
 
+#include <CrystalBase/bitwise.h> // lowbit
+
 #include <array> // std::array
 
 namespace crystal::mem {
@@ -11,13 +13,16 @@ using std::array;
  * A slot that potentially holds an object.
  * 
  * This slot is a part of SLUB slab allocator so it contains a free list node.
+ * The size need not be a power of 2, the slot is aligned to the largest power
+ * of 2 that divides it (e.g. 16 bytes for a 48 byte slot).
  * Memory Layout:
  * | free_list_node / data |
  */
 template <size_t kSize>
-union alignas(kSize) SLUBSlotNode {
+union alignas(lowbit(kSize)) SLUBSlotNode {
 // clang-format off
   static_assert(kSize >= sizeof(size_t), "Size of a slot must be larger than that of a free list node.");
+  static_assert(kSize % alignof(size_t) == 0, "Size of a slot must be a multiple of the free list node alignment.");
 // clang-format on
 
   std::array<std::byte, kSize> data;
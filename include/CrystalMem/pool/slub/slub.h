@@ -4,38 +4,95 @@
 #include <CrystalBase/integer_sequence.h> // integer_sequence
 
 #include <array> // std::array
-#include <cstddef> // std::byte
+#include <atomic>  // std::atomic
+#include <cstdint> // uint8_t
+#include <cstddef> // std::byte, std::max_align_t
 #include <limits>  // std::nuneric_limits
 #include <memory>  // std::allocator
+#include <mutex>   // std::mutex
+#include <span>    // std::span
 #include <tuple>   // std::tuple
-#include <unordered_map> // std::unordered_map
 #include <utility> // std::index_sequence
 
 #include "CrystalMem/pool/concept.h" // AnyPool
+#include "CrystalMem/pool/large_map.h" // LargeAllocMap
+#include "CrystalMem/pool/page_map.h" // PageMap
 #include "CrystalMem/type.h"         // _kB
 #include "CrystalMem/vendor.h"       // AnyVendor
-#include "CrystalMem/vendor/allocator.h" // VendorAllocator
+#include "block.h"                   // SLUBBlockNode
 #include "bucket.h"                  // SLUBBucket
+#include "dispatch.h"                // SLUBDispatch
+#include "magazine.h"                // SLUBMagazine
+#include "option.h"                  // SLUBOptions
+#include "size_class.h"              // SLUBSizeClasses
 
 namespace crystal::mem {
 
 using std::allocator, std::byte, std::tuple, std::index_sequence,
     std::make_index_sequence, std::numeric_limits, std::allocator_traits,
-    std::get, std::apply, std::unordered_map, std::pair, std::hash,
-    std::equal_to, std::array, std::is_same_v;
+    std::get, std::apply, std::array, std::is_same_v, std::atomic, std::mutex,
+    std::lock_guard, std::unique_lock, std::defer_lock,
+    std::memory_order_relaxed, std::span;
 
+/**
+ * A memory pool that implements the SLUB strategy: every size class owns a
+ * bucket of blocks that are carved into equally sized slots.
+ *
+ * The free lists are stored inside the slots, so this pool **DOES** operate on
+ * the memory obtained from the resource vendor.
+ *
+ * Slot sizes may be any multiple of 8 bytes, e.g. a `{ 16, 24, 32, 48, 64 }`
+ * ladder. Slots are aligned to the largest power of 2 dividing their size and
+ * over-aligned requests are served by a larger, sufficiently aligned class.
+ *
+ * @tparam kBlockSize The smallest block size, size classes get larger blocks
+ * as needed to satisfy the block bounds in `kOptions`.
+ * @tparam kSlotSizes The slot size of each size class.
+ * @tparam ResourceVendor The vendor to request data memory from.
+ * @tparam LogicVendor The vendor to request memory for allocating logic state.
+ * @tparam kOptions See `SLUBOptions`. With a non-zero `magazine_size`, every
+ * thread keeps a magazine of free slots per size class in front of the shared
+ * buckets and the pool may be used from multiple threads. Magazines belong to
+ * a pool instance, see `thread_cache_slots`.
+ */
 template <size_t kBlockSize,
           integer_sequence kSlotSizes,
           AnyVendor ResourceVendor,
-          AnyVendor LogicVendor = ResourceVendor>
+          AnyVendor LogicVendor = ResourceVendor,
+          SLUBOptions kOptions = SLUBOptions{}>
 class SLUBPool {
  public:
   /* Attributes */
   static constexpr bool kInMemoryOptimization = true;
+  static constexpr bool kThreadCached = kOptions.magazine_size > 0;
+  static_assert(!kThreadCached || kOptions.thread_cache_slots > 0,
+                "A thread cached pool needs a thread cache slot.");
 
+  /* Block size of the size class with slots of `kSlotSize`. The header size
+   * does not depend on the slot size, which may not even fit `kBlockSize`. */
   template <size_t kSlotSize>
-  using Bucket = SLUBBucket<kBlockSize, kSlotSize, ResourceVendor>;
-  using BucketInterface = SLUBBucketInterface;
+  static constexpr size_t kBucketBlockSize = kOptions.BlockSize(
+      kBlockSize,
+      kSlotSize,
+      kOptions.out_of_line_headers
+        ? 0
+        : SLUBBlockNode<kBlockSize, sizeof(size_t)>::kHeaderSize);
+  template <size_t kSlotSize>
+  using Bucket = SLUBBucket<kBucketBlockSize<kSlotSize>,
+                            kSlotSize,
+                            ResourceVendor,
+                            kOptions,
+                            LogicVendor,
+                            kBlockSize>;
+  /* Out of line block headers by block page. */
+  using HeaderMap = PageMap<kBlockSize, void*, LogicVendor>;
+  /* Size class index + 1 by block page, 0 for pages of no block. */
+  using ClassMap = PageMap<kBlockSize, uint8_t, LogicVendor>;
+  static_assert(!kOptions.size_free_dealloc || kSlotSizes.size() < 256,
+                "Too many size classes for 8 bit class tags.");
+  using SizeClasses = SLUBSizeClasses<kSlotSizes>;
+  /* Allocations that fit no size class. */
+  using LargeMap = LargeAllocMap<SizeClasses::kMaxSize + 1, LogicVendor>;
 
   /* Constructor */
   SLUBPool(const ResourceVendor& vendor)
@@ -45,101 +102,195 @@ class SLUBPool {
   SLUBPool(const ResourceVendor& resource_vendor,
            const LogicVendor& logic_vendor) :
       resource_vendor_(resource_vendor),
-      buckets_(Buckets::Init(resource_vendor)),
-      extern_allocs_(
-          VendorAllocator<pair<void*, pair<size_t, align_t>>, LogicVendor>{
-              logic_vendor }) {
-    size_t i = 0;
-    apply(
-        [&](auto&... buckets) { ((bucket_interfaces_[i++] = &buckets), ...); },
-        buckets_);
+      header_map_(logic_vendor),
+      class_map_(logic_vendor),
+      buckets_(Buckets::Init(
+          resource_vendor, logic_vendor, &header_map_, &class_map_)),
+      large_allocs_(logic_vendor) {
   }
   /* Destructor */
   ~SLUBPool() {
     Clear();
+    ReleaseCacheSlot();
   }
   SLUBPool(const SLUBPool& other) = delete;
+  /* The flush looks blocks up in the page maps, so it runs before any member
+   * is moved. */
   SLUBPool(SLUBPool&& other) :
-      resource_vendor_(other.resource_vendor_),
+      resource_vendor_((other.FlushCaches(), other.resource_vendor_)),
+      header_map_(move(other.header_map_)),
+      class_map_(move(other.class_map_)),
       buckets_(move(other.buckets_)),
-      extern_allocs_(move(other.extern_allocs_)) {
-    size_t i = 0;
-    apply(
-        [&](auto&... buckets) { ((bucket_interfaces_[i++] = &buckets), ...); },
-        buckets_);
+      large_allocs_(move(other.large_allocs_)) {
+    BindPageMaps();
   }
   SLUBPool& operator=(const SLUBPool& rhs) = delete;
   SLUBPool& operator=(SLUBPool&& rhs) {
+    Clear();
+    rhs.FlushCaches();
     resource_vendor_ = rhs.resource_vendor_;
     buckets_ = move(rhs.buckets_);
-    extern_allocs_ = move(rhs.extern_allocs_);
-    size_t i = 0;
-    apply(
-        [&](auto&... buckets) { ((bucket_interfaces_[i++] = &buckets), ...); },
-        buckets_);
+    header_map_ = move(rhs.header_map_);
+    class_map_ = move(rhs.class_map_);
+    large_allocs_ = move(rhs.large_allocs_);
+    BindPageMaps();
+    return *this;
   }
 
   /* Functions */
   template <typename T>
   T* DiscreteAlloc() {
-    constexpr size_t bucket_idx = BucketforSize(sizeof(T));
+    constexpr size_t bucket_idx =
+        BucketforSize(sizeof(T), static_cast<align_t>(alignof(T)));
     if constexpr (bucket_idx == -1ul) { // no bucket
-      void* addr =
-          resource_vendor_.Alloc(sizeof(T), static_cast<align_t>(alignof(T)));
-      extern_allocs_[addr] = { sizeof(T), static_cast<align_t>(alignof(T)) };
-      return reinterpret_cast<T*>(addr);
+      return reinterpret_cast<T*>(
+          ExternAlloc(sizeof(T), static_cast<align_t>(alignof(T))));
+    } else if constexpr (kThreadCached) {
+      return reinterpret_cast<T*>(CachedAlloc(bucket_idx));
     } else return reinterpret_cast<T*>(get<bucket_idx>(buckets_).AllocSlot());
   }
   template <typename T>
   void DiscreteDealloc(T* ptr) {
-    constexpr size_t bucket_idx = BucketforSize(sizeof(T));
+    constexpr size_t bucket_idx =
+        BucketforSize(sizeof(T), static_cast<align_t>(alignof(T)));
     if constexpr (bucket_idx == -1ul) { // no bucket
-      resource_vendor_.Dealloc(
-          ptr, sizeof(T), static_cast<align_t>(alignof(T)));
-      extern_allocs_.erase(reinterpret_cast<void*>(ptr));
+      ExternDealloc(ptr);
+    } else if constexpr (kThreadCached) {
+      CachedDealloc(bucket_idx, ptr);
     } else get<bucket_idx>(buckets_).DeallocSlot(ptr);
   }
   template <typename T>
   T* ContinuousAlloc(size_t n) {
-    size_t bucket_idx = BucketforSize(sizeof(T) * n);
+    return reinterpret_cast<T*>(
+        RawAlloc(sizeof(T) * n, static_cast<align_t>(alignof(T))));
+  }
+  template <typename T>
+  void ContinuousDealloc(T* ptr, size_t n) {
+    RawDealloc(ptr, sizeof(T) * n, static_cast<align_t>(alignof(T)));
+  }
+  /**
+   * Allocate an array of at least `n` objects, which holds as many objects as
+   * fit in the slot of its size class.
+   *
+   * @return The array and the number of objects it holds.
+   */
+  template <typename T>
+  AllocationResult<T*> ContinuousAllocAtLeast(size_t n) {
+    T* ptr = ContinuousAlloc<T>(n);
+    if (!ptr) return { ptr, n };
+    return { ptr,
+             SizeClasses::Capacity(sizeof(T) * n,
+                                   static_cast<align_t>(alignof(T)))
+                 / sizeof(T) };
+  }
+  /**
+   * Grow an array from `old_n` to `new_n` objects, which succeeds when it
+   * stays in its size class, or within a large allocation.
+   *
+   * @return Whether the array grew, otherwise it is left as is.
+   */
+  template <typename T>
+  bool TryExpandInPlace(T* ptr, size_t old_n, size_t new_n) {
+    return SizeClasses::ResizeInPlace(large_allocs_,
+                                      ptr,
+                                      sizeof(T) * old_n,
+                                      sizeof(T) * new_n,
+                                      static_cast<align_t>(alignof(T)));
+  }
+  /**
+   * Shrink an array from `old_n` to `new_n` objects, `new_n <= old_n`, which
+   * succeeds when it stays in its size class, or stays a large allocation.
+   *
+   * @return Whether the array shrank, otherwise it keeps its old size.
+   */
+  template <typename T>
+  bool Shrink(T* ptr, size_t old_n, size_t new_n) {
+    return SizeClasses::ResizeInPlace(large_allocs_,
+                                      ptr,
+                                      sizeof(T) * old_n,
+                                      sizeof(T) * new_n,
+                                      static_cast<align_t>(alignof(T)));
+  }
+  void* RawAlloc(size_t size, align_t align) {
+    size_t bucket_idx = BucketforSize(size, align);
     if (bucket_idx == -1ul) { // no bucket
-      void* addr = resource_vendor_.Alloc(sizeof(T) * n,
-                                          static_cast<align_t>(alignof(T)));
-      extern_allocs_[addr] = { sizeof(T), static_cast<align_t>(alignof(T)) };
-      return reinterpret_cast<T*>(addr);
+      return ExternAlloc(size, align);
+    } else if constexpr (kThreadCached) {
+      return CachedAlloc(bucket_idx);
     } else {
-      return reinterpret_cast<T*>(bucket_interfaces_[bucket_idx]->AllocSlot());
+      return Dispatch::kAllocSlot[bucket_idx](buckets_);
     }
   }
-  template <typename T>
-  void ContinuousDealloc(T* ptr, size_t n) {
-    size_t bucket_idx = BucketforSize(sizeof(T) * n);
+  void RawDealloc(void* ptr, size_t size, align_t align) {
+    size_t bucket_idx = BucketforSize(size, align);
     if (bucket_idx == -1ul) { // no bucket
-      resource_vendor_.Dealloc(
-          ptr, sizeof(T) * n, static_cast<align_t>(alignof(T)));
-      extern_allocs_.erase(reinterpret_cast<void*>(ptr));
+      ExternDealloc(ptr);
+    } else if constexpr (kThreadCached) {
+      CachedDealloc(bucket_idx, ptr);
     } else {
-      bucket_interfaces_[bucket_idx]->DeallocSlot(reinterpret_cast<void*>(ptr));
+      Dispatch::kDeallocSlot[bucket_idx](buckets_, ptr);
     }
   }
-  void* RawAlloc(size_t size, align_t align) {
+  /**
+   * Deallocate an object from its address alone, like `free`.
+   *
+   * The size class is read from the tag of the block page, and addresses in
+   * no block are large allocations. Deallocating `nullptr` does nothing.
+   */
+  void Dealloc(void* ptr) requires (kOptions.size_free_dealloc) {
+    if (!ptr) [[unlikely]] return;
+    size_t tag = class_map_.Get(ptr);
+    if (tag == 0) { // no bucket
+      ExternDealloc(ptr);
+    } else if constexpr (kThreadCached) {
+      CachedDealloc(tag - 1, ptr);
+    } else {
+      Dispatch::kDeallocSlot[tag - 1](buckets_, ptr);
+    }
+  }
+  /**
+   * Number of usable bytes at `ptr`, which must come from this pool.
+   *
+   * This is the slot size of its size class, or the requested size of a large
+   * allocation.
+   */
+  size_t UsableSize(const void* ptr) const
+      requires (kOptions.size_free_dealloc) {
+    size_t tag = class_map_.Get(ptr);
+    if (tag == 0) return large_allocs_.Size(ptr); // no bucket
+    return kSlotSizes[tag - 1];
+  }
+  /**
+   * Allocate an object of `size` bytes for every entry of `ptrs`.
+   *
+   * The slots are taken from the bucket in runs, one pass per block. With a
+   * thread cache, the batch bypasses the magazine and goes to the shared
+   * bucket directly.
+   */
+  void AllocBatch(size_t size, span<void*> ptrs) {
     size_t bucket_idx = BucketforSize(size);
     if (bucket_idx == -1ul) { // no bucket
-      void* addr = resource_vendor_.Alloc(size, align);
-      extern_allocs_[addr] = { size, align };
-      return addr;
-    } else {
-      return bucket_interfaces_[bucket_idx]->AllocSlot();
+      for (void*& ptr : ptrs) ptr = ExternAlloc(size, kBatchAlign);
+      return;
     }
+    unique_lock lock(bucket_mutexes_[bucket_idx], defer_lock);
+    if constexpr (kThreadCached) lock.lock();
+    VisitBucket(bucket_idx, [&](auto& bucket) { bucket.AllocBatch(ptrs); });
   }
-  void RawDealloc(void* ptr, size_t size, align_t align) {
+  /**
+   * Deallocate the objects of `size` bytes in `ptrs`.
+   *
+   * Frees are grouped by their owning block.
+   */
+  void DeallocBatch(span<void* const> ptrs, size_t size) {
     size_t bucket_idx = BucketforSize(size);
     if (bucket_idx == -1ul) { // no bucket
-      resource_vendor_.Dealloc(ptr, size, align);
-      extern_allocs_.erase(ptr);
-    } else {
-      bucket_interfaces_[bucket_idx]->DeallocSlot(ptr);
+      for (void* ptr : ptrs) ExternDealloc(ptr);
+      return;
     }
+    unique_lock lock(bucket_mutexes_[bucket_idx], defer_lock);
+    if constexpr (kThreadCached) lock.lock();
+    VisitBucket(bucket_idx, [&](auto& bucket) { bucket.DeallocBatch(ptrs); });
   }
   template <typename T, typename... Args>
   T* New(Args&&... args) {
@@ -152,57 +303,304 @@ class SLUBPool {
     addr->~T();
     DiscreteDealloc(addr);
   }
+  /**
+   * Acquire every lock of the pool, in the order the pool takes them.
+   *
+   * This is meant for `fork`: a child only has the forking thread, so a lock
+   * held by any other thread would stay locked in it forever. Locking before
+   * the fork and calling `UnlockAll` after it, in both processes, leaves the
+   * child with a consistent, usable pool.
+   */
+  void LockAll() requires (kThreadCached) {
+    RegistryMutex().lock();
+    for (mutex& bucket_mutex : bucket_mutexes_) bucket_mutex.lock();
+  }
+  /**
+   * Release the locks acquired by `LockAll`.
+   */
+  void UnlockAll() requires (kThreadCached) {
+    for (mutex& bucket_mutex : bucket_mutexes_) bucket_mutex.unlock();
+    RegistryMutex().unlock();
+  }
   void Clear() {
+    /* Drop the cached slots, they are released with the buckets. */
+    DropCaches();
     /* Clear the buckets. */
     apply([](auto&... buckets) { (buckets.Clear(), ...); }, buckets_);
     /* Clear external allocations. */
-    for (auto [addr, size_align] : extern_allocs_) {
-      auto [size, align] = size_align;
-      resource_vendor_.Dealloc(addr, size, align);
-    }
-    extern_allocs_.clear();
+    large_allocs_.Clear(resource_vendor_);
   }
 
  private:
+  /**
+   * Per-thread slot cache of a pool.
+   *
+   * Every thread has `kOptions.thread_cache_slots` caches per pool type, and
+   * a pool only uses the cache of its slot. A thread cache is bound to at most
+   * one pool at a time. Binding, unbinding, the intrusive list of caches bound
+   * to a pool and the slot claims are guarded by `RegistryMutex()`.
+   */
+  struct ThreadCache {
+    using Magazine = SLUBMagazine<kThreadCached ? kOptions.magazine_size : 2>;
+
+    atomic<SLUBPool*> pool = nullptr;
+    ThreadCache* prev = nullptr;
+    ThreadCache* next = nullptr;
+    array<Magazine, kSlotSizes.size()> magazines;
+
+    /* Destructor */
+    ~ThreadCache() {
+      /* Later thread exit destructors must not bind this cache again. */
+      Retired() = true;
+      /* Hand the cached slots back when the thread exits. */
+      lock_guard lock(RegistryMutex());
+      if (SLUBPool* owner = pool.load(memory_order_relaxed))
+        owner->Unbind(*this, true);
+    }
+
+    /**
+     * Whether the cache of the calling thread has been destroyed.
+     *
+     * Kept apart from the cache, since stores to an object in its destructor
+     * may be optimized away.
+     */
+    static bool& Retired() {
+      static thread_local constinit bool retired = false;
+      return retired;
+    }
+  };
+
+  /* Constants */
+  /* Alignment of batched objects that do not fit any bucket. */
+  static constexpr align_t kBatchAlign =
+      static_cast<align_t>(alignof(std::max_align_t));
+
   /* Variables */
   ResourceVendor resource_vendor_;
+  /* Shared by the buckets, so declared before them. */
+  HeaderMap header_map_;
+  ClassMap class_map_;
   template <typename Seq>
   struct ArraytoTuple;
   template <size_t... Is>
   struct ArraytoTuple<index_sequence<Is...>> {
     using type = tuple<Bucket<kSlotSizes[Is]>...>;
-    static auto Init(const ResourceVendor& vendor) {
-      return type{ Bucket<kSlotSizes[Is]>(vendor)... };
+    static auto Init(const ResourceVendor& resource_vendor,
+                     const LogicVendor& logic_vendor,
+                     HeaderMap* header_map,
+                     ClassMap* class_map) {
+      return type{ Bucket<kSlotSizes[Is]>(resource_vendor,
+                                          logic_vendor,
+                                          header_map,
+                                          class_map,
+                                          static_cast<uint8_t>(Is + 1))... };
     }
   };
   using Buckets = ArraytoTuple<make_index_sequence<kSlotSizes.size()>>;
+  using Dispatch = SLUBDispatch<typename Buckets::type>;
   Buckets::type buckets_;
-  array<BucketInterface*, kSlotSizes.size()> bucket_interfaces_;
-
-  unordered_map<void*,
-                pair<size_t, align_t>,
-                hash<void*>,
-                equal_to<void*>,
-                VendorAllocator<pair<void* const, pair<size_t, align_t>>,
-                                LogicVendor>>
-      extern_allocs_;
+  /* Guards for the shared state when thread cached. */
+  array<mutex, kSlotSizes.size()> bucket_mutexes_;
+  ThreadCache* caches_ = nullptr;
+  /* Index of the thread caches this pool uses, also claimed by a move. */
+  size_t cache_slot_ = ClaimCacheSlot();
+  /* Needs no lock, see `LargeAllocMap`. */
+  LargeMap large_allocs_;
 
   /* Functions */
-  constexpr size_t BucketforSize(size_t size) {
-    size_t best_fit_idx = -1ul;
-    size_t best_fit_slot_size = numeric_limits<size_t>::max();
-    size_t i = 0;
-    for (auto slot_size : kSlotSizes) {
-      if (size <= slot_size && slot_size < best_fit_slot_size) {
-        best_fit_slot_size = slot_size;
-        best_fit_idx = i;
+  void* ExternAlloc(size_t size, align_t align) {
+    return large_allocs_.Alloc(resource_vendor_, size, align);
+  }
+  void ExternDealloc(void* ptr) {
+    large_allocs_.Dealloc(resource_vendor_, ptr);
+  }
+  static mutex& RegistryMutex() {
+    static mutex registry_mutex;
+    return registry_mutex;
+  }
+  /**
+   * Number of live pools using each thread cache slot.
+   */
+  static auto& CacheSlotUsers() {
+    static array<size_t, kOptions.thread_cache_slots> users{};
+    return users;
+  }
+  /**
+   * Claim the least used thread cache slot.
+   */
+  static size_t ClaimCacheSlot() {
+    size_t slot = 0;
+    if constexpr (kThreadCached) {
+      lock_guard lock(RegistryMutex());
+      auto& users = CacheSlotUsers();
+      for (size_t i = 1; i < users.size(); ++i)
+        if (users[i] < users[slot]) slot = i;
+      ++users[slot];
+    }
+    return slot;
+  }
+  void ReleaseCacheSlot() {
+    if constexpr (kThreadCached) {
+      lock_guard lock(RegistryMutex());
+      --CacheSlotUsers()[cache_slot_];
+    }
+  }
+  /**
+   * Get the cache of the calling thread, bound to this pool.
+   *
+   * @return The cache, **OR** `nullptr` if the thread is exiting and its cache
+   * has already been destroyed.
+   */
+  ThreadCache* LocalCache() {
+    if (ThreadCache::Retired()) [[unlikely]] return nullptr;
+    static thread_local array<ThreadCache, kOptions.thread_cache_slots> caches;
+    ThreadCache& cache = caches[cache_slot_];
+    if (cache.pool.load(memory_order_relaxed) != this) [[unlikely]] {
+      lock_guard lock(RegistryMutex());
+      if (SLUBPool* owner = cache.pool.load(memory_order_relaxed))
+        owner->Unbind(cache, true);
+      Bind(cache);
+    }
+    return &cache;
+  }
+  void* CachedAlloc(size_t bucket_idx) {
+    ThreadCache* cache = LocalCache();
+    if (!cache) [[unlikely]] return SharedAlloc(bucket_idx);
+    auto& magazine = cache->magazines[bucket_idx];
+    if (magazine.Empty()) [[unlikely]] {
+      lock_guard lock(bucket_mutexes_[bucket_idx]);
+      VisitBucket(bucket_idx, [&](auto& bucket) {
+        bucket.AllocBatch(span(magazine.RefillRange(), magazine.kBatch));
+      });
+      magazine.count = magazine.kBatch;
+    }
+    return magazine.Pop();
+  }
+  void CachedDealloc(size_t bucket_idx, void* ptr) {
+    ThreadCache* cache = LocalCache();
+    if (!cache) [[unlikely]] {
+      SharedDealloc(bucket_idx, ptr);
+      return;
+    }
+    auto& magazine = cache->magazines[bucket_idx];
+    if (magazine.Full()) [[unlikely]] {
+      {
+        lock_guard lock(bucket_mutexes_[bucket_idx]);
+        VisitBucket(bucket_idx, [&](auto& bucket) {
+          bucket.DeallocBatch(span(magazine.slots.data(), magazine.kBatch));
+        });
       }
-      i++;
+      magazine.DropFlushed();
+    }
+    magazine.Push(ptr);
+  }
+  /**
+   * Allocate and deallocate at the shared bucket, bypassing the thread cache.
+   */
+  void* SharedAlloc(size_t bucket_idx) {
+    void* ptr;
+    lock_guard lock(bucket_mutexes_[bucket_idx]);
+    VisitBucket(bucket_idx,
+                [&](auto& bucket) { bucket.AllocBatch(span(&ptr, 1)); });
+    return ptr;
+  }
+  void SharedDealloc(size_t bucket_idx, void* ptr) {
+    lock_guard lock(bucket_mutexes_[bucket_idx]);
+    VisitBucket(bucket_idx, [&](auto& bucket) {
+      bucket.DeallocBatch(span<void* const>(&ptr, 1));
+    });
+  }
+  /**
+   * Link a thread cache to this pool.
+   *
+   * The registry mutex must be held.
+   */
+  void Bind(ThreadCache& cache) {
+    cache.prev = nullptr;
+    cache.next = caches_;
+    if (caches_) caches_->prev = &cache;
+    caches_ = &cache;
+    cache.pool.store(this, memory_order_relaxed);
+  }
+  /**
+   * Unlink a thread cache from this pool, optionally returning its slots.
+   *
+   * The registry mutex must be held.
+   */
+  void Unbind(ThreadCache& cache, bool flush) {
+    for (size_t i = 0; i < cache.magazines.size(); ++i) {
+      auto& magazine = cache.magazines[i];
+      if (flush && !magazine.Empty()) {
+        lock_guard lock(bucket_mutexes_[i]);
+        VisitBucket(i, [&](auto& bucket) {
+          bucket.DeallocBatch(span(magazine.slots.data(), magazine.count));
+        });
+      }
+      magazine.count = 0;
+    }
+    if (cache.prev) cache.prev->next = cache.next;
+    else caches_ = cache.next;
+    if (cache.next) cache.next->prev = cache.prev;
+    cache.prev = cache.next = nullptr;
+    cache.pool.store(nullptr, memory_order_relaxed);
+  }
+  /**
+   * Return the slots of all thread caches to the buckets.
+   *
+   * No other thread may be using the pool meanwhile.
+   */
+  void FlushCaches() {
+    if constexpr (kThreadCached) {
+      lock_guard lock(RegistryMutex());
+      while (caches_) Unbind(*caches_, true);
     }
-    return best_fit_idx;
+  }
+  /**
+   * Forget the slots of all thread caches.
+   *
+   * No other thread may be using the pool meanwhile.
+   */
+  void DropCaches() {
+    if constexpr (kThreadCached) {
+      lock_guard lock(RegistryMutex());
+      while (caches_) Unbind(*caches_, false);
+    }
+  }
+  /**
+   * Invoke `f` on the bucket with a runtime index.
+   *
+   * This expands to a switch over the bucket tuple, used by the batched slow
+   * paths.
+   */
+  template <typename F>
+  void VisitBucket(size_t bucket_idx, F&& f) {
+    [&]<size_t... Is>(index_sequence<Is...>) {
+      ((bucket_idx == Is ? (f(get<Is>(buckets_)), true) : false) || ...);
+    }(make_index_sequence<kSlotSizes.size()>{});
+  }
+  /**
+   * Point the buckets at the page maps of this pool after a move.
+   */
+  void BindPageMaps() {
+    apply(
+        [this](auto&... buckets) {
+          (buckets.BindPageMaps(&header_map_, &class_map_), ...);
+        },
+        buckets_);
+  }
+  static constexpr size_t BucketforSize(size_t size) {
+    return SizeClasses::Lookup(size);
+  }
+  static constexpr size_t BucketforSize(size_t size, align_t align) {
+    return SizeClasses::Lookup(size, align);
   }
 };
 static_assert(AnyPool<SLUBPool<4_kB, { 8_B, 2_kB }, Vendor<OSResource>>>);
+static_assert(AnyPool<SLUBPool<4_kB,
+                               { 8_B, 2_kB },
+                               Vendor<OSResource>,
+                               Vendor<OSResource>,
+                               SLUBOptions{ .magazine_size = 32 }>>);
 
 } // namespace crystal::mem
 
@@ -0,0 +1,275 @@
+#ifndef CRYSTALMEM_POOL_STACK_STACK_H_
+#define CRYSTALMEM_POOL_STACK_STACK_H_
+
+#include <CrystalBase/bitwise.h> // lowbit
+
+#include <memory> // std::construct_at
+#include <type_traits> // std::is_same_v
+#include <utility> // std::exchange
+#include <vector> // std::vector
+
+#include "CrystalMem/pool/bump_chain.h" // BumpBlockChain
+#include "CrystalMem/pool/concept.h" // AnyPool
+#include "CrystalMem/pool/large_map.h" // LargeAllocMap
+#include "CrystalMem/resource/os.h" // OSResource
+#include "CrystalMem/type.h" // _kB
+#include "CrystalMem/vendor.h" // Vendor
+#include "CrystalMem/vendor/allocator.h" // VendorAllocator
+#include "CrystalMem/vendor/concept.h" // AnyVendor
+
+namespace crystal::mem {
+
+using std::vector, std::move, std::is_same_v, std::construct_at,
+    std::exchange;
+
+/**
+ * A memory pool for scratch memory that is allocated in strict nesting order.
+ *
+ * Allocating bumps a cursor through a chain of blocks like
+ * `MonotonicArenaPool` (see `BumpBlockChain`). `Mark` takes the position of
+ * the cursor, and `Rewind` moves the cursor back to it, which releases
+ * everything allocated since in constant time however many blocks it spans:
+ * the blocks bumped into since stay in the chain and are bumped through
+ * again. `ScopedFrame` rewinds
+ * at the end of a scope, so that containers using a `DiscreteAllocator` or
+ * `ContinuousAllocator` of the pool can live in the frame. They must be
+ * destroyed before the frame ends.
+ *
+ * Deallocating does nothing, except for the last allocation, which is bumped
+ * back. Marks must be rewound in reverse order of taking them, rewinding to a
+ * mark also drops the marks taken after it.
+ *
+ * Allocations larger than a block go to the resource vendor. Rewinding
+ * releases the ones made since the mark, which is the only part of it that
+ * takes time with the number of allocations. One deallocated on its own is
+ * forgotten right away, in time with the number of large allocations made
+ * after it that are still live.
+ *
+ * @tparam kBlockSize The block size to bump through. Blocks are aligned to
+ * their size.
+ * @tparam ResourceVendor The vendor to request data memory from. Since this
+ * pool doesn't have in-memory optimization, memory obtained from this vendor
+ * will not be operated on.
+ * @tparam LogicVendor The vendor to request memory for allocating logic state.
+ */
+template <size_t kBlockSize,
+          AnyVendor ResourceVendor,
+          AnyVendor LogicVendor = ResourceVendor>
+requires (lowbit(kBlockSize) == kBlockSize)
+class StackPool {
+ public:
+  using Chain = BumpBlockChain<kBlockSize, LogicVendor>;
+  /* Allocations larger or more aligned than a block. */
+  using LargeMap = LargeAllocMap<kBlockSize + 1, LogicVendor>;
+
+  /**
+   * A position of the stack to rewind to.
+   */
+  struct Marker {
+    /* Number of blocks bumped into. */
+    size_t n_blocks;
+    size_t cursor;
+    /* Number of large allocations made, released or not. */
+    size_t n_large;
+  };
+  /**
+   * Rewinds the pool to where it was at construction when going out of scope.
+   */
+  class ScopedFrame {
+   public:
+    explicit ScopedFrame(StackPool& pool) : pool_(pool), mark_(pool.Mark()) {
+    }
+    ScopedFrame(const ScopedFrame&) = delete;
+    ScopedFrame& operator=(const ScopedFrame&) = delete;
+    ~ScopedFrame() {
+      pool_.Rewind(mark_);
+    }
+
+   private:
+    StackPool& pool_;
+    Marker mark_;
+  };
+
+  /* Attributes */
+  static constexpr bool kInMemoryOptimization = false;
+
+  /* Constructor */
+  StackPool(const ResourceVendor& vendor)
+      requires is_same_v<ResourceVendor, LogicVendor>
+      : StackPool(vendor, vendor) {
+  }
+  StackPool(const ResourceVendor& resource_vendor,
+            const LogicVendor& logic_vendor) :
+      resource_vendor_(resource_vendor),
+      chain_(logic_vendor),
+      large_stack_(VendorAllocator<LargeEntry, LogicVendor>(logic_vendor)),
+      large_allocs_(logic_vendor) {
+  }
+  /* No Copying */
+  StackPool(const StackPool&) = delete;
+  /* Move Constructor */
+  StackPool(StackPool&& other) :
+      resource_vendor_(other.resource_vendor_),
+      chain_(move(other.chain_)),
+      large_stack_(move(other.large_stack_)),
+      n_large_(exchange(other.n_large_, 0)),
+      large_allocs_(move(other.large_allocs_)) {
+  }
+  /* No Copying */
+  StackPool& operator=(const StackPool&) = delete;
+  StackPool& operator=(StackPool&& rhs) {
+    Clear();
+    resource_vendor_ = rhs.resource_vendor_;
+    chain_ = move(rhs.chain_);
+    large_stack_ = move(rhs.large_stack_);
+    rhs.large_stack_.clear();
+    n_large_ = exchange(rhs.n_large_, 0);
+    large_allocs_ = move(rhs.large_allocs_);
+    return *this;
+  }
+  /* Destructor */
+  ~StackPool() {
+    Clear();
+  }
+
+  /* Functions */
+  /**
+   * Take the current position of the stack.
+   */
+  Marker Mark() const {
+    auto [n_blocks, cursor] = chain_.Tell();
+    return { n_blocks, cursor, n_large_ };
+  }
+  /**
+   * Release everything allocated since `mark` was taken.
+   */
+  void Rewind(const Marker& mark) {
+    while (!large_stack_.empty() && large_stack_.back().seq >= mark.n_large) {
+      large_allocs_.Dealloc(resource_vendor_, large_stack_.back().ptr);
+      large_stack_.pop_back();
+    }
+    n_large_ = mark.n_large;
+    chain_.Seek({ mark.n_blocks, mark.cursor });
+  }
+  template <typename T>
+  T* DiscreteAlloc() {
+    return reinterpret_cast<T*>(
+        RawAlloc(sizeof(T), static_cast<align_t>(alignof(T))));
+  }
+  template <typename T>
+  void DiscreteDealloc(T* ptr) {
+    RawDealloc(ptr, sizeof(T), static_cast<align_t>(alignof(T)));
+  }
+  template <typename T>
+  T* ContinuousAlloc(size_t n) {
+    return reinterpret_cast<T*>(
+        RawAlloc(sizeof(T) * n, static_cast<align_t>(alignof(T))));
+  }
+  template <typename T>
+  void ContinuousDealloc(T* ptr, size_t n) {
+    RawDealloc(ptr, sizeof(T) * n, static_cast<align_t>(alignof(T)));
+  }
+  /**
+   * Allocate an array of exactly `n` objects, the room after the last array
+   * is only taken by growing it with `TryExpandInPlace`.
+   *
+   * @return The array and `n`.
+   */
+  template <typename T>
+  AllocationResult<T*> ContinuousAllocAtLeast(size_t n) {
+    return { ContinuousAlloc<T>(n), n };
+  }
+  /**
+   * Grow an array from `old_n` to `new_n` objects, which succeeds for the
+   * last allocation while it fits in its block, or within a large allocation.
+   *
+   * @return Whether the array grew, otherwise it is left as is.
+   */
+  template <typename T>
+  bool TryExpandInPlace(T* ptr, size_t old_n, size_t new_n) {
+    constexpr align_t kAlign = static_cast<align_t>(alignof(T));
+    size_t old_size = sizeof(T) * old_n, new_size = sizeof(T) * new_n;
+    if (!Chain::Fits(old_size, kAlign))
+      return new_size <= large_allocs_.Size(ptr);
+    return chain_.TryResize(ptr, old_size, new_size);
+  }
+  /**
+   * Shrink an array from `old_n` to `new_n` objects, `new_n <= old_n`. Only
+   * the tail of the last allocation is reused, like deallocating.
+   *
+   * @return Whether the array shrank, otherwise it keeps its old size, e.g.
+   * when a large allocation would fit in a block.
+   */
+  template <typename T>
+  bool Shrink(T* ptr, size_t old_n, size_t new_n) {
+    constexpr align_t kAlign = static_cast<align_t>(alignof(T));
+    size_t old_size = sizeof(T) * old_n, new_size = sizeof(T) * new_n;
+    if (!Chain::Fits(old_size, kAlign)) return !Chain::Fits(new_size, kAlign);
+    chain_.TryResize(ptr, old_size, new_size);
+    return true;
+  }
+  void* RawAlloc(size_t size, align_t align) {
+    if (!Chain::Fits(size, align)) return LargeAlloc(size, align);
+    return chain_.Alloc(resource_vendor_, size, align);
+  }
+  void RawDealloc(void* ptr, size_t size, align_t align) {
+    if (Chain::Fits(size, align)) {
+      chain_.Dealloc(ptr, size);
+      return;
+    }
+    large_allocs_.Dealloc(resource_vendor_, ptr);
+    /* Forget it, so that rewinding does not release it again. Usually it is
+     * one of the last ones. */
+    for (auto entry = large_stack_.end(); entry != large_stack_.begin();) {
+      if ((--entry)->ptr == ptr) {
+        large_stack_.erase(entry);
+        break;
+      }
+    }
+  }
+  template <typename T, typename ...Args>
+  T* New(Args&&... args) {
+    T* addr = DiscreteAlloc<T>();
+    construct_at(addr, args...);
+    return addr;
+  }
+  template <typename T>
+  void Del(T* ptr) {
+    ptr->~T();
+    DiscreteDealloc(ptr);
+  }
+  void Clear() {
+    chain_.Clear(resource_vendor_, 0);
+    /* Clear external allocations. */
+    large_stack_.clear();
+    n_large_ = 0;
+    large_allocs_.Clear(resource_vendor_);
+  }
+
+ private:
+  /* A live large allocation and how many were made before it. */
+  struct LargeEntry {
+    void* ptr;
+    size_t seq;
+  };
+
+  /* Variables */
+  ResourceVendor resource_vendor_;
+  Chain chain_;
+  /* Live large allocations in the order they were made. */
+  vector<LargeEntry, VendorAllocator<LargeEntry, LogicVendor>> large_stack_;
+  size_t n_large_ = 0;
+  LargeMap large_allocs_;
+
+  /* Functions */
+  void* LargeAlloc(size_t size, align_t align) {
+    void* addr = large_allocs_.Alloc(resource_vendor_, size, align);
+    if (addr) [[likely]] large_stack_.push_back({ addr, n_large_++ });
+    return addr;
+  }
+};
+static_assert(AnyPool<StackPool<4_kB, Vendor<OSResource>>>);
+
+} // namespace crystal::mem
+
+#endif
@@ -0,0 +1,65 @@
+#ifndef CRYSTALMEM_POOL_TLSF_BLOCK_H_
+#define CRYSTALMEM_POOL_TLSF_BLOCK_H_
+
+#include <CrystalBase/bitwise.h> // lowbit
+
+#include <array> // std::array
+
+#include "CrystalMem/type.h" // size_t
+
+namespace crystal::mem {
+
+using std::array;
+
+/**
+ * A range of a block, either free or handed out.
+ *
+ * Segments of a block are linked in address order and together cover the
+ * whole block. Free segments are additionally linked in the free list of
+ * their size class.
+ *
+ * Ownership responsibilities:
+ *  Objects of this class have **NO** memory ownership responsibilities.
+ */
+struct TLSFSegment {
+  size_t addr = 0;
+  size_t size = 0;
+  bool free = false;
+  /* Neighbours in the block. */
+  TLSFSegment* prev_phys = nullptr;
+  TLSFSegment* next_phys = nullptr;
+  /* Neighbours in the free list. */
+  TLSFSegment* prev_free = nullptr;
+  TLSFSegment* next_free = nullptr;
+};
+
+/**
+ * Out of line state of a block: the segment handed out at each granule.
+ *
+ * This is one pointer per `kGranule` bytes of the block, traded for finding
+ * the segment of an address without reading the block itself.
+ *
+ * Ownership responsibilities:
+ *  Objects of this class have **NO** memory ownership responsibilities.
+ */
+template <size_t kSize, size_t kGranule>
+requires (lowbit(kSize) == kSize) // size must be some power of 2
+struct TLSFBlock {
+  /* Constants */
+  static constexpr size_t kNGranules = kSize / kGranule;
+
+  /* Variables */
+  array<TLSFSegment*, kNGranules> used{};
+
+  /* Functions */
+  /**
+   * Get the used segment slot of an address in the block.
+   */
+  TLSFSegment*& Used(size_t addr) {
+    return used[(addr & (kSize - 1)) / kGranule];
+  }
+};
+
+} // namespace crystal::mem
+
+#endif
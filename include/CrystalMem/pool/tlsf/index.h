@@ -0,0 +1,127 @@
+#ifndef CRYSTALMEM_POOL_TLSF_INDEX_H_
+#define CRYSTALMEM_POOL_TLSF_INDEX_H_
+
+#include <CrystalBase/bitwise.h> // lowbit
+
+#include <array> // std::array
+#include <bit> // std::bit_width, std::countr_zero
+#include <cstdint> // uint32_t, uint64_t
+#include <utility> // std::pair
+
+#include "CrystalMem/type.h" // size_t
+#include "block.h" // TLSFSegment
+
+namespace crystal::mem {
+
+using std::array, std::bit_width, std::countr_zero, std::pair;
+
+/**
+ * The two level segregated free lists of a TLSF pool.
+ *
+ * Sizes are split into first level classes by their highest bit, and each of
+ * those into `kSLCount` second level classes. Sizes below
+ * `kSLCount * kGranule` get one class per granule instead. A bitmap per level
+ * tells which lists are non-empty, so inserting, removing and finding a free
+ * segment take a fixed number of steps.
+ *
+ * A segment found for a size is never smaller than the size: the search starts
+ * at the class above the one the size falls in, unless the size is the lower
+ * bound of its class.
+ *
+ * @tparam kGranule The granularity of segment sizes.
+ * @tparam kMaxSize The largest segment size.
+ */
+template <size_t kGranule, size_t kMaxSize>
+requires (lowbit(kGranule) == kGranule) // granule must be some power of 2
+class TLSFIndex {
+ public:
+  /* Constants */
+  static constexpr size_t kSLBits = 4;
+  static constexpr size_t kSLCount = size_t{ 1 } << kSLBits;
+  static constexpr size_t kFLShift = kSLBits + countr_zero(kGranule);
+  static constexpr size_t kSmallSize = size_t{ 1 } << kFLShift;
+  static constexpr size_t kFLCount =
+      kMaxSize < kSmallSize ? 1 : bit_width(kMaxSize) - kFLShift + 1;
+  static_assert(kFLCount <= 64, "Too many first level classes.");
+
+  /* Functions */
+  /**
+   * Add a free segment to the list of its size class.
+   */
+  void Insert(TLSFSegment* segment) {
+    auto [fl, sl] = Mapping(segment->size);
+    TLSFSegment*& head = heads_[fl][sl];
+    segment->prev_free = nullptr;
+    segment->next_free = head;
+    if (head) head->prev_free = segment;
+    head = segment;
+    fl_bitmap_ |= uint64_t{ 1 } << fl;
+    sl_bitmaps_[fl] |= uint32_t{ 1 } << sl;
+  }
+  /**
+   * Take a free segment out of the list of its size class.
+   */
+  void Remove(TLSFSegment* segment) {
+    auto [fl, sl] = Mapping(segment->size);
+    if (segment->next_free) segment->next_free->prev_free = segment->prev_free;
+    if (segment->prev_free) segment->prev_free->next_free = segment->next_free;
+    else {
+      heads_[fl][sl] = segment->next_free;
+      if (!heads_[fl][sl]) {
+        sl_bitmaps_[fl] &= ~(uint32_t{ 1 } << sl);
+        if (!sl_bitmaps_[fl]) fl_bitmap_ &= ~(uint64_t{ 1 } << fl);
+      }
+    }
+    segment->prev_free = segment->next_free = nullptr;
+  }
+  /**
+   * Find a free segment of at least `size` bytes, it stays in its list.
+   * `size` must be a multiple of `kGranule`.
+   *
+   * @return The segment, **OR** `nullptr` if there is none.
+   */
+  TLSFSegment* Find(size_t size) const {
+    if (size >= kSmallSize)
+      size += (size_t{ 1 } << (bit_width(size) - 1 - kSLBits)) - 1;
+    auto [fl, sl] = Mapping(size);
+    if (fl >= kFLCount) return nullptr;
+    uint32_t sl_map = sl_bitmaps_[fl] & (~uint32_t{ 0 } << sl);
+    if (!sl_map) {
+      uint64_t fl_map =
+          fl + 1 < 64 ? fl_bitmap_ & (~uint64_t{ 0 } << (fl + 1)) : 0;
+      if (!fl_map) return nullptr;
+      fl = countr_zero(fl_map);
+      sl_map = sl_bitmaps_[fl];
+    }
+    return heads_[fl][countr_zero(sl_map)];
+  }
+  /**
+   * Forget every free segment.
+   */
+  void Reset() {
+    fl_bitmap_ = 0;
+    sl_bitmaps_.fill(0);
+    for (auto& lists : heads_) lists.fill(nullptr);
+  }
+
+ private:
+  /* Variables */
+  uint64_t fl_bitmap_ = 0;
+  array<uint32_t, kFLCount> sl_bitmaps_{};
+  array<array<TLSFSegment*, kSLCount>, kFLCount> heads_{};
+
+  /* Functions */
+  /**
+   * Get the first and second level class of a size.
+   */
+  static constexpr pair<size_t, size_t> Mapping(size_t size) {
+    if (size < kSmallSize) return { 0, size / kGranule };
+    size_t fl = bit_width(size) - 1;
+    size_t sl = (size >> (fl - kSLBits)) ^ kSLCount;
+    return { fl - kFLShift + 1, sl };
+  }
+};
+
+} // namespace crystal::mem
+
+#endif
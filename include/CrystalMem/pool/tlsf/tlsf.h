@@ -0,0 +1,374 @@
+#ifndef CRYSTALMEM_POOL_TLSF_TLSF_H_
+#define CRYSTALMEM_POOL_TLSF_TLSF_H_
+
+#include <array> // std::array
+#include <memory> // std::construct_at
+#include <type_traits> // std::is_same_v
+#include <utility> // std::exchange
+
+#include "CrystalMem/pool/concept.h" // AnyPool
+#include "CrystalMem/pool/large_map.h" // LargeAllocMap
+#include "CrystalMem/pool/page_map.h" // PageMap
+#include "CrystalMem/resource/os.h" // OSResource
+#include "CrystalMem/type.h" // _kB
+#include "CrystalMem/vendor.h" // Vendor
+#include "CrystalMem/vendor/concept.h" // AnyVendor
+#include "block.h" // TLSFBlock, TLSFSegment
+#include "index.h" // TLSFIndex
+
+namespace crystal::mem {
+
+using std::array, std::move, std::is_same_v, std::construct_at, std::exchange;
+
+/**
+ * A memory pool that implements the two level segregated fit strategy.
+ *
+ * Blocks are split into segments that are handed out and merged back with
+ * their free neighbours right away. Free segments are kept in segregated
+ * lists found through bitmaps (see `TLSFIndex`), so allocating and
+ * deallocating within the blocks take a bounded number of steps no matter how
+ * fragmented the pool is. Only requesting a new block from the vendor is
+ * unbounded.
+ *
+ * Every segment, free list and lookup table lives in logic memory, the blocks
+ * themselves are never read or written.
+ *
+ * @tparam kBlockSize The block size the strategy operates on. Blocks are
+ * aligned to their size.
+ * @tparam ResourceVendor The vendor to request data memory from. Since this
+ * pool doesn't have in-memory optimization, memory obtained from this vendor
+ * will not be operated on.
+ * @tparam LogicVendor The vendor to request memory for allocating logic state.
+ */
+template <size_t kBlockSize,
+          AnyVendor ResourceVendor,
+          AnyVendor LogicVendor = ResourceVendor>
+class TLSFPool {
+ public:
+  /* Constants */
+  /* Granularity of segment sizes and addresses. */
+  static constexpr size_t kGranule = 16;
+  static_assert(kBlockSize >= kGranule, "Block size too small.");
+
+  using Block = TLSFBlock<kBlockSize, kGranule>;
+  using Index = TLSFIndex<kGranule, kBlockSize>;
+  /* Allocations larger or more aligned than a block. */
+  using LargeMap = LargeAllocMap<kBlockSize + 1, LogicVendor>;
+
+  /* Attributes */
+  static constexpr bool kInMemoryOptimization = false;
+
+  /* Constructor */
+  TLSFPool(const ResourceVendor& vendor)
+      requires is_same_v<ResourceVendor, LogicVendor>
+      : TLSFPool(vendor, vendor) {
+  }
+  TLSFPool(const ResourceVendor& resource_vendor,
+           const LogicVendor& logic_vendor) :
+      resource_vendor_(resource_vendor),
+      logic_vendor_(logic_vendor),
+      blocks_(logic_vendor),
+      large_allocs_(logic_vendor) {
+  }
+  /* No Copying */
+  TLSFPool(const TLSFPool&) = delete;
+  /* Move Constructor */
+  TLSFPool(TLSFPool&& other) :
+      resource_vendor_(other.resource_vendor_),
+      logic_vendor_(other.logic_vendor_),
+      index_(exchange(other.index_, Index{})),
+      blocks_(move(other.blocks_)),
+      chunks_(exchange(other.chunks_, nullptr)),
+      spare_segments_(exchange(other.spare_segments_, nullptr)),
+      large_allocs_(move(other.large_allocs_)) {
+  }
+  /* No Copying */
+  TLSFPool& operator=(const TLSFPool&) = delete;
+  TLSFPool& operator=(TLSFPool&& rhs) {
+    Clear();
+    resource_vendor_ = rhs.resource_vendor_;
+    logic_vendor_ = rhs.logic_vendor_;
+    index_ = exchange(rhs.index_, Index{});
+    blocks_ = move(rhs.blocks_);
+    chunks_ = exchange(rhs.chunks_, nullptr);
+    spare_segments_ = exchange(rhs.spare_segments_, nullptr);
+    large_allocs_ = move(rhs.large_allocs_);
+    return *this;
+  }
+  /* Destructor */
+  ~TLSFPool() {
+    Clear();
+  }
+
+  /* Functions */
+  template <typename T>
+  T* DiscreteAlloc() {
+    return reinterpret_cast<T*>(
+        RawAlloc(sizeof(T), static_cast<align_t>(alignof(T))));
+  }
+  template <typename T>
+  void DiscreteDealloc(T* ptr) {
+    RawDealloc(ptr, sizeof(T), static_cast<align_t>(alignof(T)));
+  }
+  template <typename T>
+  T* ContinuousAlloc(size_t n) {
+    return reinterpret_cast<T*>(
+        RawAlloc(sizeof(T) * n, static_cast<align_t>(alignof(T))));
+  }
+  template <typename T>
+  void ContinuousDealloc(T* ptr, size_t n) {
+    RawDealloc(ptr, sizeof(T) * n, static_cast<align_t>(alignof(T)));
+  }
+  /**
+   * Allocate an array of at least `n` objects, which holds as many objects as
+   * fit in its segment.
+   *
+   * @return The array and the number of objects it holds.
+   */
+  template <typename T>
+  AllocationResult<T*> ContinuousAllocAtLeast(size_t n) {
+    constexpr align_t kAlign = static_cast<align_t>(alignof(T));
+    T* ptr = ContinuousAlloc<T>(n);
+    if (!ptr || IsLarge(sizeof(T) * n, kAlign)) return { ptr, n };
+    size_t addr = reinterpret_cast<size_t>(ptr);
+    return { ptr, blocks_.Get(ptr)->Used(addr)->size / sizeof(T) };
+  }
+  /**
+   * Grow an array from `old_n` to `new_n` objects by taking the start of the
+   * free segment right after it, or within a large allocation.
+   *
+   * @return Whether the array grew, otherwise it is left as is.
+   */
+  template <typename T>
+  bool TryExpandInPlace(T* ptr, size_t old_n, size_t new_n) {
+    constexpr align_t kAlign = static_cast<align_t>(alignof(T));
+    size_t old_size = sizeof(T) * old_n, new_size = sizeof(T) * new_n;
+    if (IsLarge(old_size, kAlign)) return new_size <= large_allocs_.Size(ptr);
+    if (IsLarge(new_size, kAlign)) return false;
+    new_size = RoundSize(new_size);
+    TLSFSegment* segment =
+        blocks_.Get(ptr)->Used(reinterpret_cast<size_t>(ptr));
+    if (new_size <= segment->size) return true;
+    TLSFSegment* next = segment->next_phys;
+    if (!next || !next->free || segment->size + next->size < new_size)
+      return false;
+    index_.Remove(next);
+    if (segment->size + next->size > new_size)
+      index_.Insert(Split(next, new_size - segment->size)->next_phys);
+    segment->size += next->size;
+    Unlink(next);
+    return true;
+  }
+  /**
+   * Shrink an array from `old_n` to `new_n` objects, `new_n <= old_n`,
+   * splitting its tail off as a free segment.
+   *
+   * @return Whether the array shrank, otherwise it keeps its old size, e.g.
+   * when a large allocation would fit in a block.
+   */
+  template <typename T>
+  bool Shrink(T* ptr, size_t old_n, size_t new_n) {
+    constexpr align_t kAlign = static_cast<align_t>(alignof(T));
+    size_t old_size = sizeof(T) * old_n, new_size = sizeof(T) * new_n;
+    if (IsLarge(old_size, kAlign)) return IsLarge(new_size, kAlign);
+    new_size = RoundSize(new_size);
+    TLSFSegment* segment =
+        blocks_.Get(ptr)->Used(reinterpret_cast<size_t>(ptr));
+    if (new_size == segment->size) return true;
+    TLSFSegment* tail = Split(segment, new_size)->next_phys;
+    tail->free = true;
+    if (TLSFSegment* next = tail->next_phys; next && next->free) {
+      index_.Remove(next);
+      tail->size += next->size;
+      Unlink(next);
+    }
+    index_.Insert(tail);
+    return true;
+  }
+  void* RawAlloc(size_t size, align_t align) {
+    if (IsLarge(size, align))
+      return large_allocs_.Alloc(resource_vendor_, size, align);
+    size = RoundSize(size);
+    size_t alignment = static_cast<size_t>(align);
+    if (alignment < kGranule) alignment = kGranule;
+    /* Leave room to align within any segment that is found. */
+    TLSFSegment* segment = index_.Find(size + alignment - kGranule);
+    if (segment) index_.Remove(segment);
+    else if (!(segment = AppendBlock())) [[unlikely]] return nullptr;
+    return Carve(segment, size, alignment);
+  }
+  void RawDealloc(void* ptr, size_t size, align_t align) {
+    if (IsLarge(size, align)) {
+      large_allocs_.Dealloc(resource_vendor_, ptr);
+      return;
+    }
+    size_t addr = reinterpret_cast<size_t>(ptr);
+    Block* block = blocks_.Get(ptr);
+    TLSFSegment* segment = exchange(block->Used(addr), nullptr);
+    segment->free = true;
+    /* Merge with the free neighbours. */
+    if (TLSFSegment* next = segment->next_phys; next && next->free) {
+      index_.Remove(next);
+      segment->size += next->size;
+      Unlink(next);
+    }
+    if (TLSFSegment* prev = segment->prev_phys; prev && prev->free) {
+      index_.Remove(prev);
+      prev->size += segment->size;
+      Unlink(segment);
+      segment = prev;
+    }
+    index_.Insert(segment);
+  }
+  template <typename T, typename ...Args>
+  T* New(Args&&... args) {
+    T* addr = DiscreteAlloc<T>();
+    construct_at(addr, args...);
+    return addr;
+  }
+  template <typename T>
+  void Del(T* ptr) {
+    ptr->~T();
+    DiscreteDealloc(ptr);
+  }
+  void Clear() {
+    /* Release the blocks and their lookup tables. */
+    blocks_.ForEach([this](void* addr, Block* block) {
+      resource_vendor_.Dealloc(
+          addr, kBlockSize, static_cast<align_t>(kBlockSize));
+      block->~Block();
+      logic_vendor_.Dealloc(
+          block, sizeof(Block), static_cast<align_t>(alignof(Block)));
+    });
+    blocks_.Clear();
+    /* Release the segments. */
+    while (chunks_) {
+      SegmentChunk* next = chunks_->next;
+      logic_vendor_.Dealloc(chunks_,
+                            sizeof(SegmentChunk),
+                            static_cast<align_t>(alignof(SegmentChunk)));
+      chunks_ = next;
+    }
+    spare_segments_ = nullptr;
+    index_.Reset();
+    /* Clear external allocations. */
+    large_allocs_.Clear(resource_vendor_);
+  }
+
+ private:
+  /* Segments requested from the logic vendor at once. */
+  static constexpr size_t kChunkSegments = 64;
+  struct SegmentChunk {
+    SegmentChunk* next;
+    array<TLSFSegment, kChunkSegments> segments;
+  };
+
+  /* Variables */
+  ResourceVendor resource_vendor_;
+  LogicVendor logic_vendor_;
+  Index index_;
+  PageMap<kBlockSize, Block*, LogicVendor> blocks_;
+  SegmentChunk* chunks_ = nullptr;
+  /* Unused segments, linked through `next_free`. */
+  TLSFSegment* spare_segments_ = nullptr;
+  LargeMap large_allocs_;
+
+  /* Functions */
+  static constexpr bool IsLarge(size_t size, align_t align) {
+    return size > kBlockSize || static_cast<size_t>(align) > kBlockSize;
+  }
+  /**
+   * Get the size of the segment handed out for `size` bytes.
+   */
+  static constexpr size_t RoundSize(size_t size) {
+    return size ? (size + kGranule - 1) & ~(kGranule - 1) : kGranule;
+  }
+  /**
+   * Hand out `size` bytes aligned to `align` from a free segment that is out
+   * of the index, the rest of it is split off and put back.
+   */
+  void* Carve(TLSFSegment* segment, size_t size, size_t align) {
+    size_t aligned = (segment->addr + align - 1) & ~(align - 1);
+    if (size_t l_padding = aligned - segment->addr) {
+      index_.Insert(Split(segment, l_padding));
+      /* The padding stays in front, continue with the rest. */
+      segment = segment->next_phys;
+    }
+    if (segment->size > size) index_.Insert(Split(segment, size)->next_phys);
+    segment->free = false;
+    blocks_.Get(reinterpret_cast<void*>(aligned))->Used(aligned) = segment;
+    return reinterpret_cast<void*>(aligned);
+  }
+  /**
+   * Cut a segment after its first `size` bytes, both parts stay as free as
+   * the segment was.
+   *
+   * @return The first part, which is `segment` itself.
+   */
+  TLSFSegment* Split(TLSFSegment* segment, size_t size) {
+    TLSFSegment* rest = NewSegment();
+    rest->addr = segment->addr + size;
+    rest->size = segment->size - size;
+    rest->free = segment->free;
+    rest->prev_phys = segment;
+    rest->next_phys = segment->next_phys;
+    if (rest->next_phys) rest->next_phys->prev_phys = rest;
+    segment->next_phys = rest;
+    segment->size = size;
+    return segment;
+  }
+  /**
+   * Drop a segment that was merged into its previous neighbour.
+   */
+  void Unlink(TLSFSegment* segment) {
+    segment->prev_phys->next_phys = segment->next_phys;
+    if (segment->next_phys) segment->next_phys->prev_phys = segment->prev_phys;
+    segment->next_free = spare_segments_;
+    spare_segments_ = segment;
+  }
+  /**
+   * Get an unused segment, requesting a chunk of them if there is none.
+   */
+  TLSFSegment* NewSegment() {
+    if (!spare_segments_) [[unlikely]] {
+      SegmentChunk* chunk = construct_at(
+          reinterpret_cast<SegmentChunk*>(logic_vendor_.Alloc(
+              sizeof(SegmentChunk),
+              static_cast<align_t>(alignof(SegmentChunk)))),
+          SegmentChunk{ .next = chunks_, .segments = {} });
+      chunks_ = chunk;
+      for (TLSFSegment& segment : chunk->segments) {
+        segment.next_free = spare_segments_;
+        spare_segments_ = &segment;
+      }
+    }
+    TLSFSegment* segment =
+        exchange(spare_segments_, spare_segments_->next_free);
+    *segment = TLSFSegment{};
+    return segment;
+  }
+  /**
+   * Request a new block from the vendor.
+   *
+   * @return A free segment covering the block, out of the index, **OR**
+   * `nullptr` if the vendor failed.
+   */
+  TLSFSegment* AppendBlock() {
+    void* addr = resource_vendor_.Alloc(
+        kBlockSize, static_cast<align_t>(kBlockSize));
+    if (!addr) [[unlikely]] return nullptr;
+    Block* block = construct_at(reinterpret_cast<Block*>(logic_vendor_.Alloc(
+        sizeof(Block), static_cast<align_t>(alignof(Block)))));
+    blocks_.Set(addr, 1, block);
+    TLSFSegment* segment = NewSegment();
+    segment->addr = reinterpret_cast<size_t>(addr);
+    segment->size = kBlockSize;
+    segment->free = true;
+    return segment;
+  }
+};
+static_assert(AnyPool<TLSFPool<4_kB, Vendor<OSResource>>>);
+
+} // namespace crystal::mem
+
+#endif
@@ -0,0 +1,83 @@
+#ifndef CRYSTALMEM_RESOURCE_MMAP_H_
+#define CRYSTALMEM_RESOURCE_MMAP_H_
+
+#include <sys/mman.h> // mmap, munmap
+
+#include <expected> // std::expected
+#include <string> // std::string
+
+#include "../global.h" // kPageSize
+#include "../type.h" // align_t
+#include "concept.h" // Resource
+
+namespace crystal::mem {
+
+/**
+ * A resource that maps memory directly from the operating system with `mmap`.
+ *
+ * Unlike `OSResource`, this never goes through `malloc` or `operator new`, so
+ * it can back a replacement of them. Sizes are rounded up to whole pages, and
+ * alignments above a page are obtained by mapping the excess and unmapping it
+ * again around the aligned range.
+ *
+ * This resource is only available on POSIX systems.
+ */
+class MMapResource {
+ public:
+  /* Constructor */
+  constexpr MMapResource() = default;
+  MMapResource(const MMapResource& other) = delete; // no copying
+  MMapResource(MMapResource&& other) = default;
+  MMapResource& operator=(const MMapResource& other) = delete; // no copying
+
+  /* Functions */
+  std::expected<void, std::string> Close() {
+    alive_ = false;
+    return {};
+  }
+  operator bool() {
+    return alive_;
+  }
+  /**
+   * @return The mapped memory, **OR** `nullptr` if the mapping failed.
+   */
+  void* Alloc(size_t size, align_t align) {
+    size_t length = PageRound(size);
+    size_t alignment = static_cast<size_t>(align);
+    if (alignment <= kPageSize) return Map(length);
+    /* Map enough to contain an aligned range and trim the rest. */
+    char* base = static_cast<char*>(Map(length + alignment - kPageSize));
+    if (!base) return nullptr;
+    size_t addr = reinterpret_cast<size_t>(base);
+    char* aligned = base + ((alignment - addr % alignment) % alignment);
+    char* end = base + length + alignment - kPageSize;
+    if (aligned != base) munmap(base, aligned - base);
+    if (aligned + length != end)
+      munmap(aligned + length, end - aligned - length);
+    return aligned;
+  }
+  void Dealloc(void* ptr, size_t size, align_t) {
+    munmap(ptr, PageRound(size));
+  }
+
+ private:
+  bool alive_ = true;
+
+  static constexpr size_t PageRound(size_t size) {
+    return (size + kPageSize - 1) & ~(kPageSize - 1);
+  }
+  static void* Map(size_t length) {
+    void* ptr = mmap(nullptr,
+                     length,
+                     PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS,
+                     -1,
+                     0);
+    return ptr == MAP_FAILED ? nullptr : ptr;
+  }
+};
+static_assert(AnyResource<MMapResource>);
+
+} // namespace crystal::mem
+
+#endif
@@ -0,0 +1,125 @@
+#ifndef CRYSTALMEM_STRATEGY_H_
+#define CRYSTALMEM_STRATEGY_H_
+
+#include <CrystalBase/integer_sequence.h> // integer_sequence
+
+#include <type_traits> // std::type_identity
+
+#include "CrystalMem/allocator/continuous_allocator.h" // ContinuousAllocator
+#include "CrystalMem/option.h" // Opts, Characteristic
+#include "CrystalMem/resource/os.h" // OSResource
+#include "CrystalMem/type.h" // _kB
+#include "CrystalMem/vendor.h" // Vendor
+#include "CrystalMem/vendor/concept.h" // AnyVendor
+#include "pool/monotonic_arena/monotonic_arena.h" // MonotonicArenaPool
+#include "pool/safe_best_fit/safe_best_fit.h" // SafeBestFitPool
+#include "pool/slub/slub.h" // SLUBPool
+#include "pool/stack/stack.h" // StackPool
+#include "pool/tlsf/tlsf.h" // TLSFPool
+
+namespace crystal::mem {
+
+using std::type_identity;
+
+/**
+ * Slot sizes of power of 2 size classes up to a size category of at most
+ * 2 kB.
+ */
+template <SizeCa kSize>
+consteval auto StrategySlotSizes() {
+  if constexpr (kSize <= SizeCa::_8B) return integer_sequence{ 8_B };
+  else if constexpr (kSize == SizeCa::_16B)
+    return integer_sequence{ 8_B, 16_B };
+  else if constexpr (kSize == SizeCa::_32B)
+    return integer_sequence{ 8_B, 16_B, 32_B };
+  else if constexpr (kSize == SizeCa::_64B)
+    return integer_sequence{ 8_B, 16_B, 32_B, 64_B };
+  else if constexpr (kSize == SizeCa::_128B)
+    return integer_sequence{ 8_B, 16_B, 32_B, 64_B, 128_B };
+  else if constexpr (kSize == SizeCa::_256B)
+    return integer_sequence{ 8_B, 16_B, 32_B, 64_B, 128_B, 256_B };
+  else if constexpr (kSize == SizeCa::_512B)
+    return integer_sequence{ 8_B, 16_B, 32_B, 64_B, 128_B, 256_B, 512_B };
+  else if constexpr (kSize == SizeCa::_1kB)
+    return integer_sequence{
+      8_B, 16_B, 32_B, 64_B, 128_B, 256_B, 512_B, 1_kB
+    };
+  else
+    return integer_sequence{
+      8_B, 16_B, 32_B, 64_B, 128_B, 256_B, 512_B, 1_kB, 2_kB
+    };
+}
+
+/**
+ * Pick the pool for an `Opts`, see `Strategy`.
+ *
+ * @return The pool type, wrapped in a `type_identity`.
+ */
+template <typename O, AnyVendor V>
+consteval auto StrategyPool() {
+  if constexpr (O::kLongevity == LongevityCa::Instant
+                || O::kLongevity == LongevityCa::Eternal)
+    return type_identity<MonotonicArenaPool<64_kB, V>>{};
+  else if constexpr (O::kLongevity == LongevityCa::Tmp)
+    return type_identity<StackPool<64_kB, V>>{};
+  else if constexpr (O::kExpansion >= ExpansionCa::x64
+                     || (O::kSize >= SizeCa::Large
+                         && O::kExpansion != ExpansionCa::None))
+    return type_identity<SafeBestFitPool<64_kB, V>>{};
+  else if constexpr (O::kSize <= SizeCa::_2kB)
+    return type_identity<SLUBPool<4_kB,
+                                  StrategySlotSizes<O::kSize>(),
+                                  V,
+                                  V,
+                                  SLUBOptions{ .min_slots_per_block = 8 }>>{};
+  else return type_identity<TLSFPool<64_kB, V>>{};
+}
+
+/**
+ * The resource, pool and allocator that suit an `Opts`, picked at compile
+ * time so that a call site pays nothing for choosing.
+ *
+ * By longevity first, since it decides how memory is reclaimed:
+ *  * `Instant` and `Eternal` objects go to a `MonotonicArenaPool`, which never
+ *    manages single objects: they either die together or never.
+ *  * `Tmp` objects go to a `StackPool`, to be rewound with their frame.
+ *  * `Regular` and `Long` objects go to a `SafeBestFitPool` when they expand
+ *    a lot or are large and expand at all, so that arrays grow in place. Up
+ *    to 2 kB they go to a `SLUBPool` with power of 2 size classes up to their
+ *    size, anything else to a `TLSFPool`.
+ *
+ * Only `Source::OS` has a resource so far.
+ *
+ * @tparam O The `Opts` to pick for.
+ */
+template <typename O>
+struct Strategy {
+  static_assert(O::kSource == Source::OS, "No resource for this source yet.");
+
+  using Resource = OSResource;
+  using Vendor = crystal::mem::Vendor<Resource>;
+  using Pool = typename decltype(StrategyPool<O, Vendor>())::type;
+  template <typename T>
+  using Allocator = ContinuousAllocator<T, Pool>;
+
+  Strategy() = delete;
+  ~Strategy() = delete;
+};
+
+/* Predefined Strategies */
+/** No management, objects live until the pool is gone. */
+using StaticStorage =
+    Strategy<Opts<Source::OS, Characteristic<LongevityCa::Eternal>>>;
+/** Stable management of long lived objects. */
+using LongTermStorage =
+    Strategy<Opts<Source::OS, Characteristic<LongevityCa::Long>>>;
+/** Aggressive management of scratch memory, reclaimed by frame. */
+using TemporaryStorage =
+    Strategy<Opts<Source::OS, Characteristic<LongevityCa::Tmp>>>;
+using sts = StaticStorage;
+using lts = LongTermStorage;
+using tps = TemporaryStorage;
+
+} // namespace crystal::mem
+
+#endif
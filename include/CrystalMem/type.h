@@ -3,6 +3,7 @@
 
 #include <cstdint> // uint32_t
 
+#include <memory> // std::allocation_result
 #include <new> // std::align_val_t
 
 namespace crystal::mem {
@@ -11,6 +12,21 @@ using size_t = std::size_t;
 using ssize_t = uint32_t;
 using align_t = std::align_val_t;
 
+/**
+ * The result of allocating at least some number of objects, `count` is the
+ * number of objects that actually fit.
+ */
+#ifdef __cpp_lib_allocate_at_least
+template <typename Pointer>
+using AllocationResult = std::allocation_result<Pointer, size_t>;
+#else
+template <typename Pointer>
+struct AllocationResult {
+  Pointer ptr;
+  size_t count;
+};
+#endif
+
 constexpr size_t operator""_B(unsigned long long n_bytes) {
   return n_bytes;
 }
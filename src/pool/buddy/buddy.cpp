@@ -0,0 +1 @@
+#include "CrystalMem/pool/buddy/buddy.h"
\ No newline at end of file
@@ -0,0 +1 @@
+#include "CrystalMem/pool/monotonic_arena/monotonic_arena.h"
@@ -0,0 +1 @@
+#include "CrystalMem/pool/stack/stack.h"
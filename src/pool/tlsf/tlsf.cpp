@@ -0,0 +1 @@
+#include "CrystalMem/pool/tlsf/tlsf.h"
\ No newline at end of file
@@ -0,0 +1,449 @@
+/**
+ * A drop-in replacement of the C and C++ allocation functions, to be loaded
+ * with `LD_PRELOAD`.
+ *
+ * Everything is served by one process wide, thread cached `SLUBPool` over
+ * memory mapped with `MMapResource`. Objects up to 64 kB are rounded up to a
+ * size class, larger ones are mapped individually, and `free` finds either
+ * from the address alone.
+ *
+ * The pool is created on the first allocation and is never destroyed, since
+ * objects may still be freed after static destructors ran. All its locks are
+ * held across `fork`, so that the child process can keep allocating.
+ */
+#include <errno.h> // errno, EINVAL, ENOMEM
+#include <pthread.h> // pthread_atfork
+
+#include <array> // std::array
+#include <atomic> // std::atomic_flag
+#include <bit> // std::bit_floor
+#include <cstddef> // std::byte, std::max_align_t
+#include <cstdint> // PTRDIFF_MAX
+#include <expected> // std::expected
+#include <string> // std::string
+#include <cstring> // std::memcpy, std::memset
+#include <new> // std::bad_alloc, std::nothrow_t
+
+#include "CrystalMem/global.h" // kPageSize
+#include "CrystalMem/pool/slub/slub.h" // SLUBPool
+#include "CrystalMem/resource/mmap.h" // MMapResource
+#include "CrystalMem/type.h" // _kB
+#include "CrystalMem/vendor.h" // Vendor
+
+namespace crystal::mem::preload {
+namespace {
+
+using std::array, std::atomic_flag, std::bit_floor, std::byte, std::expected,
+    std::max_align_t, std::memory_order_acquire, std::memory_order_release,
+    std::string;
+
+/**
+ * An `MMapResource` that keeps a few freed mappings for reuse, so that large
+ * objects freed and allocated again in a loop are not unmapped and faulted in
+ * every time.
+ *
+ * Only page aligned mappings of at most `kMaxRetainedSize` bytes are kept, and
+ * a kept mapping is only reused for the same page rounded size, which is why
+ * large sizes are rounded with `LargeSize` first.
+ */
+class RetainingMMapResource {
+ public:
+  static constexpr size_t kRetainedCount = 64;
+  static constexpr size_t kMaxRetainedSize = 1024_kB;
+
+  /* Functions */
+  expected<void, string> Close() {
+    return {};
+  }
+  operator bool() {
+    return true;
+  }
+  void* Alloc(size_t size, align_t align) {
+    size_t length = PageRound(size);
+    if (Retainable(length, align)) {
+      void* ptr = nullptr;
+      Lock();
+      for (size_t i = 0; i < count_; ++i) {
+        if (retained_[i].length != length) continue;
+        ptr = retained_[i].ptr;
+        retained_[i] = retained_[--count_];
+        break;
+      }
+      Unlock();
+      if (ptr) return ptr;
+    }
+    return resource_.Alloc(size, align);
+  }
+  void Dealloc(void* ptr, size_t size, align_t align) {
+    size_t length = PageRound(size);
+    if (Retainable(length, align)) {
+      Lock();
+      bool retained = count_ < kRetainedCount;
+      if (retained) retained_[count_++] = Mapping{ ptr, length };
+      Unlock();
+      if (retained) return;
+    }
+    resource_.Dealloc(ptr, size, align);
+  }
+  void Lock() {
+    while (lock_.test_and_set(memory_order_acquire)) {}
+  }
+  void Unlock() {
+    lock_.clear(memory_order_release);
+  }
+
+ private:
+  struct Mapping {
+    void* ptr;
+    size_t length;
+  };
+
+  /* Variables */
+  MMapResource resource_;
+  atomic_flag lock_;
+  array<Mapping, kRetainedCount> retained_{};
+  size_t count_ = 0;
+
+  /* Functions */
+  static constexpr size_t PageRound(size_t size) {
+    return (size + kPageSize - 1) & ~(kPageSize - 1);
+  }
+  static constexpr bool Retainable(size_t length, align_t align) {
+    return length <= kMaxRetainedSize
+        && static_cast<size_t>(align) <= kPageSize;
+  }
+};
+
+/* Multiples of 16 up to 128 bytes, then 4 classes per doubling. */
+using Pool = SLUBPool<16_kB,
+                      { 16_B, 32_B, 48_B, 64_B, 80_B, 96_B, 112_B, 128_B,
+                        160_B, 192_B, 224_B, 256_B,
+                        320_B, 384_B, 448_B, 512_B,
+                        640_B, 768_B, 896_B, 1_kB,
+                        1280_B, 1536_B, 1792_B, 2_kB,
+                        2560_B, 3_kB, 3584_B, 4_kB,
+                        5_kB, 6_kB, 7_kB, 8_kB,
+                        10_kB, 12_kB, 14_kB, 16_kB,
+                        20_kB, 24_kB, 28_kB, 32_kB,
+                        40_kB, 48_kB, 56_kB, 64_kB },
+                      Vendor<RetainingMMapResource>,
+                      Vendor<RetainingMMapResource>,
+                      SLUBOptions{ .magazine_size = 64,
+                                   .thread_cache_slots = 1,
+                                   .empty_block_retention = 2,
+                                   .min_slots_per_block = 8,
+                                   .size_free_dealloc = true }>;
+constexpr size_t kMinAlign = alignof(max_align_t);
+constexpr size_t kMaxClassSize = 64_kB;
+/* Larger sizes fail, as in the C library, so rounding them cannot wrap. */
+constexpr size_t kMaxSize = static_cast<size_t>(PTRDIFF_MAX);
+
+/**
+ * Round a size past the size classes up to 4 steps per doubling, so that
+ * similar large sizes map the same number of pages and retained mappings are
+ * reused. `size` is at most `kMaxSize`, so the rounding cannot wrap.
+ */
+constexpr size_t LargeSize(size_t size) {
+  if (size <= kMaxClassSize) return size;
+  size_t step = bit_floor(size) / 4;
+  return (size + step - 1) & ~(step - 1);
+}
+static_assert(LargeSize(kMaxSize) >= kMaxSize);
+
+/**
+ * A bump allocator for the calls made while the pool is busy on the same
+ * thread, e.g. the `calloc` of the C library when a thread cache is created.
+ *
+ * Its memory is never reused. `free` ignores it, since it is neither in a
+ * block nor a large allocation of the pool. The size of every allocation is
+ * kept in the word before it, so that `realloc` copies as much as it holds.
+ */
+class BootstrapArena {
+ public:
+  static constexpr size_t kChunkSize = 64_kB;
+
+  void* Alloc(size_t size, size_t align) {
+    if (align < kMinAlign) align = kMinAlign;
+    Lock();
+    size_t begin = chunk_ ? Begin(used_, align) : 0;
+    if (!chunk_ || begin + size > chunk_size_) {
+      size_t needed = size + align + sizeof(size_t);
+      chunk_size_ = needed > kChunkSize ? needed : kChunkSize;
+      chunk_ = static_cast<byte*>(resource_.Alloc(
+          chunk_size_, static_cast<align_t>(kPageSize)));
+      begin = chunk_ ? Begin(0, align) : 0;
+    }
+    byte* ptr = nullptr;
+    if (chunk_) {
+      ptr = chunk_ + begin;
+      reinterpret_cast<size_t*>(ptr)[-1] = size;
+      used_ = begin + size;
+    }
+    Unlock();
+    return ptr;
+  }
+  /**
+   * Size requested for an allocation of the arena.
+   */
+  static size_t Size(const void* ptr) {
+    return static_cast<const size_t*>(ptr)[-1];
+  }
+  void Lock() {
+    while (lock_.test_and_set(memory_order_acquire)) {}
+  }
+  void Unlock() {
+    lock_.clear(memory_order_release);
+  }
+
+ private:
+  MMapResource resource_;
+  atomic_flag lock_;
+  byte* chunk_ = nullptr;
+  size_t chunk_size_ = 0;
+  size_t used_ = 0;
+
+  /**
+   * Offset of the first address at or past `offset` that is aligned to
+   * `align` and leaves room for the size before it.
+   */
+  size_t Begin(size_t offset, size_t align) const {
+    size_t base = reinterpret_cast<size_t>(chunk_);
+    size_t addr = base + offset + sizeof(size_t);
+    return ((addr + align - 1) & ~(align - 1)) - base;
+  }
+};
+
+constinit RetainingMMapResource resource;
+constinit BootstrapArena bootstrap;
+/* Set while the calling thread is inside the pool. */
+constinit thread_local bool in_pool = false;
+
+Pool& GlobalPool() {
+  alignas(Pool) static byte storage[sizeof(Pool)];
+  static Pool* pool =
+      new (storage) Pool(Vendor<RetainingMMapResource>{ resource });
+  return *pool;
+}
+
+/**
+ * Marks the calling thread as inside the pool for the scope.
+ */
+class PoolScope {
+ public:
+  PoolScope() {
+    in_pool = true;
+  }
+  ~PoolScope() {
+    in_pool = false;
+  }
+};
+
+void* Alloc(size_t size, size_t align) {
+  if (size > kMaxSize || align > kMaxSize) [[unlikely]] {
+    errno = ENOMEM;
+    return nullptr;
+  }
+  if (align < kMinAlign) align = kMinAlign;
+  if (in_pool) [[unlikely]] return bootstrap.Alloc(size, align);
+  PoolScope scope;
+  void* ptr =
+      GlobalPool().RawAlloc(LargeSize(size), static_cast<align_t>(align));
+  if (!ptr) [[unlikely]] errno = ENOMEM;
+  return ptr;
+}
+void Dealloc(void* ptr) {
+  if (!ptr || in_pool) [[unlikely]] return;
+  PoolScope scope;
+  GlobalPool().Dealloc(ptr);
+}
+size_t UsableSize(void* ptr) {
+  if (!ptr) return 0;
+  size_t usable = GlobalPool().UsableSize(ptr);
+  /* Neither in a block nor a large allocation, so from the bootstrap arena. */
+  if (!usable) [[unlikely]] return BootstrapArena::Size(ptr);
+  return usable;
+}
+void* Realloc(void* ptr, size_t size) {
+  if (!ptr) return Alloc(size, kMinAlign);
+  if (size == 0) {
+    Dealloc(ptr);
+    return nullptr;
+  }
+  size_t usable = UsableSize(ptr);
+  /* Stay in place unless that wastes more than half of the object. */
+  if (size <= usable && size >= usable / 2) return ptr;
+  void* new_ptr = Alloc(size, kMinAlign);
+  if (!new_ptr) return nullptr;
+  std::memcpy(new_ptr, ptr, size < usable ? size : usable);
+  Dealloc(ptr);
+  return new_ptr;
+}
+/**
+ * Fork handlers, see `SLUBPool::LockAll`. The pool is locked first, since it
+ * calls into the resource with its own locks held.
+ */
+void PrepareFork() {
+  GlobalPool().LockAll();
+  resource.Lock();
+  bootstrap.Lock();
+}
+void FinishFork() {
+  bootstrap.Unlock();
+  resource.Unlock();
+  GlobalPool().UnlockAll();
+}
+/* Forks before the library is initialized are not covered. */
+[[gnu::constructor]] void RegisterForkHandlers() {
+  pthread_atfork(PrepareFork, FinishFork, FinishFork);
+}
+bool ValidAlign(size_t align) {
+  return align && (align & (align - 1)) == 0;
+}
+void* NewOrThrow(size_t size, size_t align) {
+  void* ptr = Alloc(size, align);
+  if (!ptr) [[unlikely]] throw std::bad_alloc();
+  return ptr;
+}
+
+} // namespace
+} // namespace crystal::mem::preload
+
+using crystal::mem::preload::Alloc, crystal::mem::preload::Dealloc,
+    crystal::mem::preload::UsableSize, crystal::mem::preload::Realloc,
+    crystal::mem::preload::ValidAlign, crystal::mem::preload::NewOrThrow,
+    crystal::mem::preload::kMinAlign;
+
+/* C Allocation Functions */
+extern "C" {
+
+void* malloc(size_t size) {
+  return Alloc(size, kMinAlign);
+}
+void free(void* ptr) {
+  Dealloc(ptr);
+}
+void* calloc(size_t n, size_t size) {
+  size_t total;
+  if (__builtin_mul_overflow(n, size, &total)) {
+    errno = ENOMEM;
+    return nullptr;
+  }
+  void* ptr = Alloc(total, kMinAlign);
+  if (ptr) std::memset(ptr, 0, total);
+  return ptr;
+}
+void* realloc(void* ptr, size_t size) {
+  return Realloc(ptr, size);
+}
+void* reallocarray(void* ptr, size_t n, size_t size) {
+  size_t total;
+  if (__builtin_mul_overflow(n, size, &total)) {
+    errno = ENOMEM;
+    return nullptr;
+  }
+  return Realloc(ptr, total);
+}
+int posix_memalign(void** out, size_t align, size_t size) {
+  if (!ValidAlign(align) || align % sizeof(void*)) return EINVAL;
+  void* ptr = Alloc(size, align);
+  if (!ptr) return ENOMEM;
+  *out = ptr;
+  return 0;
+}
+void* aligned_alloc(size_t align, size_t size) {
+  if (!ValidAlign(align)) {
+    errno = EINVAL;
+    return nullptr;
+  }
+  return Alloc(size, align);
+}
+void* memalign(size_t align, size_t size) {
+  return aligned_alloc(align, size);
+}
+void* valloc(size_t size) {
+  return Alloc(size, crystal::mem::kPageSize);
+}
+void* pvalloc(size_t size) {
+  size_t page = crystal::mem::kPageSize;
+  size_t rounded;
+  if (__builtin_add_overflow(size, page - 1, &rounded)) {
+    errno = ENOMEM;
+    return nullptr;
+  }
+  return Alloc(rounded & ~(page - 1), page);
+}
+size_t malloc_usable_size(void* ptr) {
+  return UsableSize(ptr);
+}
+
+} // extern "C"
+
+/* C++ Allocation Functions */
+void* operator new(size_t size) {
+  return NewOrThrow(size, kMinAlign);
+}
+void* operator new[](size_t size) {
+  return NewOrThrow(size, kMinAlign);
+}
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+  return Alloc(size, kMinAlign);
+}
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+  return Alloc(size, kMinAlign);
+}
+void* operator new(size_t size, std::align_val_t align) {
+  return NewOrThrow(size, static_cast<size_t>(align));
+}
+void* operator new[](size_t size, std::align_val_t align) {
+  return NewOrThrow(size, static_cast<size_t>(align));
+}
+void* operator new(size_t size,
+                   std::align_val_t align,
+                   const std::nothrow_t&) noexcept {
+  return Alloc(size, static_cast<size_t>(align));
+}
+void* operator new[](size_t size,
+                     std::align_val_t align,
+                     const std::nothrow_t&) noexcept {
+  return Alloc(size, static_cast<size_t>(align));
+}
+void operator delete(void* ptr) noexcept {
+  Dealloc(ptr);
+}
+void operator delete[](void* ptr) noexcept {
+  Dealloc(ptr);
+}
+void operator delete(void* ptr, size_t) noexcept {
+  Dealloc(ptr);
+}
+void operator delete[](void* ptr, size_t) noexcept {
+  Dealloc(ptr);
+}
+void operator delete(void* ptr, std::align_val_t) noexcept {
+  Dealloc(ptr);
+}
+void operator delete[](void* ptr, std::align_val_t) noexcept {
+  Dealloc(ptr);
+}
+void operator delete(void* ptr, size_t, std::align_val_t) noexcept {
+  Dealloc(ptr);
+}
+void operator delete[](void* ptr, size_t, std::align_val_t) noexcept {
+  Dealloc(ptr);
+}
+void operator delete(void* ptr, const std::nothrow_t&) noexcept {
+  Dealloc(ptr);
+}
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept {
+  Dealloc(ptr);
+}
+void operator delete(void* ptr,
+                     std::align_val_t,
+                     const std::nothrow_t&) noexcept {
+  Dealloc(ptr);
+}
+void operator delete[](void* ptr,
+                       std::align_val_t,
+                       const std::nothrow_t&) noexcept {
+  Dealloc(ptr);
+}
@@ -1,8 +1,11 @@
 #ifndef CRYSTALMEM_TEST_MOCK_POOL_H_
 #define CRYSTALMEM_TEST_MOCK_POOL_H_
 
+#include "gtest/gtest.h"
 #include "gmock/gmock.h"
 #include "CrystalMem/pool/concept.h" // For AnyPool concept
+#include "CrystalMem/resource/os.h" // For OSResource
+#include "CrystalMem/vendor.h" // For Vendor
 #include "CrystalMem/vendor/concept.h" // For AnyVendor concept
 #include "CrystalMem/type.h" // For size_t etc.
 
@@ -70,6 +73,32 @@ inline bool operator!=(const MockVendorConceptSatisfier& lhs, const MockVendorCo
     return !(lhs == rhs);
 }
 
+// Fixture for pools without in-memory optimization: data memory comes from a
+// mock vendor as fictional addresses the pool must never touch, logic memory
+// from the OS.
+class FictionalMemoryTest : public ::testing::Test {
+protected:
+    static constexpr size_t kTestBlockSize = 1024;
+
+    MockVendorConceptSatisfier resource_vendor;
+    RealMockVendor& real_mock_vendor = resource_vendor.get_real_mock();
+    OSResource os_resource;
+    Vendor<OSResource> logic_vendor{ os_resource };
+    // The block the mock vendor hands out next, in units of kTestBlockSize.
+    size_t next_block = 1;
+
+    void SetUp() override {
+        ON_CALL(real_mock_vendor, MockAlloc(::testing::_, ::testing::_))
+            .WillByDefault([this](size_t size, align_t) {
+                size_t n_blocks = (size + kTestBlockSize - 1) / kTestBlockSize;
+                void* addr =
+                    reinterpret_cast<void*>(next_block * kTestBlockSize);
+                next_block += n_blocks + 1; // never adjacent
+                return addr;
+            });
+    }
+};
+
 // Real mock object that holds MOCK_METHODs for AnyPool's base functionality
 class RealMockPool {
 public:
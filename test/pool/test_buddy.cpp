@@ -0,0 +1,150 @@
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+#include "CrystalMem/pool/buddy/buddy.h"
+#include "CrystalMem/resource/os.h"
+#include "CrystalMem/type.h"
+#include "../mock_pool.h"
+
+#include <cstdint> // uint32_t
+#include <set> // std::set
+#include <tuple> // std::tuple
+#include <vector> // std::vector
+
+namespace crystal::mem {
+
+using ::testing::_;
+using ::testing::AnyNumber;
+using ::testing::Mock;
+
+class BuddyPoolTest : public FictionalMemoryTest {
+ protected:
+  using TestPool = BuddyPool<kTestBlockSize,
+                             16_B,
+                             MockVendorConceptSatisfier,
+                             Vendor<OSResource>>;
+};
+
+TEST_F(BuddyPoolTest, SplitsIntoBuddies) {
+  EXPECT_CALL(real_mock_vendor, MockAlloc(kTestBlockSize, _)).Times(1);
+  EXPECT_CALL(real_mock_vendor, MockDealloc(_, kTestBlockSize, _)).Times(1);
+  TestPool pool(resource_vendor, logic_vendor);
+  constexpr align_t kAlign = static_cast<align_t>(1);
+  size_t block = kTestBlockSize;
+
+  // Sizes round up to a power of 2, and halves are handed out left first.
+  ASSERT_EQ(pool.RawAlloc(10, kAlign), reinterpret_cast<void*>(block));
+  ASSERT_EQ(pool.RawAlloc(16, kAlign), reinterpret_cast<void*>(block + 16));
+  ASSERT_EQ(pool.RawAlloc(100, kAlign), reinterpret_cast<void*>(block + 128));
+  ASSERT_EQ(pool.RawAlloc(20, kAlign), reinterpret_cast<void*>(block + 32));
+  // Alignment raises the order, nodes are aligned to their size.
+  ASSERT_EQ(pool.RawAlloc(8, static_cast<align_t>(256)),
+            reinterpret_cast<void*>(block + 256));
+}
+
+TEST_F(BuddyPoolTest, MergesFreedBuddies) {
+  EXPECT_CALL(real_mock_vendor, MockAlloc(kTestBlockSize, _)).Times(2);
+  TestPool pool(resource_vendor, logic_vendor);
+  constexpr align_t kAlign = static_cast<align_t>(16);
+  std::vector<void*> ptrs;
+  for (size_t i = 0; i < kTestBlockSize / 16; ++i)
+    ptrs.push_back(pool.RawAlloc(16, kAlign));
+  // Free out of order, the whole block comes back together.
+  for (size_t i = 0; i < ptrs.size(); i += 2)
+    pool.RawDealloc(ptrs[i], 16, kAlign);
+  for (size_t i = 1; i < ptrs.size(); i += 2)
+    pool.RawDealloc(ptrs[i], 16, kAlign);
+  void* whole = pool.RawAlloc(kTestBlockSize, kAlign);
+  ASSERT_EQ(whole, ptrs[0]);
+  // The block is fully used now, so this needs the second one.
+  pool.RawAlloc(16, kAlign);
+}
+
+TEST_F(BuddyPoolTest, FreedBlocksComeBackWhole) {
+  EXPECT_CALL(real_mock_vendor, MockAlloc(kTestBlockSize, _))
+      .Times(AnyNumber());
+  EXPECT_CALL(real_mock_vendor, MockDealloc(_, kTestBlockSize, _))
+      .Times(AnyNumber());
+  TestPool pool(resource_vendor, logic_vendor);
+  std::vector<std::tuple<void*, size_t, align_t>> nodes;
+  uint32_t seed = 5;
+  for (size_t i = 0; i < 300; ++i) {
+    seed = seed * 1103515245 + 12345;
+    size_t size = 1 + (seed >> 16) % 100;
+    align_t align = static_cast<align_t>(size_t{ 1 } << ((seed >> 8) % 7));
+    nodes.emplace_back(pool.RawAlloc(size, align), size, align);
+  }
+  size_t n_blocks = (next_block - 1) / 2;
+  for (size_t i = 1; i < nodes.size(); i += 2) {
+    auto [ptr, size, align] = nodes[i];
+    pool.RawDealloc(ptr, size, align);
+  }
+  for (size_t i = 0; i < nodes.size(); i += 2) {
+    auto [ptr, size, align] = nodes[i];
+    pool.RawDealloc(ptr, size, align);
+  }
+  Mock::VerifyAndClearExpectations(&real_mock_vendor);
+
+  // Every root is free again, so each block is handed out whole.
+  EXPECT_CALL(real_mock_vendor, MockAlloc(_, _)).Times(0);
+  std::set<void*> wholes;
+  for (size_t i = 0; i < n_blocks; ++i) {
+    void* whole = pool.RawAlloc(kTestBlockSize, static_cast<align_t>(1));
+    ASSERT_NE(whole, nullptr);
+    wholes.insert(whole);
+  }
+  ASSERT_EQ(wholes.size(), n_blocks);
+  Mock::VerifyAndClearExpectations(&real_mock_vendor);
+
+  EXPECT_CALL(real_mock_vendor, MockAlloc(kTestBlockSize, _)).Times(1);
+  EXPECT_CALL(real_mock_vendor, MockDealloc(_, kTestBlockSize, _))
+      .Times(n_blocks + 1);
+  pool.RawAlloc(16, static_cast<align_t>(16));
+}
+
+TEST(BuddyBlockTest, FindsFreeNodeOfOrder) {
+  using Block = BuddyBlock<1024, 16>;
+  ASSERT_EQ(Block::kMaxOrder, 6);
+  Block block(reinterpret_cast<void*>(1024));
+  // Order 5 holds nodes 2 and 3, order 4 nodes 4 to 7, in the same word.
+  block.MarkFree(4, 6);
+  block.MarkFree(5, 3);
+  ASSERT_EQ(block.FindFree(5), 3);
+  ASSERT_EQ(block.FindFree(4), 6);
+  ASSERT_EQ(block.Addr(4, 6), 1024 + 512);
+  ASSERT_EQ(block.Node(4, 1024 + 512), 6);
+  block.MarkUsed(4, 6);
+  ASSERT_EQ(block.NFree(4), 0);
+
+  // Order 0 of a larger block spans several words.
+  BuddyBlock<4096, 16> large_block(reinterpret_cast<void*>(4096));
+  large_block.MarkFree(0, 256 + 200);
+  ASSERT_EQ(large_block.FindFree(0), 256 + 200);
+  ASSERT_EQ(large_block.Addr(0, 256 + 200), 4096 + 200 * 16);
+}
+
+TEST(BuddyBlockTest, SummaryLevelsFindNodesOfTheirOrder) {
+  using Block = BuddyBlock<64_kB, 16>;
+  ASSERT_EQ(Block::kNLevels, 3);
+  Block block(reinterpret_cast<void*>(64_kB));
+  // One free node per order, at the far end of its range, while every other
+  // order has its nodes marked too.
+  for (size_t order = 0; order <= Block::kMaxOrder; ++order)
+    block.MarkFree(order, (size_t{ 2 } << (Block::kMaxOrder - order)) - 1);
+  for (size_t order = 0; order <= Block::kMaxOrder; ++order) {
+    size_t last = (size_t{ 2 } << (Block::kMaxOrder - order)) - 1;
+    ASSERT_EQ(block.FindFree(order), last);
+  }
+
+  // Taking the node of an order leaves the others found, and marking another
+  // one finds that.
+  block.MarkUsed(0, 8191);
+  block.MarkFree(0, 4096 + 1234);
+  ASSERT_EQ(block.FindFree(0), 4096 + 1234);
+  ASSERT_EQ(block.FindFree(1), 4095);
+  block.MarkUsed(0, 4096 + 1234);
+  ASSERT_EQ(block.NFree(0), 0);
+  ASSERT_FALSE(block.IsFree(4096 + 1234));
+  ASSERT_EQ(block.FindFree(6), 127);
+}
+
+} // namespace crystal::mem
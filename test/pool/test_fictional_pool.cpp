@@ -0,0 +1,171 @@
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+#include "CrystalMem/pool/buddy/buddy.h"
+#include "CrystalMem/pool/monotonic_arena/monotonic_arena.h"
+#include "CrystalMem/pool/safe_best_fit/safe_best_fit.h"
+#include "CrystalMem/pool/stack/stack.h"
+#include "CrystalMem/pool/tlsf/tlsf.h"
+#include "CrystalMem/resource/os.h"
+#include "CrystalMem/type.h"
+#include "../mock_pool.h"
+
+#include <algorithm> // std::sort
+#include <cstdint> // uint32_t
+#include <tuple> // std::tuple, std::get
+#include <utility> // std::pair
+#include <vector> // std::vector
+
+namespace crystal::mem {
+
+using ::testing::_;
+using ::testing::AnyNumber;
+
+/* Behavior shared by the pools without in-memory optimization. */
+template <typename Pool>
+class FictionalPoolTest : public FictionalMemoryTest {
+ protected:
+  void SetUp() override {
+    FictionalMemoryTest::SetUp();
+    EXPECT_CALL(real_mock_vendor, MockAlloc(_, _)).Times(AnyNumber());
+    EXPECT_CALL(real_mock_vendor, MockDealloc(_, _, _)).Times(AnyNumber());
+  }
+};
+
+using FictionalPools = ::testing::Types<
+    SafeBestFitPool<1024, MockVendorConceptSatisfier, Vendor<OSResource>>,
+    SafeBestFitPool<1024,
+                    MockVendorConceptSatisfier,
+                    Vendor<OSResource>,
+                    SafeBestFitOptions{ .btree_free_index = true }>,
+    TLSFPool<1024, MockVendorConceptSatisfier, Vendor<OSResource>>,
+    BuddyPool<1024, 16, MockVendorConceptSatisfier, Vendor<OSResource>>,
+    MonotonicArenaPool<1024, MockVendorConceptSatisfier, Vendor<OSResource>>,
+    StackPool<1024, MockVendorConceptSatisfier, Vendor<OSResource>>>;
+TYPED_TEST_SUITE(FictionalPoolTest, FictionalPools);
+
+TYPED_TEST(FictionalPoolTest, HandsOutDisjointAlignedRanges) {
+  TypeParam pool(this->resource_vendor, this->logic_vendor);
+  // Ranges are freed with the size and alignment they were allocated with.
+  std::vector<std::tuple<size_t, size_t, align_t>> ranges;
+  uint32_t seed = 7;
+  for (size_t i = 0; i < 2000; ++i) {
+    seed = seed * 1103515245 + 12345;
+    size_t size = 1 + (seed >> 16) % 300;
+    align_t align = static_cast<align_t>(size_t{ 1 } << ((seed >> 8) % 7));
+    void* ptr = pool.RawAlloc(size, align);
+    ASSERT_EQ(reinterpret_cast<size_t>(ptr) % static_cast<size_t>(align), 0);
+    ranges.emplace_back(reinterpret_cast<size_t>(ptr), size, align);
+    // Free some of them again to fragment the blocks.
+    if (seed % 3 == 0) {
+      size_t victim = (seed >> 4) % ranges.size();
+      auto [addr, victim_size, victim_align] = ranges[victim];
+      pool.RawDealloc(reinterpret_cast<void*>(addr), victim_size,
+                      victim_align);
+      ranges[victim] = ranges.back();
+      ranges.pop_back();
+    }
+  }
+
+  // No two live ranges overlap, and none crosses a block boundary.
+  std::sort(ranges.begin(), ranges.end());
+  for (size_t i = 0; i < ranges.size(); ++i) {
+    auto [addr, size, align] = ranges[i];
+    ASSERT_EQ(addr / this->kTestBlockSize,
+              (addr + size - 1) / this->kTestBlockSize);
+    if (i + 1 < ranges.size()) {
+      ASSERT_LE(addr + size, std::get<0>(ranges[i + 1]));
+    }
+  }
+  for (auto [addr, size, align] : ranges)
+    pool.RawDealloc(reinterpret_cast<void*>(addr), size, align);
+}
+
+TYPED_TEST(FictionalPoolTest, LargeObjectsGoToTheVendor) {
+  constexpr size_t kLargeSize = 3 * 1024;
+  EXPECT_CALL(this->real_mock_vendor, MockAlloc(kLargeSize, _)).Times(1);
+  EXPECT_CALL(this->real_mock_vendor, MockDealloc(_, kLargeSize, _)).Times(1);
+  TypeParam pool(this->resource_vendor, this->logic_vendor);
+  void* ptr = pool.RawAlloc(kLargeSize, static_cast<align_t>(8));
+  pool.RawDealloc(ptr, kLargeSize, static_cast<align_t>(8));
+}
+
+TYPED_TEST(FictionalPoolTest, ResizesInPlaceWithoutOverlap) {
+  TypeParam pool(this->resource_vendor, this->logic_vendor);
+  std::vector<std::pair<size_t, size_t>> ranges;
+  size_t n_expanded = 0, n_shrunk = 0;
+  uint32_t seed = 11;
+  for (size_t i = 0; i < 2000; ++i) {
+    seed = seed * 1103515245 + 12345;
+    size_t size = 1 + (seed >> 16) % 200;
+    void* ptr = pool.template ContinuousAlloc<char>(size);
+    ranges.emplace_back(reinterpret_cast<size_t>(ptr), size);
+    // Resize a random live range, it either keeps its address or fails.
+    seed = seed * 1103515245 + 12345;
+    auto& [addr, old_size] = ranges[(seed >> 4) % ranges.size()];
+    size_t new_size = 1 + (seed >> 16) % 300;
+    char* old_ptr = reinterpret_cast<char*>(addr);
+    if (new_size > old_size &&
+        pool.template TryExpandInPlace<char>(old_ptr, old_size, new_size)) {
+      old_size = new_size;
+      ++n_expanded;
+    } else if (new_size < old_size &&
+               pool.template Shrink<char>(old_ptr, old_size, new_size)) {
+      old_size = new_size;
+      ++n_shrunk;
+    }
+    if (seed % 3 == 0) {
+      size_t victim = (seed >> 8) % ranges.size();
+      auto [victim_addr, victim_size] = ranges[victim];
+      pool.template ContinuousDealloc<char>(
+          reinterpret_cast<char*>(victim_addr), victim_size);
+      ranges[victim] = ranges.back();
+      ranges.pop_back();
+    }
+  }
+  ASSERT_GT(n_expanded, 0);
+  ASSERT_GT(n_shrunk, 0);
+
+  std::sort(ranges.begin(), ranges.end());
+  for (size_t i = 0; i < ranges.size(); ++i) {
+    auto [addr, size] = ranges[i];
+    ASSERT_EQ(addr / this->kTestBlockSize,
+              (addr + size - 1) / this->kTestBlockSize);
+    if (i + 1 < ranges.size()) {
+      ASSERT_LE(addr + size, ranges[i + 1].first);
+    }
+  }
+  for (auto [addr, size] : ranges)
+    pool.template ContinuousDealloc<char>(reinterpret_cast<char*>(addr), size);
+}
+
+TYPED_TEST(FictionalPoolTest, AllocAtLeastReportsDisjointRoom) {
+  TypeParam pool(this->resource_vendor, this->logic_vendor);
+  std::vector<std::pair<size_t, size_t>> ranges;
+  uint32_t seed = 13;
+  for (size_t i = 0; i < 1000; ++i) {
+    seed = seed * 1103515245 + 12345;
+    size_t n = 1 + (seed >> 16) % 60;
+    auto [ptr, count] = pool.template ContinuousAllocAtLeast<uint32_t>(n);
+    ASSERT_GE(count, n);
+    ranges.emplace_back(reinterpret_cast<size_t>(ptr), count);
+    if (seed % 3 == 0) {
+      size_t victim = (seed >> 4) % ranges.size();
+      auto [addr, victim_count] = ranges[victim];
+      pool.template ContinuousDealloc<uint32_t>(
+          reinterpret_cast<uint32_t*>(addr), victim_count);
+      ranges[victim] = ranges.back();
+      ranges.pop_back();
+    }
+  }
+
+  // The reported room of live arrays never overlaps.
+  std::sort(ranges.begin(), ranges.end());
+  for (size_t i = 0; i + 1 < ranges.size(); ++i)
+    ASSERT_LE(ranges[i].first + ranges[i].second * sizeof(uint32_t),
+              ranges[i + 1].first);
+  for (auto [addr, count] : ranges)
+    pool.template ContinuousDealloc<uint32_t>(
+        reinterpret_cast<uint32_t*>(addr), count);
+}
+
+} // namespace crystal::mem
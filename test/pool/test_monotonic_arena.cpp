@@ -0,0 +1,94 @@
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+#include "CrystalMem/pool/monotonic_arena/monotonic_arena.h"
+#include "CrystalMem/resource/os.h"
+#include "CrystalMem/type.h"
+#include "../mock_pool.h"
+
+namespace crystal::mem {
+
+using ::testing::_;
+using ::testing::Mock;
+
+class MonotonicArenaPoolTest : public FictionalMemoryTest {
+ protected:
+  template <size_t kRetention = 1>
+  using TestPool = MonotonicArenaPool<
+      kTestBlockSize,
+      MockVendorConceptSatisfier,
+      Vendor<OSResource>,
+      MonotonicArenaOptions{ .block_retention = kRetention }>;
+
+  static void* Addr(size_t addr) {
+    return reinterpret_cast<void*>(addr);
+  }
+};
+
+TEST_F(MonotonicArenaPoolTest, BumpsThroughBlocks) {
+  EXPECT_CALL(real_mock_vendor, MockAlloc(kTestBlockSize, _)).Times(2);
+  EXPECT_CALL(real_mock_vendor, MockDealloc(_, kTestBlockSize, _)).Times(2);
+  TestPool<> pool(resource_vendor, logic_vendor);
+  constexpr align_t kAlign = static_cast<align_t>(1);
+  size_t block = kTestBlockSize;
+
+  ASSERT_EQ(pool.RawAlloc(10, kAlign), Addr(block));
+  ASSERT_EQ(pool.RawAlloc(20, kAlign), Addr(block + 10));
+  // Alignment skips ahead.
+  ASSERT_EQ(pool.RawAlloc(8, static_cast<align_t>(64)), Addr(block + 64));
+  // What does not fit in the rest of the block goes to the next one.
+  ASSERT_EQ(pool.RawAlloc(kTestBlockSize - 100, kAlign), Addr(block + 72));
+  ASSERT_EQ(pool.RawAlloc(100, kAlign), Addr(3 * kTestBlockSize));
+}
+
+TEST_F(MonotonicArenaPoolTest, DeallocOnlyReusesTheLastAllocation) {
+  EXPECT_CALL(real_mock_vendor, MockAlloc(kTestBlockSize, _)).Times(1);
+  EXPECT_CALL(real_mock_vendor, MockDealloc(_, kTestBlockSize, _)).Times(1);
+  TestPool<> pool(resource_vendor, logic_vendor);
+  constexpr align_t kAlign = static_cast<align_t>(8);
+  void* first = pool.RawAlloc(64, kAlign);
+  void* second = pool.RawAlloc(64, kAlign);
+  pool.RawDealloc(first, 64, kAlign);
+  ASSERT_EQ(pool.RawAlloc(32, kAlign), Addr(kTestBlockSize + 128));
+
+  // Stack-like use gives memory back in reverse.
+  pool.RawDealloc(Addr(kTestBlockSize + 128), 32, kAlign);
+  pool.RawDealloc(second, 64, kAlign);
+  ASSERT_EQ(pool.RawAlloc(16, kAlign), second);
+
+  // The last array grows and shrinks in place, others do not grow.
+  char* array = pool.ContinuousAlloc<char>(100);
+  ASSERT_TRUE(pool.TryExpandInPlace<char>(array, 100, 200));
+  ASSERT_FALSE(pool.TryExpandInPlace<char>(reinterpret_cast<char*>(first),
+                                           64, 65));
+  ASSERT_FALSE(pool.TryExpandInPlace<char>(array, 200, kTestBlockSize));
+  ASSERT_TRUE(pool.Shrink<char>(array, 200, 50));
+  ASSERT_EQ(pool.RawAlloc(1, kAlign), array + 56);
+}
+
+TEST_F(MonotonicArenaPoolTest, ClearKeepsRetainedBlocks) {
+  EXPECT_CALL(real_mock_vendor, MockAlloc(kTestBlockSize, _)).Times(3);
+  TestPool<1> pool(resource_vendor, logic_vendor);
+  constexpr align_t kAlign = static_cast<align_t>(16);
+  void* first = pool.RawAlloc(kTestBlockSize, kAlign);
+  pool.RawAlloc(kTestBlockSize, kAlign);
+  pool.RawAlloc(kTestBlockSize, kAlign);
+
+  // Only the blocks past the retention go back.
+  EXPECT_CALL(real_mock_vendor, MockDealloc(_, kTestBlockSize, _)).Times(2);
+  pool.Clear();
+  Mock::VerifyAndClearExpectations(&real_mock_vendor);
+
+  // The kept block is bumped through again without asking the vendor.
+  EXPECT_CALL(real_mock_vendor, MockAlloc(_, _)).Times(0);
+  for (size_t i = 0; i < 100; ++i) {
+    ASSERT_EQ(pool.RawAlloc(kTestBlockSize / 2, kAlign), first);
+    pool.RawAlloc(kTestBlockSize / 2, kAlign);
+    pool.Clear();
+  }
+  Mock::VerifyAndClearExpectations(&real_mock_vendor);
+
+  EXPECT_CALL(real_mock_vendor, MockDealloc(first, kTestBlockSize, _))
+      .Times(1);
+}
+
+} // namespace crystal::mem
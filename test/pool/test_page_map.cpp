@@ -0,0 +1,38 @@
+#include "gtest/gtest.h"
+#include "CrystalMem/pool/page_map.h"
+#include "CrystalMem/resource/os.h"
+#include "CrystalMem/type.h"
+#include "CrystalMem/vendor.h"
+
+namespace crystal::mem {
+
+TEST(PageMapTest, SetAndGetPages) {
+  OSResource resource;
+  PageMap<4_kB, size_t, Vendor<OSResource>> map{ Vendor<OSResource>{
+      resource } };
+  auto addr = [](size_t addr) { return reinterpret_cast<void*>(addr); };
+
+  // Unmapped pages read as zero without allocating.
+  ASSERT_EQ(map.Get(addr(0x1234)), 0);
+
+  map.Set(addr(0x10000), 3 * 4_kB, 7);
+  ASSERT_EQ(map.Get(addr(0x10000)), 7);
+  ASSERT_EQ(map.Get(addr(0x12fff)), 7);
+  ASSERT_EQ(map.Get(addr(0xffff)), 0);
+  ASSERT_EQ(map.Get(addr(0x13000)), 0);
+
+  // Pages far apart live under different nodes.
+  map.Set(addr(0x7f0000000000), 4_kB, 9);
+  ASSERT_EQ(map.Get(addr(0x7f0000000fff)), 9);
+  ASSERT_EQ(map.Get(addr(0x10000)), 7);
+
+  map.Set(addr(0x10000), 4_kB, 0);
+  ASSERT_EQ(map.Get(addr(0x10000)), 0);
+  ASSERT_EQ(map.Get(addr(0x11000)), 7);
+
+  map.Clear();
+  ASSERT_EQ(map.Get(addr(0x11000)), 0);
+  ASSERT_EQ(map.Get(addr(0x7f0000000000)), 0);
+}
+
+} // namespace crystal::mem
@@ -1,11 +1,18 @@
 #include "gtest/gtest.h"
+#include "CrystalMem/pool/realloc.h"
+#include "CrystalMem/pool/safe_best_fit/btree.h"
 #include "CrystalMem/pool/safe_best_fit/free_map.h"
 #include "CrystalMem/type.h"
 
 #include <numeric> // For std::iota (not directly used in free_map, but useful for testing)
 #include <vector> // For managing test memory
 #include <limits> // For std::numeric_limits
+#include <map> // For the reference model of free nodes
+#include <algorithm> // For std::min
 #include <utility> // For std::pair
+#include <set> // For the reference model of the B+ tree
+#include <functional> // For std::identity
+#include <iterator> // For std::make_reverse_iterator
 
 // Include the main SafeBestFitPool header and the mock vendor header
 #include "CrystalMem/pool/safe_best_fit/safe_best_fit.h"
@@ -131,6 +138,18 @@ TEST_F(SafeBestFitFreeMapTest, AllocatesWithAlignment) {
     ASSERT_LE(reinterpret_cast<size_t>(allocated_addr) + 100, reinterpret_cast<size_t>(unaligned_start) + 200);
 }
 
+TEST_F(SafeBestFitFreeMapTest, ZeroSizeDeallocLeavesNoNode) {
+    SafeBestFitFreeMap<FreeMapAllocator> free_map{FreeMapAllocator{}};
+    void* middle = reinterpret_cast<void*>(reinterpret_cast<size_t>(buffer_start) + 100);
+    ASSERT_EQ(free_map.Dealloc(middle, 0, static_cast<align_t>(1)).second, 0);
+    free_map.Dealloc(buffer_start, 100, static_cast<align_t>(1));
+    free_map.Dealloc(middle, 50, static_cast<align_t>(1));
+
+    // Both halves merge into one node, with nothing left at the middle.
+    ASSERT_EQ(free_map.NodeSize(buffer_start), 150);
+    ASSERT_TRUE(free_map.IsFree(middle, 50));
+}
+
 TEST_F(SafeBestFitFreeMapTest, AllocFailsIfNoFit) {
     SafeBestFitFreeMap<FreeMapAllocator> free_map{FreeMapAllocator{}};
     free_map.InsertNode(buffer_start, 100);
@@ -193,15 +212,171 @@ TEST_F(SafeBestFitFreeMapTest, DeallocMergesWithRightBlock) {
     ASSERT_EQ(allocated_merged_addr, reinterpret_cast<void*>(reinterpret_cast<size_t>(buffer_start) + 50));
 }
 
+// Tens of thousands of fragments, checked against a linear scan for the best fit.
+// Fits may waste up to the alignment more, when many nodes are too short once aligned.
+TEST_F(SafeBestFitFreeMapTest, FindsBestFitAmongManyFragments) {
+    SafeBestFitFreeMap<FreeMapAllocator> free_map{FreeMapAllocator{}};
+    std::map<size_t, size_t> model; // offset -> size
+    auto addr = [&](size_t offset) {
+        return reinterpret_cast<void*>(reinterpret_cast<size_t>(buffer_start) + offset);
+    };
+
+    // Fragments of 1 to 16 bytes, separated by 1 byte gaps.
+    size_t offset = 0;
+    for (size_t i = 0; offset + 17 <= buffer_size && model.size() < 40000; ++i) {
+        size_t size = 1 + (i * 7919) % 16;
+        free_map.InsertNode(addr(offset), size);
+        model[offset] = size;
+        offset += size + 1;
+    }
+
+    uint32_t seed = 12345;
+    for (size_t i = 0; i < 1000; ++i) {
+        seed = seed * 1103515245 + 12345;
+        size_t size = 1 + (seed >> 16) % 16;
+        size_t align = size_t{ 1 } << ((seed >> 8) % 4);
+
+        // The least waste of any fit.
+        size_t best_waste = -1ul;
+        for (auto [node_offset, node_size] : model) {
+            size_t start = (reinterpret_cast<size_t>(addr(node_offset)) + align - 1) & ~(align - 1);
+            size_t l_padding = start - reinterpret_cast<size_t>(addr(node_offset));
+            if (l_padding + size <= node_size) best_waste = std::min(best_waste, node_size - size);
+        }
+
+        void* allocated = free_map.Alloc(size, static_cast<align_t>(align));
+        if (best_waste == -1ul) {
+            ASSERT_EQ(reinterpret_cast<uint64_t>(allocated), -1ul);
+            continue;
+        }
+        // It comes from a free node, aligned, and wastes at most the alignment more than the best fit.
+        ASSERT_NE(reinterpret_cast<uint64_t>(allocated), -1ul);
+        ASSERT_EQ(reinterpret_cast<size_t>(allocated) % align, 0);
+        size_t allocated_offset = reinterpret_cast<size_t>(allocated) - reinterpret_cast<size_t>(buffer_start);
+        auto node = model.upper_bound(allocated_offset);
+        ASSERT_NE(node, model.begin());
+        --node;
+        auto [node_offset, node_size] = *node;
+        size_t l_padding = allocated_offset - node_offset;
+        ASSERT_LE(l_padding + size, node_size);
+        ASSERT_LE(node_size - size, best_waste + align - 1);
+        model.erase(node);
+        if (l_padding) model[node_offset] = l_padding;
+        if (node_size - l_padding - size) model[node_offset + l_padding + size] = node_size - l_padding - size;
+
+        // Give every other allocation back, it merges with its split remainders.
+        if (i % 2) {
+            free_map.Dealloc(allocated, size, static_cast<align_t>(align));
+            size_t start = node_offset + l_padding;
+            model[start] = size;
+            auto next = model.find(start + size);
+            if (next != model.end()) {
+                model[start] += next->second;
+                model.erase(next);
+            }
+            auto self = model.find(start);
+            if (self != model.begin()) {
+                auto left = std::prev(self);
+                if (left->first + left->second == start) {
+                    left->second += self->second;
+                    model.erase(self);
+                }
+            }
+        }
+    }
+}
+
+// The same allocations and deallocations get the same addresses from both
+// free node indexes.
+TEST_F(SafeBestFitFreeMapTest, BTreeIndexMatchesTreeIndex) {
+    SafeBestFitFreeMap<FreeMapAllocator, TreeFreeIndex> tree_map{FreeMapAllocator{}};
+    SafeBestFitFreeMap<FreeMapAllocator, BTreeFreeIndex> btree_map{FreeMapAllocator{}};
+    tree_map.InsertNode(buffer_start, buffer_size);
+    btree_map.InsertNode(buffer_start, buffer_size);
+
+    std::vector<std::pair<void*, size_t>> live;
+    uint32_t seed = 42;
+    for (size_t i = 0; i < 20000; ++i) {
+        seed = seed * 1103515245 + 12345;
+        if (live.empty() || seed % 5 < 3) {
+            size_t size = 1 + (seed >> 16) % 200;
+            align_t align = static_cast<align_t>(size_t{ 1 } << ((seed >> 8) % 5));
+            void* allocated = tree_map.Alloc(size, align);
+            ASSERT_EQ(btree_map.Alloc(size, align), allocated);
+            if (reinterpret_cast<uint64_t>(allocated) != -1ul) live.emplace_back(allocated, size);
+        } else {
+            size_t victim = (seed >> 4) % live.size();
+            auto [addr, size] = live[victim];
+            ASSERT_EQ(btree_map.Dealloc(addr, size, static_cast<align_t>(1)),
+                      tree_map.Dealloc(addr, size, static_cast<align_t>(1)));
+            live[victim] = live.back();
+            live.pop_back();
+        }
+    }
+}
+
+// Random insertions and erasures, checked against std::set, with nodes small
+// enough for a deep tree.
+TEST(BPlusTreeTest, MatchesStdSet) {
+    BPlusTree<size_t, TestAllocator<size_t>, std::identity, 64> tree{TestAllocator<size_t>{}};
+    std::set<size_t> model;
+    uint32_t seed = 1;
+    for (size_t i = 0; i < 30000; ++i) {
+        seed = seed * 1103515245 + 12345;
+        size_t key = (seed >> 12) % 3000;
+        // Insert more than erase at first, then the other way around.
+        if ((seed >> 4) % 10 < (i < 15000 ? 7 : 3)) {
+            ASSERT_EQ(tree.emplace(key), model.insert(key).second);
+        } else {
+            ASSERT_EQ(tree.erase(key), model.erase(key));
+        }
+        ASSERT_EQ(tree.size(), model.size());
+
+        auto lower = tree.lower_bound(key);
+        auto model_lower = model.lower_bound(key);
+        ASSERT_EQ(lower == tree.end(), model_lower == model.end());
+        if (model_lower != model.end()) {
+            ASSERT_EQ(*lower, *model_lower);
+        }
+        auto upper = tree.upper_bound(key);
+        auto model_upper = model.upper_bound(key);
+        ASSERT_EQ(upper == tree.end(), model_upper == model.end());
+        if (model_upper != model.end()) {
+            ASSERT_EQ(*upper, *model_upper);
+        }
+        if (model_upper != model.begin()) {
+            ASSERT_EQ(*std::prev(upper), *std::prev(model_upper));
+        }
+        ASSERT_EQ(tree.find(key) != tree.end(), model.count(key) == 1);
+
+        if (i % 1000 == 0) {
+            ASSERT_TRUE(std::equal(tree.begin(), tree.end(), model.begin(), model.end()));
+            ASSERT_TRUE(std::equal(std::make_reverse_iterator(tree.end()), std::make_reverse_iterator(tree.begin()),
+                                   model.rbegin(), model.rend()));
+        }
+    }
+    while (!model.empty()) {
+        ASSERT_EQ(tree.erase(*model.begin()), 1);
+        model.erase(model.begin());
+    }
+    ASSERT_TRUE(tree.empty());
+    ASSERT_EQ(tree.begin(), tree.end());
+}
+
 } // namespace crystal::mem
 
 // Append the SafeBestFitPool tests
 // Needed includes (put here to avoid changing indentation of existing content)
 #include "CrystalMem/pool/safe_best_fit/safe_best_fit.h" // Include the main SafeBestFitPool header
+#include "CrystalMem/resource/os.h" // OSResource
+#include "CrystalMem/vendor.h" // Vendor
 #include "../mock_pool.h" // Include mock vendor
 
 // Define a block size for testing purposes
 constexpr size_t kTestBlockSize = 256; // Smaller block size for easier testing
+// Allocations larger than a block but smaller than a page are requested page aligned.
+constexpr crystal::mem::align_t kLargeAlign = static_cast<crystal::mem::align_t>(
+    crystal::mem::LargeAllocMap<kTestBlockSize + 1, crystal::mem::MockVendorConceptSatisfier>::kPageSize);
 
 // Test fixture for SafeBestFitPool
 class SafeBestFitPoolTest : public ::testing::Test {
@@ -240,18 +415,16 @@ protected:
         EXPECT_CALL(real_mock_resource_vendor, MockDealloc(::testing::_, ::testing::Gt(kTestBlockSize), ::testing::_))
             .WillRepeatedly(::testing::Return());
 
-        // LogicVendor Alloc/Dealloc for internal data structures (std::vector, std::map)
-        // These allocations are generally small and varied.
-        // We'll use a generic handler for any size/align, always returning a dummy pointer.
+        // LogicVendor Alloc/Dealloc for internal data structures (std::vector, std::map,
+        // the page map of large allocations). The state is written to, so it needs real memory.
         EXPECT_CALL(real_mock_logic_vendor, MockAlloc(::testing::_, ::testing::_))
             .WillRepeatedly([](size_t size, crystal::mem::align_t align) {
-                // Simulate internal allocation. Use a larger static buffer or dynamically allocate as needed.
-                // For simplicity, a small, fixed-size static buffer that's large enough for typical internal allocations.
-                static std::vector<std::byte> internal_memory_for_logic(1024); // Provide a buffer for logic allocations
-                return reinterpret_cast<void*>(internal_memory_for_logic.data());
+                return _aligned_malloc(size, static_cast<size_t>(align));
             });
         EXPECT_CALL(real_mock_logic_vendor, MockDealloc(::testing::_, ::testing::_, ::testing::_))
-            .WillRepeatedly(::testing::Return());
+            .WillRepeatedly([](void* ptr, size_t size, crystal::mem::align_t align) {
+                _aligned_free(ptr);
+            });
     }
 };
 
@@ -291,7 +464,7 @@ TEST_F(SafeBestFitPoolTest, DiscreteAllocLargeObject) {
 
     struct LargeObj { std::array<char, kTestBlockSize + 100> data; }; // Larger than kTestBlockSize
     
-    EXPECT_CALL(real_mock_resource_vendor, MockAlloc(sizeof(LargeObj), static_cast<crystal::mem::align_t>(alignof(LargeObj))))
+    EXPECT_CALL(real_mock_resource_vendor, MockAlloc(sizeof(LargeObj), kLargeAlign))
         .WillOnce([](size_t size, crystal::mem::align_t align) {
             static std::vector<std::byte> large_block_memory(size);
             return reinterpret_cast<void*>(large_block_memory.data());
@@ -331,7 +504,7 @@ TEST_F(SafeBestFitPoolTest, DiscreteDeallocLargeObject) {
     struct LargeObj { std::array<char, kTestBlockSize + 100> data; };
 
     // Allocate a large object
-    EXPECT_CALL(real_mock_resource_vendor, MockAlloc(sizeof(LargeObj), static_cast<crystal::mem::align_t>(alignof(LargeObj))))
+    EXPECT_CALL(real_mock_resource_vendor, MockAlloc(sizeof(LargeObj), kLargeAlign))
         .WillOnce([](size_t size, crystal::mem::align_t align) {
             static std::vector<std::byte> large_block_memory(size);
             return reinterpret_cast<void*>(large_block_memory.data());
@@ -340,7 +513,7 @@ TEST_F(SafeBestFitPoolTest, DiscreteDeallocLargeObject) {
     ASSERT_NE(obj, nullptr);
 
     // Deallocate the large object
-    EXPECT_CALL(real_mock_resource_vendor, MockDealloc(reinterpret_cast<void*>(obj), sizeof(LargeObj), static_cast<crystal::mem::align_t>(alignof(LargeObj))))
+    EXPECT_CALL(real_mock_resource_vendor, MockDealloc(reinterpret_cast<void*>(obj), sizeof(LargeObj), kLargeAlign))
         .Times(1);
     pool.DiscreteDealloc(obj);
 }
@@ -364,7 +537,7 @@ TEST_F(SafeBestFitPoolTest, ClearDeallocatesAllMemory) {
     SmallObj* small_obj = pool.DiscreteAlloc<SmallObj>(); // Will cause a block to be appended
 
     void* large_obj_ptr;
-    EXPECT_CALL(real_mock_resource_vendor, MockAlloc(sizeof(LargeObj), static_cast<crystal::mem::align_t>(alignof(LargeObj))))
+    EXPECT_CALL(real_mock_resource_vendor, MockAlloc(sizeof(LargeObj), kLargeAlign))
         .WillOnce([&](size_t size, crystal::mem::align_t align) {
             static std::vector<std::byte> large_block_memory(size);
             large_obj_ptr = reinterpret_cast<void*>(large_block_memory.data());
@@ -378,8 +551,178 @@ TEST_F(SafeBestFitPoolTest, ClearDeallocatesAllMemory) {
     // Expect Dealloc calls during Clear()
     EXPECT_CALL(real_mock_resource_vendor, MockDealloc(::testing::_, kTestBlockSize, static_cast<crystal::mem::align_t>(kTestBlockSize))) // For the internal block
         .Times(1);
-    EXPECT_CALL(real_mock_resource_vendor, MockDealloc(large_obj_ptr, sizeof(LargeObj), static_cast<crystal::mem::align_t>(alignof(LargeObj)))) // For the external large object
+    EXPECT_CALL(real_mock_resource_vendor, MockDealloc(large_obj_ptr, sizeof(LargeObj), kLargeAlign)) // For the external large object
         .Times(1);
 
     // No explicit call to pool.Clear() here; it will be called by the destructor.
 }
+
+// Test fixture for releasing fully free blocks. Blocks are fictional
+// addresses, the pool never touches its data memory.
+class SafeBestFitPoolReleaseTest : public ::testing::Test {
+protected:
+    crystal::mem::MockVendorConceptSatisfier mock_resource_vendor_satisfier;
+    crystal::mem::RealMockVendor& real_mock_resource_vendor = mock_resource_vendor_satisfier.get_real_mock();
+    crystal::mem::OSResource os_resource;
+    crystal::mem::Vendor<crystal::mem::OSResource> logic_vendor{ os_resource };
+    size_t next_block = 1;
+    size_t block_stride = 2; // Blocks are not adjacent unless a test says so
+
+    template <size_t kRetention>
+    using TestPool = crystal::mem::SafeBestFitPool<kTestBlockSize,
+                                                   crystal::mem::MockVendorConceptSatisfier,
+                                                   crystal::mem::Vendor<crystal::mem::OSResource>,
+                                                   crystal::mem::SafeBestFitOptions{ .empty_block_retention = kRetention }>;
+
+    void SetUp() override {
+        ON_CALL(real_mock_resource_vendor, MockAlloc(kTestBlockSize, ::testing::_))
+            .WillByDefault([this](size_t size, crystal::mem::align_t align) {
+                void* block = reinterpret_cast<void*>(next_block * kTestBlockSize);
+                next_block += block_stride;
+                return block;
+            });
+    }
+};
+
+TEST_F(SafeBestFitPoolReleaseTest, ReleasesFullyFreeBlocksPastRetention) {
+    constexpr crystal::mem::align_t kAlign = static_cast<crystal::mem::align_t>(16);
+    EXPECT_CALL(real_mock_resource_vendor, MockAlloc(kTestBlockSize, ::testing::_)).Times(4);
+    TestPool<1> pool(mock_resource_vendor_satisfier, logic_vendor);
+    std::vector<void*> ptrs;
+    for (size_t i = 0; i < 4; ++i) {
+        ptrs.push_back(pool.RawAlloc(100, kAlign));
+        ptrs.push_back(pool.RawAlloc(100, kAlign));
+    }
+
+    // A block is only released once both of its allocations are freed, and
+    // the first fully free block is kept.
+    EXPECT_CALL(real_mock_resource_vendor, MockDealloc(::testing::_, kTestBlockSize, ::testing::_)).Times(0);
+    for (size_t i = 0; i < ptrs.size(); i += 2) pool.RawDealloc(ptrs[i], 100, kAlign);
+    pool.RawDealloc(ptrs[1], 100, kAlign);
+    ::testing::Mock::VerifyAndClearExpectations(&real_mock_resource_vendor);
+    EXPECT_CALL(real_mock_resource_vendor, MockDealloc(ptrs[2], kTestBlockSize, static_cast<crystal::mem::align_t>(kTestBlockSize))).Times(1);
+    EXPECT_CALL(real_mock_resource_vendor, MockDealloc(ptrs[4], kTestBlockSize, static_cast<crystal::mem::align_t>(kTestBlockSize))).Times(1);
+    for (size_t i = 3; i < 6; i += 2) pool.RawDealloc(ptrs[i], 100, kAlign);
+    ::testing::Mock::VerifyAndClearExpectations(&real_mock_resource_vendor);
+
+    // The kept block is reused without asking the vendor.
+    EXPECT_CALL(real_mock_resource_vendor, MockAlloc(::testing::_, ::testing::_)).Times(0);
+    ASSERT_EQ(pool.RawAlloc(kTestBlockSize, kAlign), ptrs[0]);
+    ::testing::Mock::VerifyAndClearExpectations(&real_mock_resource_vendor);
+
+    // Clearing releases the remaining blocks once.
+    EXPECT_CALL(real_mock_resource_vendor, MockDealloc(ptrs[0], kTestBlockSize, ::testing::_)).Times(1);
+    EXPECT_CALL(real_mock_resource_vendor, MockDealloc(ptrs[6], kTestBlockSize, ::testing::_)).Times(1);
+}
+
+TEST_F(SafeBestFitPoolReleaseTest, DoesNotPingPongAtBlockBoundary) {
+    constexpr crystal::mem::align_t kAlign = static_cast<crystal::mem::align_t>(8);
+    EXPECT_CALL(real_mock_resource_vendor, MockAlloc(kTestBlockSize, ::testing::_)).Times(1);
+    EXPECT_CALL(real_mock_resource_vendor, MockDealloc(::testing::_, kTestBlockSize, ::testing::_)).Times(1);
+    TestPool<1> pool(mock_resource_vendor_satisfier, logic_vendor);
+    for (size_t i = 0; i < 100; ++i) {
+        void* ptr = pool.RawAlloc(64, kAlign);
+        pool.RawDealloc(ptr, 64, kAlign);
+    }
+}
+
+TEST_F(SafeBestFitPoolReleaseTest, ReleasesAdjacentBlocksThatMerged) {
+    constexpr crystal::mem::align_t kAlign = static_cast<crystal::mem::align_t>(1);
+    block_stride = 1;
+    EXPECT_CALL(real_mock_resource_vendor, MockAlloc(kTestBlockSize, ::testing::_)).Times(3);
+    TestPool<0> pool(mock_resource_vendor_satisfier, logic_vendor);
+    // Three adjacent blocks, each split in a head and a tail.
+    std::vector<void*> heads, tails;
+    for (size_t i = 0; i < 3; ++i) {
+        heads.push_back(pool.RawAlloc(kTestBlockSize - 32, kAlign));
+        tails.push_back(pool.RawAlloc(32, kAlign));
+    }
+
+    // Freeing the tail of one block and the head of the next merges them, but
+    // neither block is fully free yet.
+    EXPECT_CALL(real_mock_resource_vendor, MockDealloc(::testing::_, kTestBlockSize, ::testing::_)).Times(0);
+    pool.RawDealloc(tails[0], 32, kAlign);
+    pool.RawDealloc(heads[1], kTestBlockSize - 32, kAlign);
+    ::testing::Mock::VerifyAndClearExpectations(&real_mock_resource_vendor);
+
+    // Without retention, the middle block goes back as soon as it is free,
+    // and the free memory around it stays usable.
+    EXPECT_CALL(real_mock_resource_vendor, MockDealloc(heads[1], kTestBlockSize, ::testing::_)).Times(1);
+    pool.RawDealloc(tails[1], 32, kAlign);
+    ::testing::Mock::VerifyAndClearExpectations(&real_mock_resource_vendor);
+    ASSERT_EQ(pool.RawAlloc(32, kAlign), tails[0]);
+
+    EXPECT_CALL(real_mock_resource_vendor, MockDealloc(heads[0], kTestBlockSize, ::testing::_)).Times(1);
+    EXPECT_CALL(real_mock_resource_vendor, MockDealloc(heads[2], kTestBlockSize, ::testing::_)).Times(1);
+}
+
+TEST_F(SafeBestFitPoolReleaseTest, ResizesIntoAdjacentFreeRange) {
+    EXPECT_CALL(real_mock_resource_vendor, MockAlloc(kTestBlockSize, ::testing::_)).Times(1);
+    EXPECT_CALL(real_mock_resource_vendor, MockDealloc(::testing::_, kTestBlockSize, ::testing::_)).Times(1);
+    TestPool<1> pool(mock_resource_vendor_satisfier, logic_vendor);
+    char* first = pool.ContinuousAlloc<char>(40);
+    char* second = pool.ContinuousAlloc<char>(40);
+    ASSERT_EQ(second, first + 40);
+
+    // The first array is boxed in, the second grows into the free tail.
+    ASSERT_FALSE(pool.TryExpandInPlace<char>(first, 40, 80));
+    ASSERT_TRUE(pool.TryExpandInPlace<char>(second, 40, 120));
+    ASSERT_EQ(pool.ContinuousAlloc<char>(40), second + 120);
+    ASSERT_FALSE(pool.TryExpandInPlace<char>(second, 120, kTestBlockSize));
+
+    // Shrinking hands the tail back, so the first array can grow again once
+    // its neighbour moves out of the way.
+    ASSERT_TRUE(pool.Shrink<char>(second, 120, 20));
+    ASSERT_EQ(pool.ContinuousAlloc<char>(100), second + 20);
+    pool.ContinuousDealloc<char>(second, 20);
+    ASSERT_TRUE(pool.TryExpandInPlace<char>(first, 40, 60));
+    ASSERT_EQ(crystal::mem::Realloc<char>(pool, first, 60, 40), first);
+}
+
+TEST_F(SafeBestFitPoolReleaseTest, AllocAtLeastTakesShortFreeTail) {
+    EXPECT_CALL(real_mock_resource_vendor, MockAlloc(kTestBlockSize, ::testing::_)).Times(1);
+    EXPECT_CALL(real_mock_resource_vendor, MockDealloc(::testing::_, kTestBlockSize, ::testing::_)).Times(1);
+    TestPool<1> pool(mock_resource_vendor_satisfier, logic_vendor);
+    // A long free tail stays free.
+    auto [head, head_count] = pool.ContinuousAllocAtLeast<char>(100);
+    ASSERT_EQ(head_count, 100);
+    char* hole = pool.ContinuousAlloc<char>(40);
+    char* rest = pool.ContinuousAlloc<char>(100);
+    pool.ContinuousDealloc<char>(hole, 40);
+
+    // The 12 bytes left of the 40 byte hole go with the array, as far as they
+    // hold whole objects.
+    auto [ptr, count] = pool.ContinuousAllocAtLeast<uint32_t>(7);
+    ASSERT_EQ(reinterpret_cast<char*>(ptr), hole);
+    ASSERT_EQ(count, 10);
+    ASSERT_EQ(pool.ContinuousAlloc<char>(16), rest + 100);
+
+    // Deallocating with the count frees the whole hole again.
+    pool.ContinuousDealloc<uint32_t>(ptr, count);
+    ASSERT_EQ(pool.ContinuousAlloc<char>(40), hole);
+}
+
+TEST_F(SafeBestFitPoolReleaseTest, AllocAtLeastStaysWithinBlock) {
+    block_stride = 1;
+    EXPECT_CALL(real_mock_resource_vendor, MockAlloc(kTestBlockSize, ::testing::_)).Times(2);
+    EXPECT_CALL(real_mock_resource_vendor, MockDealloc(::testing::_, kTestBlockSize, ::testing::_)).Times(2);
+    TestPool<2> pool(mock_resource_vendor_satisfier, logic_vendor);
+    char* head = pool.ContinuousAlloc<char>(240);
+    char* tail = pool.ContinuousAlloc<char>(16);
+    char* next = pool.ContinuousAlloc<char>(10);
+    pool.ContinuousAlloc<char>(246);
+    ASSERT_EQ(next, head + kTestBlockSize);
+    pool.ContinuousDealloc<char>(head, 240);
+    pool.ContinuousDealloc<char>(tail, 16);
+    pool.ContinuousDealloc<char>(next, 10);
+
+    // The 26 byte free tail reaches into the adjacent block, the array only
+    // takes it up to the end of its own.
+    auto [ptr, count] = pool.ContinuousAllocAtLeast<char>(240);
+    ASSERT_EQ(ptr, head);
+    ASSERT_EQ(count, kTestBlockSize);
+
+    // Deallocating with the count frees the array from its block.
+    pool.ContinuousDealloc<char>(ptr, count);
+    ASSERT_EQ(pool.ContinuousAlloc<char>(kTestBlockSize), head);
+}
@@ -0,0 +1,135 @@
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+#include "CrystalMem/pool/safe_slub/safe_slub.h"
+#include "CrystalMem/resource/os.h"
+#include "CrystalMem/type.h"
+#include "../mock_pool.h"
+
+#include <algorithm> // std::sort
+#include <utility> // std::move
+#include <vector> // std::vector
+
+namespace crystal::mem {
+
+using ::testing::_;
+
+class SafeSLUBPoolTest : public FictionalMemoryTest {
+ protected:
+  using TestPool = SafeSLUBPool<kTestBlockSize,
+                                { 16_B, 32_B, 64_B },
+                                MockVendorConceptSatisfier,
+                                Vendor<OSResource>>;
+};
+
+TEST_F(SafeSLUBPoolTest, DistributesFictionalMemory) {
+  using Block = SafeSLUBBlock<kTestBlockSize, 16_B>;
+  constexpr size_t kNBlocks = 3;
+  constexpr align_t kAlign = static_cast<align_t>(16);
+  EXPECT_CALL(real_mock_vendor, MockAlloc(kTestBlockSize, _)).Times(kNBlocks);
+
+  TestPool pool(resource_vendor, logic_vendor);
+  std::vector<void*> slots;
+  for (size_t i = 0; i < Block::kNSlots * kNBlocks; ++i)
+    slots.push_back(pool.RawAlloc(16_B, kAlign));
+
+  // Every slot is distinct, aligned and within one of the blocks.
+  std::vector<void*> sorted = slots;
+  std::sort(sorted.begin(), sorted.end());
+  ASSERT_EQ(std::adjacent_find(sorted.begin(), sorted.end()), sorted.end());
+  for (void* slot : slots) {
+    size_t addr = reinterpret_cast<size_t>(slot);
+    ASSERT_EQ(addr % 16_B, 0);
+    ASSERT_GE(addr, kTestBlockSize);
+    ASSERT_LT(addr, next_block * kTestBlockSize);
+  }
+
+  // Empty blocks past the retained one are released right away, the last one
+  // when the pool is destroyed.
+  EXPECT_CALL(real_mock_vendor, MockDealloc(_, kTestBlockSize, _))
+      .Times(kNBlocks);
+  for (void* slot : slots) pool.RawDealloc(slot, 16_B, kAlign);
+  void* reused = pool.RawAlloc(16_B, kAlign);
+  ASSERT_NE(std::find(slots.begin(), slots.end(), reused), slots.end());
+  pool.RawDealloc(reused, 16_B, kAlign);
+}
+
+TEST_F(SafeSLUBPoolTest, VendorFailureReturnsNull) {
+  constexpr align_t kAlign = static_cast<align_t>(16);
+  TestPool pool(resource_vendor, logic_vendor);
+  EXPECT_CALL(real_mock_vendor, MockAlloc(kTestBlockSize, _))
+      .WillOnce(::testing::Return(nullptr))
+      .WillRepeatedly(::testing::DoDefault());
+  ASSERT_EQ(pool.RawAlloc(16_B, kAlign), nullptr);
+
+  // The failure leaves no block behind, the next allocation gets a new one.
+  EXPECT_CALL(real_mock_vendor, MockDealloc(_, kTestBlockSize, _)).Times(1);
+  void* slot = pool.RawAlloc(16_B, kAlign);
+  ASSERT_EQ(slot, reinterpret_cast<void*>(kTestBlockSize));
+  pool.RawDealloc(slot, 16_B, kAlign);
+}
+
+TEST_F(SafeSLUBPoolTest, MovedPoolFindsItsBlocks) {
+  constexpr align_t kAlign = static_cast<align_t>(32);
+  EXPECT_CALL(real_mock_vendor, MockAlloc(kTestBlockSize, _)).Times(1);
+  EXPECT_CALL(real_mock_vendor, MockDealloc(_, kTestBlockSize, _)).Times(1);
+  TestPool pool(resource_vendor, logic_vendor);
+  void* first = pool.RawAlloc(32_B, kAlign);
+  void* second = pool.RawAlloc(32_B, kAlign);
+
+  // The buckets of the new pool look slots up in its own block map.
+  TestPool moved(std::move(pool));
+  moved.RawDealloc(first, 32_B, kAlign);
+  ASSERT_EQ(moved.RawAlloc(32_B, kAlign), first);
+  moved.RawDealloc(first, 32_B, kAlign);
+  moved.RawDealloc(second, 32_B, kAlign);
+}
+
+TEST(SafeSLUBAllocAtLeastTest, ReportedCountDeallocatesIntoItsClass) {
+  constexpr integer_sequence kSlotSizes{ 24_B, 40_B, 1032_B, 2_kB };
+  OSResource resource;
+  using Pool = SafeSLUBPool<4_kB, kSlotSizes, Vendor<OSResource>>;
+  Pool pool{ Vendor<OSResource>{ resource } };
+  for (size_t i = 0; i < kSlotSizes.size(); ++i) {
+    auto [ptr, count] = pool.ContinuousAllocAtLeast<char>(kSlotSizes[i] - 1);
+    ASSERT_EQ(count, kSlotSizes[i]);
+    // The slot goes back to the bitmap of its own class.
+    pool.ContinuousDealloc(ptr, count);
+    ASSERT_EQ(pool.ContinuousAlloc<char>(kSlotSizes[i] - 1), ptr);
+    pool.ContinuousDealloc(ptr, kSlotSizes[i] - 1);
+  }
+}
+
+TEST(SafeSLUBBlockTest, AllocatesLowestFreeSlot) {
+  using Block = SafeSLUBBlock<4_kB, 16_B>;
+  ASSERT_EQ(Block::kNSlots, 256);
+  void* base = reinterpret_cast<void*>(4_kB);
+  Block block(base);
+
+  std::vector<void*> slots;
+  for (size_t i = 0; i < Block::kNSlots; ++i) {
+    slots.push_back(block.AllocSlot());
+    ASSERT_EQ(reinterpret_cast<size_t>(slots[i]), 4_kB + i * 16_B);
+  }
+  ASSERT_TRUE(block.Full());
+  ASSERT_EQ(block.AllocSlot(), nullptr);
+
+  // Freed slots are found again across bitmap words, lowest first.
+  block.DeallocSlot(slots[200]);
+  block.DeallocSlot(slots[70]);
+  ASSERT_EQ(block.AllocSlot(), slots[70]);
+  ASSERT_EQ(block.AllocSlot(), slots[200]);
+
+  for (void* slot : slots) block.DeallocSlot(slot);
+  ASSERT_TRUE(block.Empty());
+}
+
+TEST(SafeSLUBBlockTest, PartialLastWord) {
+  // 1024 / 48 = 21 slots, less than a bitmap word.
+  using Block = SafeSLUBBlock<1024, 48_B>;
+  Block block(reinterpret_cast<void*>(1024));
+  for (size_t i = 0; i < Block::kNSlots; ++i)
+    ASSERT_NE(block.AllocSlot(), nullptr);
+  ASSERT_EQ(block.AllocSlot(), nullptr);
+}
+
+} // namespace crystal::mem
@@ -1,14 +1,28 @@
 #include "gtest/gtest.h"
 #include "gmock/gmock.h"
+#include "CrystalMem/allocator/continuous_allocator.h"
+#include "CrystalMem/pool/realloc.h"
 #include "CrystalMem/pool/slub/slub.h"
 #include "CrystalMem/type.h"
 #include "../mock_pool.h"
 
+#ifdef __unix__
+#include <sys/wait.h> // waitpid
+#include <unistd.h> // fork, alarm, _exit
+#endif
+
+#include <algorithm> // std::sort, std::find
+#include <atomic> // std::atomic
+#include <thread> // std::thread
+#include <utility> // std::pair
+#include <vector> // std::vector
+
 namespace crystal::mem {
 
 using ::testing::_;
 using ::testing::Return;
 using ::testing::AtLeast;
+using ::testing::AnyNumber;
 
 class SLUBPoolTest : public ::testing::Test {
  protected:
@@ -80,6 +94,9 @@ TEST_F(SLUBPoolTest, DiscreteAllocLargeObject) {
   
   void* dummy_ptr = reinterpret_cast<void*>(0x12345678);
 
+  // The record of the allocation lives in page map nodes from the same vendor.
+  EXPECT_CALL(real_mock_vendor, MockAlloc(_, _)).Times(AnyNumber());
+  EXPECT_CALL(real_mock_vendor, MockDealloc(_, _, _)).Times(AnyNumber());
   EXPECT_CALL(real_mock_vendor, MockAlloc(sizeof(Large), _))
       .WillOnce(Return(dummy_ptr));
 
@@ -87,7 +104,7 @@ TEST_F(SLUBPoolTest, DiscreteAllocLargeObject) {
   ASSERT_EQ(reinterpret_cast<void*>(ptr), dummy_ptr);
 
   EXPECT_CALL(real_mock_vendor, MockDealloc(dummy_ptr, sizeof(Large), _))
-      .Times(1);
+      .WillOnce(Return());
   pool.DiscreteDealloc(ptr);
 }
 
@@ -102,6 +119,8 @@ TEST_F(SLUBPoolTest, ContinuousAlloc) {
   void* dummy_ptr = reinterpret_cast<void*>(0x87654321);
   size_t expected_size = sizeof(double) * 10; // 80 bytes
 
+  EXPECT_CALL(real_mock_vendor, MockAlloc(_, _)).Times(AnyNumber());
+  EXPECT_CALL(real_mock_vendor, MockDealloc(_, _, _)).Times(AnyNumber());
   EXPECT_CALL(real_mock_vendor, MockAlloc(expected_size, _))
       .WillOnce(Return(dummy_ptr));
 
@@ -109,7 +128,7 @@ TEST_F(SLUBPoolTest, ContinuousAlloc) {
   ASSERT_EQ(reinterpret_cast<void*>(ptr), dummy_ptr);
 
   EXPECT_CALL(real_mock_vendor, MockDealloc(dummy_ptr, expected_size, _))
-      .Times(1);
+      .WillOnce(Return());
   pool.ContinuousDealloc(ptr, 10);
 }
 
@@ -142,4 +161,625 @@ TEST_F(SLUBPoolTest, NewAndDel) {
       });
 }
 
+TEST_F(SLUBPoolTest, ResizesWithinSizeClass) {
+  EXPECT_CALL(real_mock_vendor, MockAlloc(_, _)).Times(AnyNumber());
+  EXPECT_CALL(real_mock_vendor, MockDealloc(_, _, _)).Times(AnyNumber());
+  TestPool pool(mock_vendor_satisfier);
+  char* ptr = pool.ContinuousAlloc<char>(20);
+  for (size_t i = 0; i < 20; ++i) ptr[i] = static_cast<char>(i);
+
+  // The 32 byte slot has room up to its size, but not past it.
+  ASSERT_TRUE(pool.TryExpandInPlace<char>(ptr, 20, 32));
+  ASSERT_FALSE(pool.TryExpandInPlace<char>(ptr, 32, 33));
+  ASSERT_TRUE(pool.Shrink<char>(ptr, 32, 17));
+  ASSERT_FALSE(pool.Shrink<char>(ptr, 17, 16));
+
+  // Leaving the size class copies, even to a large allocation.
+  char* moved = Realloc<char>(pool, ptr, 17, 200);
+  ASSERT_NE(moved, ptr);
+  for (size_t i = 0; i < 17; ++i) ASSERT_EQ(moved[i], static_cast<char>(i));
+  ASSERT_FALSE(pool.TryExpandInPlace<char>(moved, 200, 201));
+  ASSERT_TRUE(pool.Shrink<char>(moved, 200, 100));
+  char* back = Realloc<char>(pool, moved, 100, 10);
+  for (size_t i = 0; i < 10; ++i) ASSERT_EQ(back[i], static_cast<char>(i));
+  pool.ContinuousDealloc<char>(back, 10);
+}
+
+TEST_F(SLUBPoolTest, AllocatorReportsSlotSlack) {
+  EXPECT_CALL(real_mock_vendor, MockAlloc(_, _)).Times(AnyNumber());
+  EXPECT_CALL(real_mock_vendor, MockDealloc(_, _, _)).Times(AnyNumber());
+  TestPool pool(mock_vendor_satisfier);
+  ContinuousAllocator<char, TestPool> allocator(pool);
+  // 40 bytes get a 64 byte slot, and all of it is usable.
+  auto [ptr, count] = allocator.allocate_at_least(40);
+  ASSERT_EQ(count, 64);
+  ASSERT_TRUE(allocator.TryExpandInPlace(ptr, 40, count));
+  allocator.deallocate(ptr, count);
+
+  // Objects only count as far as they fit whole, large arrays get no slack.
+  ASSERT_EQ(pool.ContinuousAllocAtLeast<double>(3).count, 4);
+  auto [large, large_count] = pool.ContinuousAllocAtLeast<double>(100);
+  ASSERT_EQ(large_count, 100);
+  pool.ContinuousDealloc(large, large_count);
+}
+
+TEST(SLUBAllocAtLeastTest, ReportedCountDeallocatesIntoItsClass) {
+  constexpr integer_sequence kSlotSizes{ 24_B, 40_B, 1032_B, 2_kB };
+  OSResource resource;
+  using Pool = SLUBPool<4_kB, kSlotSizes, Vendor<OSResource>>;
+  Pool pool{ Vendor<OSResource>{ resource } };
+  for (size_t i = 0; i < kSlotSizes.size(); ++i) {
+    auto [ptr, count] = pool.ContinuousAllocAtLeast<char>(kSlotSizes[i] - 1);
+    ASSERT_EQ(count, kSlotSizes[i]);
+    // The slot goes back to the free list of its own class.
+    pool.ContinuousDealloc(ptr, count);
+    ASSERT_EQ(pool.ContinuousAlloc<char>(kSlotSizes[i] - 1), ptr);
+    pool.ContinuousDealloc(ptr, kSlotSizes[i] - 1);
+  }
+}
+
+TEST(SLUBThreadCacheTest, ReusesCachedSlot) {
+  OSResource resource;
+  using Pool = SLUBPool<4_kB,
+                        { 16_B, 64_B },
+                        Vendor<OSResource>,
+                        Vendor<OSResource>,
+                        SLUBOptions{ .magazine_size = 8 }>;
+  Pool pool{ Vendor<OSResource>{ resource } };
+
+  int* first = pool.DiscreteAlloc<int>();
+  pool.DiscreteDealloc(first);
+  // The freed slot sits on top of the thread's magazine.
+  int* second = pool.DiscreteAlloc<int>();
+  ASSERT_EQ(first, second);
+  pool.DiscreteDealloc(second);
+}
+
+TEST_F(SLUBPoolTest, InterleavedPoolsKeepTheirMagazines) {
+  using Pool = SLUBPool<kTestBlockSize,
+                        { 16_B, 32_B, 64_B },
+                        MockVendorConceptSatisfier,
+                        MockVendorConceptSatisfier,
+                        SLUBOptions{ .magazine_size = 4,
+                                     .empty_block_retention = 0 }>;
+  // A flushed magazine would empty its block, which is then released and
+  // allocated again on the next switch back.
+  EXPECT_CALL(real_mock_vendor, MockAlloc(_, _)).Times(AnyNumber());
+  EXPECT_CALL(real_mock_vendor, MockDealloc(_, _, _)).Times(AnyNumber());
+  EXPECT_CALL(real_mock_vendor, MockAlloc(kTestBlockSize, _)).Times(2);
+  Pool first(mock_vendor_satisfier);
+  Pool second(mock_vendor_satisfier);
+  for (size_t i = 0; i < 10; ++i) {
+    for (Pool* pool : { &first, &second }) {
+      int* ptr = pool->DiscreteAlloc<int>();
+      pool->DiscreteDealloc(ptr);
+    }
+  }
+}
+
+TEST(SLUBThreadCacheTest, ConcurrentAllocDealloc) {
+  OSResource resource;
+  using Pool = SLUBPool<4_kB,
+                        { 16_B, 64_B },
+                        Vendor<OSResource>,
+                        Vendor<OSResource>,
+                        SLUBOptions{ .magazine_size = 16 }>;
+  Pool pool{ Vendor<OSResource>{ resource } };
+
+  constexpr size_t kThreads = 4;
+  constexpr size_t kObjects = 1000;
+  std::vector<std::thread> threads;
+  std::vector<bool> ok(kThreads, false);
+  for (size_t t = 0; t < kThreads; ++t) {
+    threads.emplace_back([&pool, &ok, t] {
+      bool good = true;
+      for (size_t round = 0; round < 10; ++round) {
+        std::vector<size_t*> ptrs;
+        for (size_t i = 0; i < kObjects; ++i) {
+          size_t* ptr = reinterpret_cast<size_t*>(
+              pool.RawAlloc(i % 2 ? 16_B : 64_B, align_t{ 8 }));
+          *ptr = t * kObjects + i;
+          ptrs.push_back(ptr);
+        }
+        for (size_t i = 0; i < kObjects; ++i) {
+          good &= *ptrs[i] == t * kObjects + i;
+          pool.RawDealloc(ptrs[i], i % 2 ? 16_B : 64_B, align_t{ 8 });
+        }
+      }
+      ok[t] = good;
+    });
+  }
+  for (auto& thread : threads) thread.join();
+  for (bool good : ok) ASSERT_TRUE(good);
+}
+
+TEST(SLUBThreadCacheTest, FreeOnOtherThread) {
+  OSResource resource;
+  using Pool = SLUBPool<4_kB,
+                        { 32_B },
+                        Vendor<OSResource>,
+                        Vendor<OSResource>,
+                        SLUBOptions{ .magazine_size = 4 }>;
+  Pool pool{ Vendor<OSResource>{ resource } };
+
+  std::vector<int*> ptrs;
+  for (size_t i = 0; i < 100; ++i) ptrs.push_back(pool.DiscreteAlloc<int>());
+  // The consumer thread flushes its magazine back on exit.
+  std::thread consumer([&] {
+    for (int* ptr : ptrs) pool.DiscreteDealloc(ptr);
+  });
+  consumer.join();
+  for (size_t i = 0; i < 100; ++i) ptrs[i] = pool.DiscreteAlloc<int>();
+  for (int* ptr : ptrs) pool.DiscreteDealloc(ptr);
+}
+
+#ifdef __unix__
+TEST(SLUBThreadCacheTest, ForkedChildKeepsAllocating) {
+  OSResource resource;
+  using Pool = SLUBPool<4_kB,
+                        { 32_B },
+                        Vendor<OSResource>,
+                        Vendor<OSResource>,
+                        SLUBOptions{ .magazine_size = 4 }>;
+  Pool pool{ Vendor<OSResource>{ resource } };
+  auto churn = [&] {
+    int* ptrs[16];
+    for (int*& ptr : ptrs) ptr = pool.DiscreteAlloc<int>();
+    for (int* ptr : ptrs) pool.DiscreteDealloc(ptr);
+  };
+
+  // Refills and flushes of this thread take the bucket lock all the time.
+  std::atomic<bool> stop = false;
+  std::thread churner([&] {
+    while (!stop.load()) churn();
+  });
+  for (size_t i = 0; i < 100; ++i) {
+    pool.LockAll();
+    pid_t pid = fork();
+    pool.UnlockAll();
+    if (pid == 0) {
+      // The churning thread is gone, a lock it held would hang the child.
+      alarm(10);
+      churn();
+      _exit(0);
+    }
+    int status;
+    EXPECT_EQ(waitpid(pid, &status, 0), pid);
+    EXPECT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+  }
+  stop = true;
+  churner.join();
+}
+#endif
+
+TEST_F(SLUBPoolTest, RemoteFreeIsReclaimedByOwner) {
+  constexpr size_t kNBlocks = 4;
+  // Keep the emptied blocks so that the count of vendor calls is exact.
+  using Bucket = SLUBBucket<kTestBlockSize,
+                            64_B,
+                            MockVendorConceptSatisfier,
+                            SLUBOptions{ .empty_block_retention = kNBlocks }>;
+  constexpr size_t kNObjects = Bucket::BlockNode::kNSlots * kNBlocks;
+
+  // Slots freed by another thread must be reused instead of new blocks.
+  EXPECT_CALL(real_mock_vendor, MockAlloc(kTestBlockSize, _))
+      .Times(kNBlocks)
+      .WillRepeatedly([](size_t size, align_t align) {
+        return _aligned_malloc(size, static_cast<size_t>(align));
+      });
+  EXPECT_CALL(real_mock_vendor, MockDealloc(_, kTestBlockSize, _))
+      .Times(kNBlocks)
+      .WillRepeatedly([](void* ptr, size_t size, align_t align) {
+        _aligned_free(ptr);
+      });
+
+  Bucket bucket(mock_vendor_satisfier);
+  std::vector<void*> slots;
+  for (size_t i = 0; i < kNObjects; ++i) slots.push_back(bucket.AllocSlot());
+  std::thread consumer([&] {
+    for (void* slot : slots) bucket.DeallocSlot(slot);
+  });
+  consumer.join();
+  for (size_t i = 0; i < kNObjects; ++i) slots[i] = bucket.AllocSlot();
+  for (void* slot : slots) bucket.DeallocSlot(slot);
+}
+
+TEST_F(SLUBPoolTest, EmptyBlocksReleasedPastRetention) {
+  using Bucket = SLUBBucket<kTestBlockSize,
+                            64_B,
+                            MockVendorConceptSatisfier,
+                            SLUBOptions{ .empty_block_retention = 2 }>;
+  constexpr size_t kNBlocks = 5;
+  constexpr size_t kNObjects = Bucket::BlockNode::kNSlots * kNBlocks;
+
+  Bucket bucket(mock_vendor_satisfier);
+  EXPECT_CALL(real_mock_vendor, MockAlloc(kTestBlockSize, _))
+      .Times(kNBlocks)
+      .WillRepeatedly([](size_t size, align_t align) {
+        return _aligned_malloc(size, static_cast<size_t>(align));
+      });
+  std::vector<void*> slots;
+  for (size_t i = 0; i < kNObjects; ++i) slots.push_back(bucket.AllocSlot());
+  ASSERT_EQ(bucket.NBlocks(), kNBlocks);
+
+  // Only the blocks beyond the retention count go back to the vendor.
+  EXPECT_CALL(real_mock_vendor, MockDealloc(_, kTestBlockSize, _))
+      .Times(kNBlocks - 2)
+      .WillRepeatedly([](void* ptr, size_t size, align_t align) {
+        _aligned_free(ptr);
+      });
+  for (void* slot : slots) bucket.DeallocSlot(slot);
+  ASSERT_EQ(bucket.NBlocks(), 2);
+
+  // The retained blocks are reused before the vendor is asked again.
+  for (size_t i = 0; i < 2 * Bucket::BlockNode::kNSlots; ++i)
+    slots[i] = bucket.AllocSlot();
+  ASSERT_EQ(bucket.NBlocks(), 2);
+  for (size_t i = 0; i < 2 * Bucket::BlockNode::kNSlots; ++i)
+    bucket.DeallocSlot(slots[i]);
+
+  EXPECT_CALL(real_mock_vendor, MockDealloc(_, kTestBlockSize, _))
+      .Times(2)
+      .WillRepeatedly([](void* ptr, size_t size, align_t align) {
+        _aligned_free(ptr);
+      });
+}
+
+TEST_F(SLUBPoolTest, BatchAllocDealloc) {
+  using BlockNode = SLUBBlockNode<kTestBlockSize, 32_B>;
+  constexpr size_t kNBlocks = 3;
+  constexpr size_t kNObjects = BlockNode::kNSlots * kNBlocks;
+  using Pool = SLUBPool<kTestBlockSize,
+                        { 16_B, 32_B, 64_B },
+                        MockVendorConceptSatisfier,
+                        MockVendorConceptSatisfier,
+                        SLUBOptions{ .empty_block_retention = kNBlocks }>;
+
+  Pool pool(mock_vendor_satisfier);
+  EXPECT_CALL(real_mock_vendor, MockAlloc(kTestBlockSize, _))
+      .Times(kNBlocks)
+      .WillRepeatedly([](size_t size, align_t align) {
+        return _aligned_malloc(size, static_cast<size_t>(align));
+      });
+  std::vector<void*> ptrs(kNObjects);
+  pool.AllocBatch(24_B, ptrs);
+
+  // Every slot is distinct and lies in a 32 byte slot of some block.
+  std::vector<void*> sorted = ptrs;
+  std::sort(sorted.begin(), sorted.end());
+  ASSERT_EQ(std::adjacent_find(sorted.begin(), sorted.end()), sorted.end());
+  for (void* ptr : ptrs) ASSERT_EQ(reinterpret_cast<size_t>(ptr) % 32_B, 0);
+
+  // Freed slots are reused by the next batch without new blocks.
+  pool.DeallocBatch(ptrs, 24_B);
+  pool.AllocBatch(24_B, ptrs);
+  std::vector<void*> reused = ptrs;
+  std::sort(reused.begin(), reused.end());
+  ASSERT_EQ(reused, sorted);
+  pool.DeallocBatch(ptrs, 24_B);
+
+  EXPECT_CALL(real_mock_vendor, MockDealloc(_, kTestBlockSize, _))
+      .Times(kNBlocks)
+      .WillRepeatedly([](void* ptr, size_t size, align_t align) {
+        _aligned_free(ptr);
+      });
+}
+
+TEST_F(SLUBPoolTest, NewBlocksRotateColors) {
+  // 8 slots of 112 bytes leave a cache line for coloring in a 1 kB block.
+  using Bucket = SLUBBucket<kTestBlockSize, 112_B, MockVendorConceptSatisfier>;
+  using BlockNode = Bucket::BlockNode;
+  static_assert(BlockNode::kNColors == 2);
+  constexpr size_t kNBlocks = 3;
+
+  Bucket bucket(mock_vendor_satisfier);
+  std::vector<void*> slots;
+  for (size_t i = 0; i < BlockNode::kNSlots * kNBlocks; ++i)
+    slots.push_back(bucket.AllocSlot());
+  // The first slot of each block.
+  for (size_t i = 0; i < kNBlocks; ++i) {
+    size_t offset = reinterpret_cast<size_t>(slots[i * BlockNode::kNSlots])
+                  % kTestBlockSize;
+    ASSERT_EQ(offset, BlockNode::kSlotsOffset + i % 2 * 64);
+  }
+  for (void* slot : slots) bucket.DeallocSlot(slot);
+}
+
+TEST_F(SLUBPoolTest, OutOfLineHeadersLeaveBlocksToSlots) {
+  using Pool = SLUBPool<kTestBlockSize,
+                        { 16_B, 64_B },
+                        MockVendorConceptSatisfier,
+                        MockVendorConceptSatisfier,
+                        SLUBOptions{ .out_of_line_headers = true }>;
+  constexpr size_t kNSlots = kTestBlockSize / 64_B;
+  static_assert(Pool::Bucket<64_B>::BlockNode::kNSlots == kNSlots);
+  constexpr align_t kAlign = static_cast<align_t>(8);
+
+  Pool pool(mock_vendor_satisfier);
+  // Headers and page map nodes come from the logic vendor.
+  EXPECT_CALL(real_mock_vendor, MockAlloc(_, _)).Times(AnyNumber());
+  EXPECT_CALL(real_mock_vendor, MockAlloc(kTestBlockSize, _)).Times(1);
+  // Slots start right at the block and fill it.
+  std::vector<void*> slots;
+  for (size_t i = 0; i < kNSlots; ++i) {
+    slots.push_back(pool.RawAlloc(64_B, kAlign));
+    ASSERT_EQ(reinterpret_cast<size_t>(slots[i]),
+              reinterpret_cast<size_t>(slots[0]) + i * 64_B);
+  }
+  ASSERT_EQ(reinterpret_cast<size_t>(slots[0]) % kTestBlockSize, 0);
+
+  // Frees find the header through the page map, also after a move.
+  Pool moved(std::move(pool));
+  for (void* slot : slots) moved.RawDealloc(slot, 64_B, kAlign);
+  // The retained empty block is carved again from its start.
+  ASSERT_EQ(moved.RawAlloc(64_B, kAlign), slots[0]);
+}
+
+TEST(SLUBBlockNodeTest, FreshBlockCarvesSlotsLazily) {
+  using BlockNode = SLUBBlockNode<1024, 64_B>;
+  void* memory = _aligned_malloc(sizeof(BlockNode), alignof(BlockNode));
+  BlockNode* block = new (memory) BlockNode();
+  ASSERT_FALSE(block->Full());
+
+  // Fresh slots are handed out in address order.
+  std::vector<void*> slots;
+  for (size_t i = 0; i < BlockNode::kNSlots; ++i) {
+    slots.push_back(block->AllocSlot());
+    if (i) {
+      ASSERT_EQ(reinterpret_cast<size_t>(slots[i]),
+                reinterpret_cast<size_t>(slots[i - 1]) + 64_B);
+    }
+  }
+  ASSERT_TRUE(block->Full());
+  ASSERT_EQ(block->AllocSlot(), nullptr);
+
+  // Recycled slots come back through the free list.
+  block->DeallocSlot(slots[3]);
+  ASSERT_FALSE(block->Full());
+  ASSERT_EQ(block->AllocSlot(), slots[3]);
+
+  block->~BlockNode();
+  _aligned_free(memory);
+}
+
+TEST(SLUBSizeClassesTest, LookupMatchesLinearSearch) {
+  using SizeClasses = SLUBSizeClasses<{ 8_B,
+                                        16_B,
+                                        32_B,
+                                        64_B,
+                                        128_B,
+                                        256_B,
+                                        512_B,
+                                        1_kB,
+                                        2_kB,
+                                        4_kB,
+                                        8_kB }>;
+  for (size_t size = 0; size <= 8_kB + 1; ++size)
+    ASSERT_EQ(SizeClasses::Lookup(size), SizeClasses::Search(size)) << size;
+  static_assert(SizeClasses::Lookup(100) == 4);
+  static_assert(SizeClasses::Lookup(8_kB + 1) == -1ul);
+}
+
+TEST(SLUBSizeClassesTest, UnsortedSlotSizesAlwaysFit) {
+  using SizeClasses = SLUBSizeClasses<{ 64_B, 8_B, 1500_B }>;
+  for (size_t size = 0; size <= 2_kB; ++size) {
+    size_t idx = SizeClasses::Lookup(size);
+    if (size > 1500_B) {
+      ASSERT_EQ(idx, -1ul);
+    } else {
+      ASSERT_EQ(idx, SizeClasses::Search(size)) << size;
+    }
+  }
+}
+
+TEST(SLUBSizeClassesTest, OffGridSlotSizesLookUpExactly) {
+  constexpr integer_sequence kSlotSizes{ 12_B, 20_B, 1032_B, 1100_B, 2_kB };
+  using SizeClasses = SLUBSizeClasses<kSlotSizes>;
+  static_assert(SizeClasses::Lookup(1032_B) == 2);
+  for (size_t i = 0; i < kSlotSizes.size(); ++i)
+    ASSERT_EQ(SizeClasses::Lookup(kSlotSizes[i]), i);
+  for (size_t size = 0; size <= 2_kB; ++size)
+    ASSERT_EQ(SizeClasses::Lookup(size), SizeClasses::Search(size)) << size;
+}
+
+TEST(SLUBSizeClassesTest, OverAlignedRequestsFindAlignedSlot) {
+  using SizeClasses = SLUBSizeClasses<{ 16_B, 24_B, 48_B, 64_B }>;
+  ASSERT_EQ(SizeClasses::Lookup(40_B, static_cast<align_t>(8)), 2);
+  ASSERT_EQ(SizeClasses::Lookup(20_B, static_cast<align_t>(16)), 2);
+  ASSERT_EQ(SizeClasses::Lookup(40_B, static_cast<align_t>(32)), 3);
+  ASSERT_EQ(SizeClasses::Lookup(40_B, static_cast<align_t>(128)), -1ul);
+}
+
+TEST(SLUBNonPowerOfTwoTest, SlotsArePackedAtTheirSize) {
+  struct alignas(16) Object {
+    char data[48];
+  };
+  OSResource resource;
+  using Pool = SLUBPool<4_kB,
+                        { 16_B, 24_B, 48_B, 96_B },
+                        Vendor<OSResource>>;
+  Pool pool{ Vendor<OSResource>{ resource } };
+
+  // A 48 byte object takes a 48 byte slot instead of a 64 byte one.
+  std::vector<Object*> objects;
+  for (size_t i = 0; i < 8; ++i) {
+    objects.push_back(pool.New<Object>());
+    ASSERT_EQ(reinterpret_cast<size_t>(objects[i]) % alignof(Object), 0);
+    if (i) {
+      ASSERT_EQ(reinterpret_cast<size_t>(objects[i]),
+                reinterpret_cast<size_t>(objects[i - 1]) + 48_B);
+    }
+  }
+  for (Object* object : objects) pool.Del(object);
+}
+
+TEST(SLUBOptionsTest, BlockSizeGrowsToBounds) {
+  constexpr size_t kHeader = 64;
+  // The defaults keep the base block size as long as a slot fits.
+  static_assert(SLUBOptions{}.BlockSize(4_kB, 2_kB, kHeader) == 4_kB);
+  static_assert(SLUBOptions{}.BlockSize(4_kB, 6_kB, kHeader) == 8_kB);
+  // 7 slots of 2 kB fit in 16 kB after the header, 8 need 32 kB.
+  constexpr SLUBOptions kMinSlots{ .min_slots_per_block = 8 };
+  static_assert(kMinSlots.BlockSize(4_kB, 2_kB, kHeader) == 32_kB);
+  static_assert(kMinSlots.BlockSize(4_kB, 16_B, kHeader) == 4_kB);
+  // 1.5 kB slots waste 25% of a 4 kB block but only 6% of 8 kB.
+  constexpr SLUBOptions kLowWaste{ .max_block_waste_percent = 10 };
+  static_assert(kLowWaste.BlockSize(4_kB, 1536_B, kHeader) == 8_kB);
+  // The growth stops at the maximum block size.
+  constexpr SLUBOptions kCapped{ .min_slots_per_block = 64,
+                                 .max_block_size = 16_kB };
+  static_assert(kCapped.BlockSize(4_kB, 2_kB, kHeader) == 16_kB);
+}
+
+TEST_F(SLUBPoolTest, SizeClassesGetTheirOwnBlockSize) {
+  using Pool = SLUBPool<kTestBlockSize,
+                        { 16_B, 512_B },
+                        MockVendorConceptSatisfier,
+                        MockVendorConceptSatisfier,
+                        SLUBOptions{ .min_slots_per_block = 4 }>;
+  static_assert(Pool::kBucketBlockSize<16_B> == kTestBlockSize);
+  static_assert(Pool::kBucketBlockSize<512_B> == 4 * kTestBlockSize);
+
+  Pool pool(mock_vendor_satisfier);
+  EXPECT_CALL(real_mock_vendor, MockAlloc(kTestBlockSize, _)).Times(1);
+  EXPECT_CALL(real_mock_vendor, MockAlloc(4 * kTestBlockSize, _)).Times(1);
+  constexpr align_t kAlign = static_cast<align_t>(8);
+  std::vector<void*> slots;
+  for (size_t i = 0; i < 4; ++i) slots.push_back(pool.RawAlloc(512_B, kAlign));
+  void* small = pool.RawAlloc(16_B, kAlign);
+  for (void* slot : slots) pool.RawDealloc(slot, 512_B, kAlign);
+  pool.RawDealloc(small, 16_B, kAlign);
+}
+
+TEST_F(SLUBPoolTest, LargeAllocationsAreRecordedByPage) {
+  constexpr align_t kAlign = static_cast<align_t>(8);
+  constexpr align_t kPageAlign =
+      static_cast<align_t>(TestPool::LargeMap::kPageSize);
+  TestPool pool(mock_vendor_satisfier);
+  EXPECT_CALL(real_mock_vendor, MockAlloc(_, _)).Times(AnyNumber());
+  EXPECT_CALL(real_mock_vendor, MockDealloc(_, _, _)).Times(AnyNumber());
+
+  // Allocations smaller than a page are page aligned so they get a page each.
+  EXPECT_CALL(real_mock_vendor, MockAlloc(100_B, kPageAlign)).Times(1);
+  void* small = pool.RawAlloc(100_B, kAlign);
+  std::vector<std::pair<void*, size_t>> buffers;
+  for (size_t size : { 8_kB, 16_kB, 64_kB })
+    buffers.emplace_back(pool.RawAlloc(size, kAlign), size);
+
+  // Freed buffers go back with the size and alignment they were requested
+  // with, the rest are released when the pool is cleared.
+  EXPECT_CALL(real_mock_vendor, MockDealloc(buffers[1].first, 16_kB, kAlign))
+      .Times(1);
+  pool.RawDealloc(buffers[1].first, 16_kB, kAlign);
+  EXPECT_CALL(real_mock_vendor, MockDealloc(small, 100_B, kPageAlign))
+      .Times(1);
+  EXPECT_CALL(real_mock_vendor, MockDealloc(buffers[0].first, 8_kB, kAlign))
+      .Times(1);
+  EXPECT_CALL(real_mock_vendor, MockDealloc(buffers[2].first, 64_kB, kAlign))
+      .Times(1);
+  pool.Clear();
+}
+
+
+template <SLUBOptions kOptions>
+void CheckSizeFreeDealloc() {
+  OSResource resource;
+  using Pool = SLUBPool<4_kB,
+                        { 16_B, 48_B, 512_B },
+                        Vendor<OSResource>,
+                        Vendor<OSResource>,
+                        kOptions>;
+  Pool pool{ Vendor<OSResource>{ resource } };
+  constexpr align_t kAlign = static_cast<align_t>(8);
+
+  // Mixed sizes across the size classes and past the largest one.
+  constexpr size_t kSizes[] = { 8_B, 40_B, 300_B, 20_kB };
+  std::vector<void*> ptrs;
+  for (size_t i = 0; i < 400; ++i) {
+    ptrs.push_back(pool.RawAlloc(kSizes[i % 4], kAlign));
+    *reinterpret_cast<size_t*>(ptrs.back()) = i;
+  }
+  for (size_t i = 0; i < ptrs.size(); ++i) {
+    ASSERT_EQ(*reinterpret_cast<size_t*>(ptrs[i]), i);
+    pool.Dealloc(ptrs[i]);
+  }
+  pool.Dealloc(nullptr);
+
+  // The slots went back to their own classes and are handed out again.
+  for (size_t i = 0; i < 3; ++i) {
+    void* ptr = pool.RawAlloc(kSizes[i], kAlign);
+    ASSERT_NE(std::find(ptrs.begin(), ptrs.end(), ptr), ptrs.end());
+    pool.Dealloc(ptr);
+  }
+}
+
+TEST(SLUBSizeFreeDeallocTest, FindsSizeClassFromAddress) {
+  CheckSizeFreeDealloc<SLUBOptions{ .min_slots_per_block = 16,
+                                    .size_free_dealloc = true }>();
+}
+
+TEST(SLUBSizeFreeDeallocTest, WithOutOfLineHeaders) {
+  CheckSizeFreeDealloc<SLUBOptions{ .min_slots_per_block = 16,
+                                    .out_of_line_headers = true,
+                                    .size_free_dealloc = true }>();
+}
+
+TEST(SLUBSizeFreeDeallocTest, WithThreadCache) {
+  CheckSizeFreeDealloc<SLUBOptions{ .magazine_size = 8,
+                                    .min_slots_per_block = 16,
+                                    .size_free_dealloc = true }>();
+}
+
+TEST(SLUBSizeFreeDeallocTest, MoveFlushesCachesBeforeThePageMaps) {
+  OSResource resource;
+  using Pool = SLUBPool<4_kB,
+                        { 16_B, 48_B, 512_B },
+                        Vendor<OSResource>,
+                        Vendor<OSResource>,
+                        SLUBOptions{ .magazine_size = 8,
+                                     .empty_block_retention = 0,
+                                     .out_of_line_headers = true,
+                                     .size_free_dealloc = true }>;
+  Pool pool{ Vendor<OSResource>{ resource } };
+  constexpr align_t kAlign = static_cast<align_t>(8);
+
+  // Freed slots wait in the magazine of this thread, and the flush on a move
+  // looks up their blocks and releases the empty ones.
+  std::vector<void*> ptrs;
+  for (size_t i = 0; i < 20; ++i) ptrs.push_back(pool.RawAlloc(16_B, kAlign));
+  for (void* ptr : ptrs) pool.Dealloc(ptr);
+  Pool moved(std::move(pool));
+
+  // The moved pool still finds the class of every new slot.
+  ptrs.clear();
+  for (size_t i = 0; i < 20; ++i) {
+    ptrs.push_back(moved.RawAlloc(16_B, kAlign));
+    ptrs.push_back(moved.RawAlloc(40_B, kAlign));
+  }
+  for (size_t i = 0; i < ptrs.size(); ++i)
+    EXPECT_EQ(moved.UsableSize(ptrs[i]), i % 2 ? 48_B : 16_B);
+  for (void* ptr : ptrs) moved.Dealloc(ptr);
+}
+
+TEST(SLUBSizeFreeDeallocTest, UsableSizeFromAddress) {
+  OSResource resource;
+  SLUBPool<4_kB,
+           { 16_B, 48_B, 512_B },
+           Vendor<OSResource>,
+           Vendor<OSResource>,
+           SLUBOptions{ .size_free_dealloc = true }>
+      pool{ Vendor<OSResource>{ resource } };
+  constexpr align_t kAlign = static_cast<align_t>(8);
+
+  void* small = pool.RawAlloc(20_B, kAlign);
+  void* medium = pool.RawAlloc(512_B, kAlign);
+  void* large = pool.RawAlloc(20_kB, kAlign);
+  EXPECT_EQ(pool.UsableSize(small), 48_B);
+  EXPECT_EQ(pool.UsableSize(medium), 512_B);
+  EXPECT_EQ(pool.UsableSize(large), 20_kB);
+  pool.Dealloc(small);
+  pool.Dealloc(medium);
+  pool.Dealloc(large);
+}
+
 } // namespace crystal::mem
@@ -0,0 +1,165 @@
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+#include "CrystalMem/allocator/continuous_allocator.h"
+#include "CrystalMem/allocator/discrete_allocator.h"
+#include "CrystalMem/pool/stack/stack.h"
+#include "CrystalMem/resource/os.h"
+#include "CrystalMem/type.h"
+#include "../mock_pool.h"
+
+#include <list> // std::list
+#include <numeric> // std::accumulate
+#include <vector> // std::vector
+
+namespace crystal::mem {
+
+using ::testing::_;
+using ::testing::AnyNumber;
+using ::testing::Mock;
+
+class StackPoolTest : public FictionalMemoryTest {
+ protected:
+  using TestPool =
+      StackPool<kTestBlockSize, MockVendorConceptSatisfier, Vendor<OSResource>>;
+};
+
+TEST_F(StackPoolTest, RewindsAcrossBlocks) {
+  EXPECT_CALL(real_mock_vendor, MockAlloc(kTestBlockSize, _)).Times(3);
+  EXPECT_CALL(real_mock_vendor, MockDealloc(_, kTestBlockSize, _)).Times(3);
+  TestPool pool(resource_vendor, logic_vendor);
+  constexpr align_t kAlign = static_cast<align_t>(8);
+  pool.RawAlloc(100, kAlign);
+  auto mark = pool.Mark();
+  void* first = pool.RawAlloc(800, kAlign);
+  std::vector<void*> ptrs;
+  for (size_t i = 0; i < 4; ++i) ptrs.push_back(pool.RawAlloc(500, kAlign));
+
+  // Everything since the mark is given back, and the same blocks are bumped
+  // through again without asking the vendor.
+  pool.Rewind(mark);
+  ASSERT_EQ(pool.RawAlloc(800, kAlign), first);
+  for (size_t i = 0; i < 4; ++i)
+    ASSERT_EQ(pool.RawAlloc(500, kAlign), ptrs[i]);
+}
+
+TEST_F(StackPoolTest, ScopedFramesNest) {
+  EXPECT_CALL(real_mock_vendor, MockAlloc(kTestBlockSize, _)).Times(2);
+  EXPECT_CALL(real_mock_vendor, MockDealloc(_, kTestBlockSize, _)).Times(2);
+  TestPool pool(resource_vendor, logic_vendor);
+  constexpr align_t kAlign = static_cast<align_t>(16);
+  void* outer;
+  void* inner;
+  {
+    TestPool::ScopedFrame outer_frame(pool);
+    outer = pool.RawAlloc(600, kAlign);
+    {
+      TestPool::ScopedFrame inner_frame(pool);
+      inner = pool.RawAlloc(600, kAlign);
+    }
+    // Only the inner frame is given back.
+    ASSERT_EQ(pool.RawAlloc(600, kAlign), inner);
+  }
+  ASSERT_EQ(pool.RawAlloc(600, kAlign), outer);
+}
+
+TEST_F(StackPoolTest, RewindReleasesLargeAllocations) {
+  constexpr size_t kLargeSize = 3 * kTestBlockSize;
+  constexpr align_t kAlign = static_cast<align_t>(8);
+  EXPECT_CALL(real_mock_vendor, MockAlloc(kLargeSize, _)).Times(3);
+  TestPool pool(resource_vendor, logic_vendor);
+  void* kept = pool.RawAlloc(kLargeSize, kAlign);
+  auto mark = pool.Mark();
+  void* freed = pool.RawAlloc(kLargeSize, kAlign);
+  void* rewound = pool.RawAlloc(kLargeSize, kAlign);
+
+  // A large allocation freed on its own is not released again by rewinding.
+  EXPECT_CALL(real_mock_vendor, MockDealloc(freed, kLargeSize, _)).Times(1);
+  EXPECT_CALL(real_mock_vendor, MockDealloc(rewound, kLargeSize, _)).Times(1);
+  pool.RawDealloc(freed, kLargeSize, kAlign);
+  pool.Rewind(mark);
+  Mock::VerifyAndClearExpectations(&real_mock_vendor);
+
+  EXPECT_CALL(real_mock_vendor, MockDealloc(kept, kLargeSize, _)).Times(1);
+}
+
+TEST_F(StackPoolTest, ForgetsLargeAllocationsFreedOutOfOrder) {
+  constexpr size_t kLargeSize = 3 * kTestBlockSize;
+  constexpr align_t kAlign = static_cast<align_t>(8);
+  // Logic memory is counted, data memory ping-pongs between two addresses
+  // like a vector regrowing.
+  MockVendorConceptSatisfier counted_vendor;
+  RealMockVendor& real_counted_vendor = counted_vendor.get_real_mock();
+  ON_CALL(real_counted_vendor, MockAlloc(_, _))
+      .WillByDefault([](size_t size, align_t align) {
+        return _aligned_malloc(size, static_cast<size_t>(align));
+      });
+  ON_CALL(real_counted_vendor, MockDealloc(_, _, _))
+      .WillByDefault([](void* ptr, size_t, align_t) { _aligned_free(ptr); });
+  EXPECT_CALL(real_counted_vendor, MockAlloc(_, _)).Times(AnyNumber());
+  EXPECT_CALL(real_counted_vendor, MockDealloc(_, _, _)).Times(AnyNumber());
+  size_t n_allocs = 0;
+  ON_CALL(real_mock_vendor, MockAlloc(kLargeSize, _))
+      .WillByDefault([&n_allocs](size_t, align_t) {
+        return reinterpret_cast<void*>((++n_allocs % 2 + 1) * 4 * 4_kB);
+      });
+  EXPECT_CALL(real_mock_vendor, MockAlloc(kLargeSize, _)).Times(AnyNumber());
+  using CountedPool = StackPool<kTestBlockSize,
+                                MockVendorConceptSatisfier,
+                                MockVendorConceptSatisfier>;
+  CountedPool pool(resource_vendor, counted_vendor);
+
+  {
+    CountedPool::ScopedFrame frame(pool);
+    void* buffer = pool.RawAlloc(kLargeSize, kAlign);
+    for (size_t i = 0; i < 1000; ++i) {
+      if (i == 10) {
+        // Freed buffers are forgotten, so the pool's state stops growing.
+        Mock::VerifyAndClearExpectations(&real_counted_vendor);
+        EXPECT_CALL(real_counted_vendor, MockAlloc(_, _)).Times(0);
+        EXPECT_CALL(real_counted_vendor, MockDealloc(_, _, _))
+            .Times(AnyNumber());
+      }
+      void* grown = pool.RawAlloc(kLargeSize, kAlign);
+      EXPECT_CALL(real_mock_vendor, MockDealloc(buffer, kLargeSize, _))
+          .Times(1)
+          .RetiresOnSaturation();
+      pool.RawDealloc(buffer, kLargeSize, kAlign);
+      buffer = grown;
+    }
+    // Only the live buffer is released at the end of the frame.
+    EXPECT_CALL(real_mock_vendor, MockDealloc(buffer, kLargeSize, _))
+        .Times(1)
+        .RetiresOnSaturation();
+  }
+  Mock::VerifyAndClearExpectations(&real_mock_vendor);
+}
+
+TEST(StackPoolContainerTest, ContainersLiveInFrame) {
+  OSResource os_resource;
+  Vendor<OSResource> vendor{ os_resource };
+  using Pool = StackPool<4_kB, Vendor<OSResource>>;
+  Pool pool(vendor);
+  auto bottom = pool.Mark();
+  for (size_t round = 0; round < 3; ++round) {
+    Pool::ScopedFrame frame(pool);
+    std::vector<int, ContinuousAllocator<int, Pool>> numbers{
+      ContinuousAllocator<int, Pool>(pool)
+    };
+    std::list<int, DiscreteAllocator<int, Pool>> nodes{
+      DiscreteAllocator<int, Pool>(pool)
+    };
+    for (int i = 0; i < 2000; ++i) {
+      numbers.push_back(i);
+      nodes.push_back(i);
+    }
+    ASSERT_EQ(std::accumulate(numbers.begin(), numbers.end(), 0),
+              1999 * 2000 / 2);
+    ASSERT_EQ(std::accumulate(nodes.begin(), nodes.end(), 0),
+              1999 * 2000 / 2);
+  }
+  auto top = pool.Mark();
+  ASSERT_EQ(top.n_blocks, bottom.n_blocks);
+  ASSERT_EQ(top.cursor, bottom.cursor);
+}
+
+} // namespace crystal::mem
@@ -0,0 +1,74 @@
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+#include "CrystalMem/pool/tlsf/tlsf.h"
+#include "CrystalMem/resource/os.h"
+#include "CrystalMem/type.h"
+#include "../mock_pool.h"
+
+#include <vector> // std::vector
+
+namespace crystal::mem {
+
+using ::testing::_;
+
+class TLSFPoolTest : public FictionalMemoryTest {
+ protected:
+  using TestPool =
+      TLSFPool<kTestBlockSize, MockVendorConceptSatisfier, Vendor<OSResource>>;
+};
+
+TEST_F(TLSFPoolTest, CoalescesFreedNeighbours) {
+  // Everything freed merges back into a whole block, which is reused.
+  EXPECT_CALL(real_mock_vendor, MockAlloc(kTestBlockSize, _)).Times(2);
+  TestPool pool(resource_vendor, logic_vendor);
+  constexpr align_t kAlign = static_cast<align_t>(16);
+  std::vector<void*> ptrs;
+  for (size_t i = 0; i < kTestBlockSize / 64; ++i)
+    ptrs.push_back(pool.RawAlloc(64, kAlign));
+  // Free every other one first, so the rest merge on both sides.
+  for (size_t i = 0; i < ptrs.size(); i += 2)
+    pool.RawDealloc(ptrs[i], 64, kAlign);
+  for (size_t i = 1; i < ptrs.size(); i += 2)
+    pool.RawDealloc(ptrs[i], 64, kAlign);
+  void* whole = pool.RawAlloc(kTestBlockSize, kAlign);
+  ASSERT_EQ(whole, ptrs[0]);
+  // The block is fully used now, so this needs the second one.
+  pool.RawAlloc(16, kAlign);
+}
+
+TEST(TLSFIndexTest, FindsLargeEnoughSegment) {
+  using Index = TLSFIndex<16, 64_kB>;
+  Index index;
+  std::vector<TLSFSegment> segments(200);
+  for (size_t i = 0; i < segments.size(); ++i) {
+    segments[i].size = (i + 1) * 48;
+    index.Insert(&segments[i]);
+  }
+  // Searches round up to the next class, which a segment at least 1/16
+  // larger always satisfies.
+  for (size_t size = 16; size <= 200 * 48 * 15 / 16; size += 16) {
+    TLSFSegment* found = index.Find(size);
+    ASSERT_NE(found, nullptr);
+    ASSERT_GE(found->size, size);
+  }
+  ASSERT_EQ(index.Find(200 * 48 + 16), nullptr);
+  index.Reset();
+  ASSERT_EQ(index.Find(16), nullptr);
+}
+
+TEST(TLSFIndexTest, RemoveClearsEmptyClasses) {
+  TLSFIndex<16, 64_kB> index;
+  TLSFSegment small{ .size = 32 }, other_small{ .size = 32 },
+      large{ .size = 4096 };
+  index.Insert(&small);
+  index.Insert(&other_small);
+  index.Insert(&large);
+  index.Remove(&other_small);
+  ASSERT_EQ(index.Find(32), &small);
+  index.Remove(&small);
+  ASSERT_EQ(index.Find(32), &large);
+  index.Remove(&large);
+  ASSERT_EQ(index.Find(32), nullptr);
+}
+
+} // namespace crystal::mem
@@ -0,0 +1,68 @@
+#include "gtest/gtest.h"
+
+#include <errno.h> // errno, ENOMEM
+#include <malloc.h> // pvalloc
+
+#include <cstdint> // SIZE_MAX
+#include <cstdlib> // std::malloc, std::calloc, std::realloc, std::free
+
+namespace crystal::mem {
+
+/* These run against the C library too, and against the malloc replacement in
+ * the `test_preloaded` run. */
+
+/* Volatile, so that the compiler cannot fold the calls. */
+volatile size_t huge_sizes[] = { SIZE_MAX, SIZE_MAX - 1, SIZE_MAX - 4096,
+                                 SIZE_MAX / 2 + 1 };
+
+/* Sanitizers replace malloc themselves, and abort on huge sizes. */
+#if defined(__SANITIZE_ADDRESS__) || defined(__SANITIZE_THREAD__)
+#define CRYSTALMEM_SKIP_IF_SANITIZED() GTEST_SKIP() << "malloc is sanitized"
+#else
+#define CRYSTALMEM_SKIP_IF_SANITIZED() static_cast<void>(0)
+#endif
+
+TEST(PreloadTest, HugeMallocFails) {
+  CRYSTALMEM_SKIP_IF_SANITIZED();
+  for (size_t size : huge_sizes) {
+    errno = 0;
+    ASSERT_EQ(std::malloc(size), nullptr) << size;
+    ASSERT_EQ(errno, ENOMEM) << size;
+  }
+}
+
+TEST(PreloadTest, HugeCallocFails) {
+  CRYSTALMEM_SKIP_IF_SANITIZED();
+  for (size_t size : huge_sizes) {
+    errno = 0;
+    ASSERT_EQ(std::calloc(1, size), nullptr) << size;
+    ASSERT_EQ(errno, ENOMEM) << size;
+  }
+}
+
+TEST(PreloadTest, HugeReallocFails) {
+  CRYSTALMEM_SKIP_IF_SANITIZED();
+  void* ptr = std::malloc(64);
+  ASSERT_NE(ptr, nullptr);
+  for (size_t size : huge_sizes) {
+    errno = 0;
+    ASSERT_EQ(std::realloc(nullptr, size), nullptr) << size;
+    ASSERT_EQ(errno, ENOMEM) << size;
+    // A failed realloc leaves the object alone.
+    ASSERT_EQ(std::realloc(ptr, size), nullptr) << size;
+  }
+  std::free(ptr);
+}
+
+#ifdef __GLIBC__
+TEST(PreloadTest, HugePvallocFails) {
+  CRYSTALMEM_SKIP_IF_SANITIZED();
+  for (size_t size : huge_sizes) {
+    errno = 0;
+    ASSERT_EQ(pvalloc(size), nullptr) << size;
+    ASSERT_EQ(errno, ENOMEM) << size;
+  }
+}
+#endif
+
+} // namespace crystal::mem
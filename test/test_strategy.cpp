@@ -0,0 +1,55 @@
+#include "gtest/gtest.h"
+#include "CrystalMem/strategy.h"
+
+#include <numeric> // std::accumulate
+#include <type_traits> // std::is_same_v
+#include <vector> // std::vector
+
+namespace crystal::mem {
+
+using std::is_same_v;
+
+template <LongevityCa kLongevity,
+          SizeCa kSize = SizeCa::Regular,
+          ExpansionCa kExpansion = ExpansionCa::Regular>
+using TestPool = typename Strategy<
+    Opts<Source::OS, Characteristic<kLongevity, kSize, kExpansion>>>::Pool;
+using TestVendor = Vendor<OSResource>;
+
+/* Longevity decides first. */
+static_assert(is_same_v<TestPool<LongevityCa::Instant, SizeCa::Large>,
+                        MonotonicArenaPool<64_kB, TestVendor>>);
+static_assert(is_same_v<sts::Pool, MonotonicArenaPool<64_kB, TestVendor>>);
+static_assert(is_same_v<tps::Pool, StackPool<64_kB, TestVendor>>);
+/* Arrays that grow go where they can grow in place. */
+static_assert(is_same_v<TestPool<LongevityCa::Long,
+                                 SizeCa::Large,
+                                 ExpansionCa::x2>,
+                        SafeBestFitPool<64_kB, TestVendor>>);
+static_assert(is_same_v<TestPool<LongevityCa::Regular,
+                                 SizeCa::Tiny,
+                                 ExpansionCa::Big>,
+                        SafeBestFitPool<64_kB, TestVendor>>);
+/* Small objects get size classes up to their size. */
+static_assert(is_same_v<TestPool<LongevityCa::Long, SizeCa::Small>,
+                        SLUBPool<4_kB,
+                                 integer_sequence{ 8_B, 16_B, 32_B },
+                                 TestVendor,
+                                 TestVendor,
+                                 SLUBOptions{ .min_slots_per_block = 8 }>>);
+static_assert(is_same_v<TestPool<LongevityCa::Regular,
+                                 SizeCa::Large,
+                                 ExpansionCa::None>,
+                        TLSFPool<64_kB, TestVendor>>);
+
+TEST(StrategyTest, ContainersUseTheSelectedStack) {
+  lts::Resource resource;
+  lts::Vendor vendor{ resource };
+  lts::Pool pool(vendor);
+  std::vector<int, lts::Allocator<int>> numbers{ lts::Allocator<int>(pool) };
+  for (int i = 0; i < 2000; ++i) numbers.push_back(i);
+  ASSERT_EQ(std::accumulate(numbers.begin(), numbers.end(), 0),
+            1999 * 2000 / 2);
+}
+
+} // namespace crystal::mem